@@ -21,10 +21,9 @@ const mat4 bias = mat4(
 // VERTEX INPUT
 /////////////////////////////////////////////////////////////////////////////////////
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
-layout(location = 2) in vec3 normal;
-layout(location = 3) in vec3 tangent;
-layout(location = 4) in vec2 uv;
+layout(location = 1) in vec2 normal;      // Octahedral encoded, R16G16_SNORM
+layout(location = 2) in vec2 tangent;     // Octahedral encoded, R16G16_SNORM
+layout(location = 3) in vec2 uv;          // R16G16_SFLOAT
 /////////////////////////////////////////////////////////////////////////////////////
 // VERTEX INPUT
 /////////////////////////////////////////////////////////////////////////////////////
@@ -39,11 +38,15 @@ layout(location = 3) out vec3 fragTangent;
 layout(location = 4) out vec2 fragUV;
 
 layout(location = 5) out vec4 fragViewPos;
+layout(location = 6) flat out uint fragMaterialIndex;   // firstInstance of the draw, see Model::Draw
 
 layout(location = 7) out vec3 fragModelPos; //outWorldPos
 layout(location = 8) out vec3 fragLightVec; //outLightVec
 
 layout(location = 9) out vec4 fragSpotLightWorldSpace[MAX_SPOT_LIGHTS];
+
+// Must match DepthPrepass.vert bit for bit, the main pass depth tests with EQUAL
+invariant gl_Position;
 /////////////////////////////////////////////////////////////////////////////////////
 // VERTEX OUTPUT
 /////////////////////////////////////////////////////////////////////////////////////
@@ -117,18 +120,32 @@ layout(push_constant) uniform Push
 // PUSH CONSTANTS : MAIN
 /////////////////////////////////////////////////////////////////////////////////////
 
-
+/////////////////////////////////////////////////////////////////////////////////////
+// HELPER FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////////////
+vec3 DecodeOctahedral(vec2 f)
+{
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+/////////////////////////////////////////////////////////////////////////////////////
+// HELPER FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////////////
 
 void main()
 {
 	vec4 modelWorldSpace = push.modelMatrix * vec4(position, 1.0f);
 	gl_Position = globalUbo.cameraData.projectionMatrix * globalUbo.cameraData.viewMatrix * modelWorldSpace;
 
-	fragNormalWorldSpace = mat3(push.normalMatrix) * normal;
+	fragNormalWorldSpace = mat3(push.normalMatrix) * DecodeOctahedral(normal);
 	fragModelWorldSpace = modelWorldSpace.xyz; // outEyePos
-	fragColor = color;
-	fragTangent = mat3(push.normalMatrix) * tangent;
+	fragColor = vec3(1.0f);
+	fragTangent = mat3(push.normalMatrix) * DecodeOctahedral(tangent);
 	fragUV = uv;
+	fragMaterialIndex = gl_InstanceIndex;
 
 	fragViewPos = globalUbo.cameraData.viewMatrix * modelWorldSpace;
 
@@ -11,11 +11,7 @@
 /////////////////////////////////////////////////////////////////////////////////////
 // VERTEX INPUT
 /////////////////////////////////////////////////////////////////////////////////////
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
-layout(location = 2) in vec3 normal;
-layout(location = 3) in vec3 tangent;
-layout(location = 4) in vec2 uv;
+layout(location = 0) in vec3 position;   // Position stream only, binding 0
 /////////////////////////////////////////////////////////////////////////////////////
 // VERTEX INPUT
 /////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,133 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "LightingResources.glsl"
+
+/////////////////////////////////////////////////////////////////////////////////////
+// RECONSTRUCTED FROM G-BUFFER
+/////////////////////////////////////////////////////////////////////////////////////
+// Written once in main, read by the same lighting functions as Basic.frag
+vec3 fragModelWorldSpace;
+vec4 fragViewPos;
+vec4 fragSpotLightWorldSpace[MAX_SPOT_LIGHTS];
+/////////////////////////////////////////////////////////////////////////////////////
+// RECONSTRUCTED FROM G-BUFFER
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// FRAGMENT OUTPUT
+/////////////////////////////////////////////////////////////////////////////////////
+layout (location = 0) out vec4 outColor;
+/////////////////////////////////////////////////////////////////////////////////////
+// FRAGMENT OUTPUT
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 4 : SPOT LIGHT PROJECTIONS
+/////////////////////////////////////////////////////////////////////////////////////
+layout(set = 4, binding = 1) uniform SpotShadowLightProjectionUBO
+{
+	mat4 lightProjection[MAX_SPOT_LIGHTS];
+}spotShadowLightProjectionUBO;
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 4 : SPOT LIGHT PROJECTIONS
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 5 : G-BUFFER
+/////////////////////////////////////////////////////////////////////////////////////
+layout(set = 5, binding = 0) uniform sampler2D gBufferAlbedo;
+layout(set = 5, binding = 1) uniform sampler2D gBufferNormal;
+layout(set = 5, binding = 2) uniform sampler2D gBufferMetallicRoughness;
+layout(set = 5, binding = 3) uniform sampler2D gBufferDepth;
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 5 : G-BUFFER
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// PUSH CONSTANTS : DEFERRED LIGHTING
+/////////////////////////////////////////////////////////////////////////////////////
+layout(push_constant) uniform Push 
+{
+	mat4 inverseProjection;
+}push;
+/////////////////////////////////////////////////////////////////////////////////////
+// PUSH CONSTANTS : DEFERRED LIGHTING
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// HELPER FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////////////
+vec3 DecodeOctahedral(vec2 f)
+{
+    vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+#include "Lighting.glsl"
+/////////////////////////////////////////////////////////////////////////////////////
+// HELPER FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////////////
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gBufferDepth, pixel, 0).r;
+    if(depth >= 1.0f)
+        discard;
+
+    // Depth -> view space -> world space
+    vec2 screenUV = (vec2(pixel) + 0.5f) / vec2(textureSize(gBufferDepth, 0));
+    fragViewPos = push.inverseProjection * vec4(screenUV * 2.0f - 1.0f, depth, 1.0f);
+    fragViewPos /= fragViewPos.w;
+    fragModelWorldSpace = (globalUbo.cameraData.inverseViewMatrix * fragViewPos).xyz;
+
+    for(int i = 0; i < globalUbo.numOfActiveSpotLights; i++)
+    {
+        fragSpotLightWorldSpace[i] = biasMat * spotShadowLightProjectionUBO.lightProjection[i] * vec4(fragModelWorldSpace, 1.0f);
+    }
+
+    vec3 albedo = texelFetch(gBufferAlbedo, pixel, 0).rgb;
+    vec2 metallicRoughness = texelFetch(gBufferMetallicRoughness, pixel, 0).rg;
+    float metallic = metallicRoughness.x;
+    float roughness = metallicRoughness.y;
+    float ao = 1.0f;
+
+    vec3 cameraPosWorldSpace = globalUbo.cameraData.inverseViewMatrix[3].xyz;
+
+    vec3 N = DecodeOctahedral(texelFetch(gBufferNormal, pixel, 0).rg); // Surface normal
+    vec3 V = normalize(cameraPosWorldSpace - fragModelWorldSpace); // View direction
+
+    // Total reflected radiance back to the viewer.
+    vec3 Lo = vec3(0.0);
+
+    // Point Light List
+    for(float i = 0; POINT_LIGHTS && i < globalUbo.numOfActivePointLights; i++)
+    {
+        PointLight light = globalUbo.pointLights[int(i)];
+        Lo += PointLightCalculation(albedo, metallic, roughness, V, N, light, i);
+    }
+
+    // Spot Light List
+    for(float j = 0; SPOT_LIGHTS && j < globalUbo.numOfActiveSpotLights; j++)
+    {
+        SpotLight light = globalUbo.spotLights[int(j)];
+        Lo += SpotLightCalculation(albedo, metallic, roughness, V, N, light, j);
+    }
+
+    // Improvised ambient term.
+    vec3 ambient = globalUbo.directionalLightData.direction.w * albedo * ao;
+    vec3 dirLi = DirectionalLightCalculation(albedo, metallic, roughness, V, N, globalUbo.directionalLightData.direction.xyz, globalUbo.directionalLightData.color, ambient);
+
+    vec3 color = ambient + Lo + dirLi;
+    // Tone mapping and gamma correction.
+    color = color / (color + vec3(1.0));
+    
+    outColor = vec4(color, 1.0);
+
+    // Forward passes drawn afterwards (light billboards) depth test against the scene
+    gl_FragDepth = depth;
+}
\ No newline at end of file
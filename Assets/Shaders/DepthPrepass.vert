@@ -0,0 +1,48 @@
+#version 450
+
+/////////////////////////////////////////////////////////////////////////////////////
+// VERTEX INPUT
+/////////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) in vec3 position;
+/////////////////////////////////////////////////////////////////////////////////////
+// VERTEX INPUT
+/////////////////////////////////////////////////////////////////////////////////////
+
+// Must match Basic.vert bit for bit, the main pass depth tests with EQUAL
+invariant gl_Position;
+
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 0 : GLOBAL
+/////////////////////////////////////////////////////////////////////////////////////
+struct EditorCameraData
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	mat4 inverseViewMatrix;
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo
+{
+	EditorCameraData cameraData;
+}globalUbo;
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 0 : GLOBAL
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// PUSH CONSTANTS : MAIN
+/////////////////////////////////////////////////////////////////////////////////////
+layout(push_constant) uniform Push 
+{
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+}push;
+/////////////////////////////////////////////////////////////////////////////////////
+// PUSH CONSTANTS : MAIN
+/////////////////////////////////////////////////////////////////////////////////////
+
+void main()
+{
+	vec4 modelWorldSpace = push.modelMatrix * vec4(position, 1.0f);
+	gl_Position = globalUbo.cameraData.projectionMatrix * globalUbo.cameraData.viewMatrix * modelWorldSpace;
+}
@@ -0,0 +1,85 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+/////////////////////////////////////////////////////////////////////////////////////
+// FRAGMENT INPUT
+/////////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) in vec3 fragNormalWorldSpace;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragMaterialIndex;
+/////////////////////////////////////////////////////////////////////////////////////
+// FRAGMENT INPUT
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// FRAGMENT OUTPUT : G-BUFFER
+/////////////////////////////////////////////////////////////////////////////////////
+layout (location = 0) out vec4 outAlbedo;             // R8G8B8A8_UNORM
+layout (location = 1) out vec2 outNormal;             // R16G16_SNORM, octahedral encoded world space normal
+layout (location = 2) out vec2 outMetallicRoughness;  // R8G8_UNORM, x=metallic y=roughness
+/////////////////////////////////////////////////////////////////////////////////////
+// FRAGMENT OUTPUT : G-BUFFER
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 1 : BINDLESS MATERIALS
+/////////////////////////////////////////////////////////////////////////////////////
+struct Material
+{
+	vec4 albedoFactor;
+	vec4 emissiveFactor;	// w = emissive strength
+	float metallicFactor;
+	float roughnessFactor;
+
+	uint albedoTexture;
+	uint normalTexture;
+	uint metallicRoughnessTexture;
+	uint emissiveTexture;
+	uint occlusionTexture;
+	uint samplerIndex;
+};
+
+layout(set = 1, binding = 0) uniform texture2D materialTextures[];
+layout(set = 1, binding = 1) uniform sampler materialSamplers[];
+layout(set = 1, binding = 2) readonly buffer MaterialBuffer
+{
+	Material materials[];
+}materialBuffer;
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 1 : BINDLESS MATERIALS
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// HELPER FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////////////
+vec4 SampleMaterialTexture(uint textureIndex, uint samplerIndex, vec2 uv)
+{
+    return texture(sampler2D(materialTextures[nonuniformEXT(textureIndex)], materialSamplers[nonuniformEXT(samplerIndex)]), uv);
+}
+
+vec2 OctWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit vector -> [-1, 1]^2
+vec2 EncodeOctahedral(vec3 n)
+{
+    n /= (abs(n.x) + abs(n.y) + abs(n.z));
+    n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+    return n.xy;
+}
+/////////////////////////////////////////////////////////////////////////////////////
+// HELPER FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////////////
+
+void main()
+{
+    // Same inputs the forward path shades with (Basic.frag)
+    Material material = materialBuffer.materials[fragMaterialIndex];
+    vec2 metallicRoughness = SampleMaterialTexture(material.metallicRoughnessTexture, material.samplerIndex, fragUV).bg;
+
+    outAlbedo = vec4(SampleMaterialTexture(material.albedoTexture, material.samplerIndex, fragUV).rgb * material.albedoFactor.rgb, 1.0);
+    outNormal = EncodeOctahedral(normalize(fragNormalWorldSpace));
+    outMetallicRoughness = metallicRoughness * vec2(material.metallicFactor, material.roughnessFactor);
+}
@@ -0,0 +1,77 @@
+#version 450
+
+/////////////////////////////////////////////////////////////////////////////////////
+// VERTEX INPUT
+/////////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 normal;      // Octahedral encoded, R16G16_SNORM
+layout(location = 2) in vec2 tangent;     // Octahedral encoded, R16G16_SNORM
+layout(location = 3) in vec2 uv;          // R16G16_SFLOAT
+/////////////////////////////////////////////////////////////////////////////////////
+// VERTEX INPUT
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// VERTEX OUTPUT
+/////////////////////////////////////////////////////////////////////////////////////
+layout(location = 0) out vec3 fragNormalWorldSpace;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragMaterialIndex;   // firstInstance of the draw, see Model::Draw
+/////////////////////////////////////////////////////////////////////////////////////
+// VERTEX OUTPUT
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 0 : GLOBAL
+/////////////////////////////////////////////////////////////////////////////////////
+struct EditorCameraData
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	mat4 inverseViewMatrix;
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo
+{
+	EditorCameraData cameraData;
+}globalUbo;
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 0 : GLOBAL
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// PUSH CONSTANTS : MAIN
+/////////////////////////////////////////////////////////////////////////////////////
+layout(push_constant) uniform Push 
+{
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+}push;
+/////////////////////////////////////////////////////////////////////////////////////
+// PUSH CONSTANTS : MAIN
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// HELPER FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////////////
+vec3 DecodeOctahedral(vec2 f)
+{
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+/////////////////////////////////////////////////////////////////////////////////////
+// HELPER FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////////////
+
+void main()
+{
+	vec4 modelWorldSpace = push.modelMatrix * vec4(position, 1.0f);
+	gl_Position = globalUbo.cameraData.projectionMatrix * globalUbo.cameraData.viewMatrix * modelWorldSpace;
+
+	fragNormalWorldSpace = mat3(push.normalMatrix) * DecodeOctahedral(normal);
+	fragUV = uv;
+	fragMaterialIndex = gl_InstanceIndex;
+}
@@ -0,0 +1,133 @@
+// Lights, shadow maps and the descriptor sets 0-4 shared by the forward (Basic.frag) and deferred
+// (DeferredLighting.frag) lighting shaders. Include before the surface inputs Lighting.glsl reads.
+
+/////////////////////////////////////////////////////////////////////////////////////
+// CONSTANTS
+/////////////////////////////////////////////////////////////////////////////////////
+#define MAX_POINT_LIGHTS 10
+#define MAX_SPOT_LIGHTS 10
+
+#define CASCADE_SHADOW_MAP_COUNT 4
+
+const float epsilon = 0.00001;
+const float PI = 3.14159265359;
+
+const vec3 gridSamplingDisk[20] = vec3[]
+(
+   vec3(1, 1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1, 1,  1), 
+   vec3(1, 1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1, 1, -1),
+   vec3(1, 1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1, 1,  0),
+   vec3(1, 0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1, 0, -1),
+   vec3(0, 1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0, 1, -1)
+);
+
+const mat4 biasMat = mat4( 
+  0.5, 0.0, 0.0, 0.0,
+  0.0, 0.5, 0.0, 0.0,
+  0.0, 0.0, 1.0, 0.0,
+  0.5, 0.5, 0.0, 1.0 );
+/////////////////////////////////////////////////////////////////////////////////////
+// CONSTANTS
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// SPECIALIZATION CONSTANTS
+/////////////////////////////////////////////////////////////////////////////////////
+// Baked per pipeline variant by SimpleRenderSystem (shadow quality, light types present).
+// Array sizes above stay #defines, they are part of the uniform buffer layouts.
+layout(constant_id = 0) const int ACTIVE_CASCADE_COUNT = CASCADE_SHADOW_MAP_COUNT;
+layout(constant_id = 1) const int CASCADE_PCF_RADIUS = 3;		// (2r + 1)^2 taps
+layout(constant_id = 2) const int SPOT_PCF_RADIUS = 20;
+layout(constant_id = 3) const int POINT_SHADOW_SAMPLES = 20;	// Taps of gridSamplingDisk, 20 at most
+layout(constant_id = 4) const bool DIRECTIONAL_SHADOWS = true;
+layout(constant_id = 5) const bool POINT_SHADOWS = true;
+layout(constant_id = 6) const bool SPOT_SHADOWS = true;
+layout(constant_id = 7) const bool POINT_LIGHTS = true;
+layout(constant_id = 8) const bool SPOT_LIGHTS = true;
+/////////////////////////////////////////////////////////////////////////////////////
+// SPECIALIZATION CONSTANTS
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 0 : GLOBAL
+/////////////////////////////////////////////////////////////////////////////////////
+struct PointLight
+{
+	vec4 position;     // position x,y,z
+	vec4 color;        // color r=x, g=y, b=z, a=intensity
+};
+
+struct SpotLight
+{
+	vec4 position;     // position x,y,z
+	vec4 color;        // color r=x, g=y, b=z, a=intensity
+	vec4 direction;    // direction x, y, z
+	vec4 cutOffs;      // CutOffs x=innerCutoff y=outerCutoff
+
+};
+
+struct DirectionalLight
+{
+	vec4 direction;    // direction x, y, z, w=ambientStrength
+	vec4 color;        // color r=x, g=y, b=z, a=intensity
+};
+
+struct EditorCameraData
+{
+	mat4 projectionMatrix;
+	mat4 viewMatrix;
+	mat4 inverseViewMatrix;
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo
+{
+	EditorCameraData cameraData;
+
+	DirectionalLight directionalLightData;
+
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	SpotLight spotLights[MAX_SPOT_LIGHTS];
+	int numOfActivePointLights;
+	int numOfActiveSpotLights;
+}globalUbo;
+
+layout(set = 0, binding = 1) uniform sampler2D DefaultTexture;
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 0 : GLOBAL
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 1 : DIRECTIONAL LIGHT PROJECTION FOR CASCADED SHADOW MAP
+/////////////////////////////////////////////////////////////////////////////////////
+layout(set = 1, binding = 0) uniform CascadedShadowPassUBO
+{
+	mat4 lightProjection[CASCADE_SHADOW_MAP_COUNT];
+    vec4 cascadeSplits;
+}cascadedShadowPassUBO;
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 1 : DIRECTIONAL LIGHT PROJECTION FOR CASCADED SHADOW MAP
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 2 : DIRECTIONAL LIGHT SHADOW MAP
+/////////////////////////////////////////////////////////////////////////////////////
+layout(set = 2, binding = 0) uniform sampler2DArray cascadedShadowMap;
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 2 : DIRECTIONAL LIGHT SHADOW MAP
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 3 : POINT LIGHT SHADOW CUBEMAP ARRAY
+/////////////////////////////////////////////////////////////////////////////////////
+layout (set = 3, binding = 0) uniform samplerCubeArray pointShadowCubeMap;
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 3 : POINT LIGHT SHADOW CUBEMAP ARRAY
+/////////////////////////////////////////////////////////////////////////////////////
+
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 4 : SPOT LIGHT SHADOW CUBEMAP ARRAY
+/////////////////////////////////////////////////////////////////////////////////////
+layout(set = 4, binding = 0) uniform sampler2DArray spotShadowMap;
+/////////////////////////////////////////////////////////////////////////////////////
+// DESCRIPTOR SET 4 : SPOT LIGHT SHADOW CUBEMAP ARRAY
+/////////////////////////////////////////////////////////////////////////////////////
@@ -38,7 +38,8 @@ project "VulkanGameEngine"
     links
     {
         "vulkan-1",
-        "glfw3"
+        "glfw3",
+        "shaderc_shared"    -- Shader hot reload, shipped with the Vulkan SDK
     }
 
     prebuildcommands
@@ -0,0 +1,31 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	thread_local uint64_t s_ThreadAllocationCount = 0;
+}
+
+uint64_t AllocationCounter::GetThreadAllocationCount()
+{
+	return s_ThreadAllocationCount;
+}
+
+// The array, nothrow and sized forms all forward to these two
+void* operator new(std::size_t size)
+{
+	s_ThreadAllocationCount++;
+
+	if (void* memory = std::malloc(size == 0 ? 1 : size))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts the heap allocations every thread makes through the global operator new, which
+// AllocationCounter.cpp replaces. Frame loops report the difference per frame as a profiler
+// counter, so an allocation sneaking into the hot path shows up as a step in the trace.
+namespace AllocationCounter
+{
+	// Allocations made by the calling thread since it started
+	uint64_t GetThreadAllocationCount();
+}
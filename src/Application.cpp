@@ -5,7 +5,12 @@
 #include "Graphics/Camera.h"
 #include "Graphics/Buffer.h"
 #include "Graphics/CameraSystem.h"
+#include "Graphics/PipelineManager.h"
+#include "Graphics/UploadManager.h"
+#include "Graphics/RenderStats.h"
 #include "Instrumentation.h"
+#include "AllocationCounter.h"
+#include "FrameArena.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -15,8 +20,11 @@
 #include<array>
 #include<stdexcept>
 #include <cassert>
+#include <cstdio>
 #include <chrono>
+#include <exception>
 #include <iostream>
+#include <thread>
 
 Coordinator m_Coord;
 
@@ -45,14 +53,11 @@ std::vector<std::pair<glm::vec3, float>> posAngle
 int camCount = 0;
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
-Application::Application()
+Application::Application(RenderPath renderPath, const PresentSettings& presentSettings) 
+    : m_Renderer(m_AppWindow, m_Device, presentSettings), m_RenderPath(renderPath)
 {
-    m_GlobalPool = DescriptorPool::Builder(m_Device)
-        .setMaxSets(1000)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000)
-        .build();
+    // Grows by chaining pools, nothing has to be sized for the whole scene up front
+    m_DescriptorAllocator = std::make_unique<DescriptorAllocator>(m_Device);
 }
 
 Application::~Application()
@@ -62,17 +67,6 @@ Application::~Application()
 
 void Application::Run()
 {
-    std::vector<std::unique_ptr<Buffer>> uboBuffers(SwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < uboBuffers.size(); i++) {
-        uboBuffers[i] = std::make_unique<Buffer>(
-            m_Device,
-            sizeof(GlobalUBO),
-            1,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-        uboBuffers[i]->map();
-    }
-
     std::shared_ptr<Texture> texture = std::make_shared<Texture>(m_Device, "Assets/Textures/Ground.png");
 
     VkDescriptorImageInfo imageInfo = {};
@@ -80,33 +74,26 @@ void Application::Run()
     imageInfo.imageView = texture->GetImageView();
     imageInfo.imageLayout = texture->GetImageLayout();
 
+    // The GlobalUBO lives in the frame uniform allocator, one set serves every frame through its dynamic offset
     auto globalSetLayout = DescriptorSetLayout::Builder(m_Device)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS)
         .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
         .build();
 
-    auto materialSetLayout = DescriptorSetLayout::Builder(m_Device)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-        .build();
-
-    std::vector<VkDescriptorSet> globalDescriptorSets(SwapChain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < globalDescriptorSets.size(); i++)
-    {
-        auto bufferInfo = uboBuffers[i]->descriptorInfo();
-        DescriptorWriter(*globalSetLayout, *m_GlobalPool)
-            .writeBuffer(0, &bufferInfo)
-            .writeImage(1, &imageInfo)
-            .build(globalDescriptorSets[i]);
-    }
-
 
+    VkDescriptorSet globalDescriptorSet;
+    auto bufferInfo = m_Renderer.GetFrameUniformAllocator().DescriptorInfo(sizeof(GlobalUBO));
+    DescriptorWriter(*globalSetLayout, *m_DescriptorAllocator)
+        .writeBuffer(0, &bufferInfo)
+        .writeImage(1, &imageInfo)
+        .build(globalDescriptorSet);
 
-     m_Models.push_back(std::make_shared<Model>(m_Device, "Assets/Models/Cube/Cube.gltf", *materialSetLayout, *m_GlobalPool));
-     m_Models.push_back(std::make_shared<Model>(m_Device, "Assets/Models/Plane/Plane.gltf", *materialSetLayout, *m_GlobalPool));
-     m_Models.push_back(std::make_shared<Model>(m_Device, "Assets/Models/Sponza/Sponza.gltf", *materialSetLayout, *m_GlobalPool));
-     //m_Models.push_back(std::make_shared<Model>(m_Device, "Assets/Models/MetalRoughSpheres/MetalRoughSpheres.gltf", *materialSetLayout, *m_GlobalPool));
+    m_MaterialLibrary = std::make_unique<MaterialLibrary>(m_Device);
+    m_GeometryArena = std::make_shared<GeometryArena>(m_Device, sizeof(Model::PackedVertex));
+     m_Models.push_back(std::make_shared<Model>(m_Device, "Assets/Models/Cube/Cube.gltf", *m_MaterialLibrary, m_GeometryArena));
+     m_Models.push_back(std::make_shared<Model>(m_Device, "Assets/Models/Plane/Plane.gltf", *m_MaterialLibrary, m_GeometryArena));
+     m_Models.push_back(std::make_shared<Model>(m_Device, "Assets/Models/Sponza/Sponza.gltf", *m_MaterialLibrary, m_GeometryArena));
+     //m_Models.push_back(std::make_shared<Model>(m_Device, "Assets/Models/MetalRoughSpheres/MetalRoughSpheres.gltf", *m_MaterialLibrary, m_GeometryArena));
 
 
     m_Coord.RegisterComponent<ModelComponent>();
@@ -114,12 +101,14 @@ void Application::Run()
     m_Coord.RegisterComponent<LightObjectComponent>();
 
     m_SetLayouts.push_back(globalSetLayout->getDescriptorSetLayout());
-    m_SetLayouts.push_back(materialSetLayout->getDescriptorSetLayout());
-    std::shared_ptr<SimpleRenderSystem> simpleRenderSystem = m_Coord.RegisterSystem<SimpleRenderSystem>(m_Device, m_Renderer.GetSwapChainRenderPass(), m_SetLayouts, *m_GlobalPool);
+    m_SetLayouts.push_back(m_MaterialLibrary->GetDescriptorSetLayout());
+    std::shared_ptr<SimpleRenderSystem> simpleRenderSystem = m_Coord.RegisterSystem<SimpleRenderSystem>(m_Device, m_Renderer.GetSwapChainRenderPass(), m_SetLayouts, *m_DescriptorAllocator, m_Renderer.GetFrameUniformAllocator(), m_RenderPath);
     Signature simple;
     simple.set(m_Coord.GetComponentID<ModelComponent>());
     simple.set(m_Coord.GetComponentID<ECSTransformComponent>());
     m_Coord.SetSystemSignature<SimpleRenderSystem>(simple);
+    simpleRenderSystem->SetDepthPrepassMode(SimpleRenderSystem::DepthPrepassMode::AUTO);
+    simpleRenderSystem->SetShadowQuality(SimpleRenderSystem::ShadowQuality::HIGH);
 
     std::shared_ptr<PointLightRenderSystem> pointLightRenderSystem = m_Coord.RegisterSystem<PointLightRenderSystem>(m_Device, m_Renderer.GetSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout());
     Signature point;
@@ -128,110 +117,294 @@ void Application::Run()
     m_Coord.SetSystemSignature<PointLightRenderSystem>(point);
     
     LoadGameObjects();
+    m_Device.getMemoryAllocator().PrintStats();
 
     CameraSystem cameraSystem{};
     cameraSystem.SetViewTarget(glm::vec3(0.0f, -8.0f, -12.0f), glm::vec3(0.0f, -0.5f, 0.0f));
     cameraSystem.UpdateEditorCameraTransform(glm::vec3(0.0f, -8.0f, -12.0f), glm::vec3(-0.40f, 0.0f, 0.0f));
 
+    // Two snapshots : the simulation fills frame N+1 while the render thread records frame N
+    for (int i = 0; i < SNAPSHOT_COUNT; i++)
+    {
+        m_FreeSnapshots.Push(std::make_unique<RenderSnapshot>());
+    }
+
+    // Records and submits every frame, only reads the snapshots the simulation hands over
+    std::exception_ptr renderError;
+    std::thread renderThread([&]()
+    {
+        try
+        {
+            Instrumentor::Get().SetThreadName("Render");
+            std::unique_ptr<RenderSnapshot> snapshot;
+            while (m_Snapshots.Pop(snapshot))
+            {
+                PROFILE_SCOPE("RenderLoop");
+                FrameArena& frameArena = FrameArena::ForThread();
+                frameArena.Reset();
+                uint64_t allocationCount = AllocationCounter::GetThreadAllocationCount();
+
+                m_Renderer.MarkInputSampled(snapshot->inputSampleTime);
+
+                auto acquireStart = std::chrono::high_resolution_clock::now();
+                if (auto commandBuffer = m_Renderer.BeginFrame())
+                {
+                    auto recordStart = std::chrono::high_resolution_clock::now();
+                    // Frame boundary : pipelines finished (or hot reloaded) since the last frame are swapped in here
+                    m_Device.getPipelineManager().Update();
+                    RenderStats::Get().BeginFrame();
+
+                    int frameIndex = m_Renderer.GetFrameIndex();
+                    FrameInfo frameInfo{ frameIndex, snapshot->frameTime, commandBuffer, snapshot->camera, globalDescriptorSet, m_MaterialLibrary->GetDescriptorSet(), m_Renderer.GetFrameUniformAllocator(), m_Renderer.GetGpuProfiler(), 0, *snapshot };
+
+                    // Every model draws out of the arena, its streams stay bound for all passes of the frame
+                    m_GeometryArena->Bind(commandBuffer);
+
+                    // Update
+                    GlobalUBO ubo = snapshot->ubo;
+                    frameInfo.globalUBOOffset = frameInfo.frameUniforms.Push(ubo);
+                    simpleRenderSystem->UpdateLodSelection(frameInfo);
+                    simpleRenderSystem->UpdateOcclusionCulling(frameInfo);
+                    simpleRenderSystem->SelectLightingVariants(ubo);
+                    //simpleRenderSystem->RenderShadowPass(frameInfo, ubo);
+                    simpleRenderSystem->RenderCascadedShadowPass(frameInfo, ubo);
+                    simpleRenderSystem->RenderPointShadowPass(frameInfo, ubo);
+                    simpleRenderSystem->RenderSpotShadowPass(frameInfo, ubo);
+                    if (m_RenderPath == RenderPath::DEFERRED)
+                    {
+                        simpleRenderSystem->RenderGBufferPass(frameInfo, m_Renderer.GetSwapChainExtent());
+                    }
+                    else
+                    {
+                        simpleRenderSystem->UpdateDepthPrepass(frameInfo, m_Renderer.GetSwapChainExtent());
+                    }
+
+                    // Render
+                    m_Renderer.BeginSwapChainRenderPass(commandBuffer);
+
+                    // order matters
+                    // solid objects first, then transparent
+                    if (m_RenderPath == RenderPath::DEFERRED)
+                    {
+                        simpleRenderSystem->RenderDeferredLightingPass(frameInfo);
+                    }
+                    else
+                    {
+                        simpleRenderSystem->RenderMainPass(frameInfo);
+                    }
+                    pointLightRenderSystem->Render(frameInfo, ubo);
+
+                    m_Renderer.EndSwapChainRenderPass(commandBuffer);
+                    // Submitted ahead of the frame, so anything uploaded while recording it is ready when it runs
+                    m_Device.getUploadManager().Update();
+                    m_Renderer.EndFrame();
+                    RenderStats::Get().EndFrame();
+                    auto recordEnd = std::chrono::high_resolution_clock::now();
+
+                    // GPU time and latency are the latest frames read back, one or two frames behind this one
+                    FrameMetrics::Sample sample;
+                    sample.milliseconds[FrameMetrics::FRAME_TIME] = snapshot->frameTime * 1000.0f;
+                    sample.milliseconds[FrameMetrics::SIMULATION] = snapshot->simulationTime;
+                    sample.milliseconds[FrameMetrics::ACQUIRE] = std::chrono::duration<float, std::milli>(recordStart - acquireStart).count();
+                    sample.milliseconds[FrameMetrics::RECORD] = std::chrono::duration<float, std::milli>(recordEnd - recordStart).count();
+                    sample.milliseconds[FrameMetrics::GPU] = m_Renderer.GetGpuProfiler().GetFrameGpuTime();
+                    sample.milliseconds[FrameMetrics::INPUT_LATENCY] = m_Renderer.GetInputLatency() * 1000.0f;
+                    m_FrameMetrics.Record(sample);
+
+                    if (snapshot->metricsOverlay && m_FrameMetrics.GetRecordedFrames() % METRICS_SUMMARY_INTERVAL == 0)
+                    {
+                        m_FrameMetrics.Publish(m_FrameMetrics.Summarize());
+                    }
+                }
+
+                if (snapshot->dumpRenderStats)
+                {
+                    RenderStats::Get().Dump(std::cout);
+                }
+
+                PROFILE_COUNTER("RenderThreadAllocations", static_cast<double>(AllocationCounter::GetThreadAllocationCount() - allocationCount));
+                PROFILE_COUNTER("RenderThreadArena(KB)", frameArena.GetUsedBytes() / 1024.0);
+
+                // Recorded, the simulation can overwrite it
+                m_FreeSnapshots.Push(std::move(snapshot));
+            }
+            RenderStats::Get().Dump(std::cout);
+        }
+        catch (...)
+        {
+            renderError = std::current_exception();
+            m_FreeSnapshots.Close();
+        }
+    });
+
     auto currenTime = std::chrono::high_resolution_clock::now();
 
     float limit = 300.0f;
+    bool profileKeyDown = false;
+    bool statsKeyDown = false;
+    bool metricsKeyDown = false;
+    bool metricsOverlay = false;
+    auto overlayUpdateTime = currenTime;
 
    
     //glfwSetKeyCallback(m_AppWindow.GetWindow(), key_callback);
 
+    // Simulation : owns input and the ECS, runs at most one frame ahead of the render thread
+    Instrumentor::Get().SetThreadName("Simulation");
 	while (!m_AppWindow.ShouldClose())
 	{
-        PROFILE_SCOPE("RunLoop");
+        PROFILE_SCOPE("SimulationLoop");
+        FrameArena::ForThread().Reset();
+        uint64_t allocationCount = AllocationCounter::GetThreadAllocationCount();
+
+        // Wait before sampling input, not after, so the frame starts with the freshest input
+        m_Renderer.LimitFrameRate();
 		glfwPollEvents();
+        // Minimized : the render thread skips frames and hands snapshots straight back, sleep on events instead of spinning
+        while (!m_AppWindow.ShouldClose() && (m_AppWindow.GetExtent().width == 0 || m_AppWindow.GetExtent().height == 0))
+        {
+            glfwWaitEvents();
+        }
 
         auto newTime = std::chrono::high_resolution_clock::now();
         float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currenTime).count();
         currenTime = newTime;
 
-        std::cout << "FrameTime : " << frameTime * 1000.0f << "\n";
-
         cameraSystem.EditorCameraInput(m_AppWindow.GetWindow(), frameTime);
         //cameraSystem.UpdateEditorCameraTransform(posAngle[camCount].first, glm::vec3(posAngle[camCount].second, 0.0f, 0.0f));
-        float aspect = m_Renderer.GetAspectRatio();
-        cameraSystem.SetPerspectiveProjectionEditorCam(glm::radians(60.0f), aspect, 0.1f, 100.0f);
-        
-       
-
-		if (auto commandBuffer = m_Renderer.BeginFrame())
-		{
-            int frameIndex = m_Renderer.GetFrameIndex();
-            FrameInfo frameInfo{ frameIndex, frameTime, commandBuffer, cameraSystem, globalDescriptorSets[frameIndex]};
-
-            float lightSpd = 1.0f;
-            if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_L) == GLFW_PRESS)
-            {
-                pointLightRenderSystem->point.x -= lightSpd;
-                if (pointLightRenderSystem->point.x < -limit)
-                    pointLightRenderSystem->point.x = -limit;
-            }
+        // The swap chain belongs to the render thread, the window extent it follows is close enough
+        VkExtent2D extent = m_AppWindow.GetExtent();
+        if (extent.width > 0 && extent.height > 0)
+        {
+            float aspect = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+            cameraSystem.SetPerspectiveProjectionEditorCam(glm::radians(60.0f), aspect, 0.1f, 100.0f);
+        }
 
-            if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_J) == GLFW_PRESS)
-            {
-                pointLightRenderSystem->point.x += lightSpd;
-                if (pointLightRenderSystem->point.x > limit)
-                    pointLightRenderSystem->point.x = limit;
-            }
+        // P pauses and resumes the profiler capture, the session file stays open
+        bool profileKeyPressed = glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_P) == GLFW_PRESS;
+        if (profileKeyPressed && !profileKeyDown)
+        {
+            Instrumentor::Get().SetCaptureEnabled(!Instrumentor::Get().IsCaptureEnabled());
+        }
+        profileKeyDown = profileKeyPressed;
 
-            if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_I) == GLFW_PRESS)
-            {
-                pointLightRenderSystem->point.z += lightSpd;
-                if (pointLightRenderSystem->point.z > limit)
-                    pointLightRenderSystem->point.z = limit;
-            }
+        // F3 prints the render stats, the render thread owns them
+        bool statsKeyPressed = glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_F3) == GLFW_PRESS;
+        bool dumpRenderStats = statsKeyPressed && !statsKeyDown;
+        statsKeyDown = statsKeyPressed;
 
-            if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_K) == GLFW_PRESS)
-            {
-                pointLightRenderSystem->point.z -= lightSpd;
-                if (pointLightRenderSystem->point.z < -limit)
-                    pointLightRenderSystem->point.z = -limit;
-            }
+        // F2 shows the frame metric percentiles in the window title, refreshed a few times a second
+        bool metricsKeyPressed = glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_F2) == GLFW_PRESS;
+        if (metricsKeyPressed && !metricsKeyDown)
+        {
+            metricsOverlay = !metricsOverlay;
+            m_AppWindow.SetTitleOverlay("");
+        }
+        metricsKeyDown = metricsKeyPressed;
 
-            if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_O) == GLFW_PRESS)
+        if (metricsOverlay && newTime - overlayUpdateTime > std::chrono::milliseconds(250))
+        {
+            overlayUpdateTime = newTime;
+            FrameMetrics::Summary summary = m_FrameMetrics.GetPublished();
+            if (summary.frameCount > 0)
             {
-                pointLightRenderSystem->point.y -= lightSpd;
-                if (pointLightRenderSystem->point.y < -limit)
-                    pointLightRenderSystem->point.y = -limit;
+                const FrameMetrics::Percentiles& frame = summary.metrics[FrameMetrics::FRAME_TIME];
+                char overlay[160];
+                snprintf(overlay, sizeof(overlay), "Frame p50 %.2f p95 %.2f p99 %.2f ms | 1%% low %.0f fps | GPU p50 %.2f ms | Latency p50 %.1f ms",
+                    frame.p50, frame.p95, frame.p99, summary.onePercentLowFps,
+                    summary.metrics[FrameMetrics::GPU].p50, summary.metrics[FrameMetrics::INPUT_LATENCY].p50);
+                m_AppWindow.SetTitleOverlay(overlay);
             }
+        }
 
-            if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_U) == GLFW_PRESS)
-            {
-                pointLightRenderSystem->point.y += lightSpd;
-                if (pointLightRenderSystem->point.y > limit)
-                    pointLightRenderSystem->point.y = limit;
-            }
+        float lightSpd = 1.0f;
+        if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_L) == GLFW_PRESS)
+        {
+            pointLightRenderSystem->point.x -= lightSpd;
+            if (pointLightRenderSystem->point.x < -limit)
+                pointLightRenderSystem->point.x = -limit;
+        }
+
+        if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_J) == GLFW_PRESS)
+        {
+            pointLightRenderSystem->point.x += lightSpd;
+            if (pointLightRenderSystem->point.x > limit)
+                pointLightRenderSystem->point.x = limit;
+        }
 
-            // Update
-            GlobalUBO ubo {};
-            ubo.cameraData.projectionMatrix = cameraSystem.GetProjection();
-            ubo.cameraData.viewMatrix = cameraSystem.GetView();
-            ubo.cameraData.inverseViewMatrix = cameraSystem.GetInverseView();
-            pointLightRenderSystem->Update(frameInfo, ubo);
-            uboBuffers[frameIndex]->writeToBuffer(&ubo);
-            uboBuffers[frameIndex]->flush();
-            //simpleRenderSystem->RenderShadowPass(frameInfo, ubo);
-            simpleRenderSystem->RenderCascadedShadowPass(frameInfo, ubo);
-            simpleRenderSystem->RenderPointShadowPass(frameInfo, ubo);
-            simpleRenderSystem->RenderSpotShadowPass(frameInfo, ubo);
-
-            // Render
-			m_Renderer.BeginSwapChainRenderPass(commandBuffer);
-
-            // order matters
-            // solid objects first, then transparent
-            simpleRenderSystem->RenderMainPass(frameInfo);
-			pointLightRenderSystem->Render(frameInfo, ubo);
-
-			m_Renderer.EndSwapChainRenderPass(commandBuffer);
-			m_Renderer.EndFrame();
-		}
+        if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_I) == GLFW_PRESS)
+        {
+            pointLightRenderSystem->point.z += lightSpd;
+            if (pointLightRenderSystem->point.z > limit)
+                pointLightRenderSystem->point.z = limit;
+        }
+
+        if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_K) == GLFW_PRESS)
+        {
+            pointLightRenderSystem->point.z -= lightSpd;
+            if (pointLightRenderSystem->point.z < -limit)
+                pointLightRenderSystem->point.z = -limit;
+        }
+
+        if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_O) == GLFW_PRESS)
+        {
+            pointLightRenderSystem->point.y -= lightSpd;
+            if (pointLightRenderSystem->point.y < -limit)
+                pointLightRenderSystem->point.y = -limit;
+        }
+
+        if (glfwGetKey(m_AppWindow.GetWindow(), GLFW_KEY_U) == GLFW_PRESS)
+        {
+            pointLightRenderSystem->point.y += lightSpd;
+            if (pointLightRenderSystem->point.y > limit)
+                pointLightRenderSystem->point.y = limit;
+        }
+
+        // Blocks while the render thread is a frame behind
+        auto waitStart = std::chrono::high_resolution_clock::now();
+        std::unique_ptr<RenderSnapshot> snapshot;
+        if (!m_FreeSnapshots.Pop(snapshot))
+        {
+            break;
+        }
+        auto waitEnd = std::chrono::high_resolution_clock::now();
+
+        snapshot->frameTime = frameTime;
+        snapshot->inputSampleTime = newTime;
+        snapshot->dumpRenderStats = dumpRenderStats;
+        snapshot->metricsOverlay = metricsOverlay;
+        snapshot->camera = cameraSystem;
+        snapshot->ubo = GlobalUBO{};
+        snapshot->ubo.cameraData.projectionMatrix = cameraSystem.GetProjection();
+        snapshot->ubo.cameraData.viewMatrix = cameraSystem.GetView();
+        snapshot->ubo.cameraData.inverseViewMatrix = cameraSystem.GetInverseView();
+        pointLightRenderSystem->Update(*snapshot);
+        simpleRenderSystem->GatherRenderObjects(snapshot->objects);
+        snapshot->simulationTime = std::chrono::duration<float, std::milli>((waitStart - newTime) + (std::chrono::high_resolution_clock::now() - waitEnd)).count();
+
+        m_Snapshots.Push(std::move(snapshot));
+
+        PROFILE_COUNTER("SimulationThreadAllocations", static_cast<double>(AllocationCounter::GetThreadAllocationCount() - allocationCount));
 	}
 
+    // The render thread finishes the snapshot it holds, then runs out
+    m_Snapshots.Close();
+    renderThread.join();
+
+    if (renderError)
+    {
+        std::rethrow_exception(renderError);
+    }
+
+    // The render thread is joined, its history can be read here
+    FrameMetrics::Summary summary = m_FrameMetrics.Summarize();
+    if (!m_FrameMetrics.WriteCsv("FrameMetrics.csv") || !m_FrameMetrics.WriteJson("FrameMetrics.json", summary))
+    {
+        std::cerr << "failed to write frame metrics\n";
+    }
+    const FrameMetrics::Percentiles& frame = summary.metrics[FrameMetrics::FRAME_TIME];
+    std::cout << "Frame time over the last " << summary.frameCount << " frames : p50 " << frame.p50 << " ms, p95 " << frame.p95
+        << " ms, p99 " << frame.p99 << " ms, 1% low " << summary.onePercentLowFps << " fps\n";
 }
 
 void Application::LoadGameObjects()
@@ -262,7 +435,7 @@ void Application::LoadGameObjects()
     float groundSize = 40.0f;
     Entity ground = m_Coord.CreateEntity();
     m_Coord.AddComponent<ECSTransformComponent>(ground, ECSTransformComponent{ glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f), glm::vec3(1.0f * groundSize, 0.05f, 1.0f * groundSize) });
-    m_Coord.AddComponent<ModelComponent>(ground, ModelComponent{ m_Models[0] });
+    m_Coord.AddComponent<ModelComponent>(ground, ModelComponent{ m_Models[0], true });
 
 
     //Room
@@ -271,7 +444,7 @@ void Application::LoadGameObjects()
 
     Entity room_ground = m_Coord.CreateEntity();
     m_Coord.AddComponent<ECSTransformComponent>(room_ground, ECSTransformComponent{ glm::vec3(0.0f, 0.0f, 0.0f) + roomDisplacement, glm::vec3(0.0f), glm::vec3(1.0f * roomSize, 0.05f, 1.0f * roomSize) });
-    m_Coord.AddComponent<ModelComponent>(room_ground, ModelComponent{ m_Models[0] });
+    m_Coord.AddComponent<ModelComponent>(room_ground, ModelComponent{ m_Models[0], true });
 
     //Entity left_wall = m_Coord.CreateEntity();
     //m_Coord.AddComponent<ECSTransformComponent>(left_wall, ECSTransformComponent{ glm::vec3(-1.0f * roomSize, -1.0f * roomSize, 0.0f) + roomDisplacement, glm::vec3(0.0f), glm::vec3(0.05f, 1.0f * roomSize, 1.0f * roomSize) });
@@ -294,11 +467,11 @@ void Application::LoadGameObjects()
     //Room Cubes
     Entity cube = m_Coord.CreateEntity();
     m_Coord.AddComponent<ECSTransformComponent>(cube, ECSTransformComponent{ glm::vec3(-3.0f, -2.0f, 0.0f) + roomDisplacement, glm::vec3(0.0f), glm::vec3(1.0f) });
-    m_Coord.AddComponent<ModelComponent>(cube, ModelComponent{ m_Models[0] });
+    m_Coord.AddComponent<ModelComponent>(cube, ModelComponent{ m_Models[0], true });
 
     Entity cubeTwo = m_Coord.CreateEntity();
     m_Coord.AddComponent<ECSTransformComponent>(cubeTwo, ECSTransformComponent{ glm::vec3(2.0f, -1.0f, 0.0f) + roomDisplacement, glm::vec3(0.0f), glm::vec3(0.5f) });
-    m_Coord.AddComponent<ModelComponent>(cubeTwo, ModelComponent{ m_Models[0] });
+    m_Coord.AddComponent<ModelComponent>(cubeTwo, ModelComponent{ m_Models[0], true });
 
 
     //Room Coords
@@ -2,7 +2,10 @@
 #include "Window.h"
 #include "Graphics/Renderer.h"
 #include "Graphics/Descriptor.h"
+#include "Graphics/FrameInfo.h"
 #include "Model.h"
+#include "BoundedQueue.h"
+#include "FrameMetrics.h"
 
 #include <memory>
 #include <vector>
@@ -12,8 +15,12 @@ class Application
 public:
 	static constexpr int WIDTH = 800;
 	static constexpr int HEIGHT = 600;
+	// Snapshots shared by the simulation and render threads, the simulation runs at most one frame ahead
+	static constexpr int SNAPSHOT_COUNT = 2;
+	// Frames between summaries while the metrics overlay is shown, sorting the whole history is not free
+	static constexpr uint32_t METRICS_SUMMARY_INTERVAL = 30;
 
-	Application();
+	Application(RenderPath renderPath = RenderPath::FORWARD, const PresentSettings& presentSettings = PresentSettings{});
 	~Application();
 
 	Application(const Application&) = delete;
@@ -29,9 +36,20 @@ private:
 	Device m_Device{ m_AppWindow };
 	Renderer m_Renderer{ m_AppWindow, m_Device };
 
-	std::unique_ptr<DescriptorPool> m_GlobalPool{};
+	RenderPath m_RenderPath;
+
+	std::unique_ptr<DescriptorAllocator> m_DescriptorAllocator{};
 	std::vector<VkDescriptorSetLayout> m_SetLayouts;
+	std::unique_ptr<MaterialLibrary> m_MaterialLibrary;
+	std::shared_ptr<GeometryArena> m_GeometryArena;
 	std::vector<std::shared_ptr<Model>> m_Models;
 
+	// Simulation to render thread, and the recorded snapshots back for reuse
+	BoundedQueue<std::unique_ptr<RenderSnapshot>> m_Snapshots{ SNAPSHOT_COUNT };
+	BoundedQueue<std::unique_ptr<RenderSnapshot>> m_FreeSnapshots{ SNAPSHOT_COUNT };
+
+	// Recorded by the render thread, written to FrameMetrics.csv and FrameMetrics.json at exit
+	FrameMetrics m_FrameMetrics;
+
 	glm::vec3 lightDir {-30.0f, 30.0f, 10.0f};
 };
\ No newline at end of file
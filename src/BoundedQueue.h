@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Blocking FIFO of fixed capacity between threads. Push waits while it is full, Pop while it is
+// empty, so the faster side can never run more than capacity items ahead of the slower one.
+// Close wakes every waiter for good, either side uses it to shut the other down.
+template<typename T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity) : m_Capacity(capacity) {}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	// False once closed, value is dropped
+	bool Push(T value)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_NotFull.wait(lock, [this]() { return m_Closed || m_Items.size() < m_Capacity; });
+		if (m_Closed)
+		{
+			return false;
+		}
+
+		m_Items.push_back(std::move(value));
+		lock.unlock();
+		m_NotEmpty.notify_one();
+		return true;
+	}
+
+	// False once closed and drained
+	bool Pop(T& value)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_NotEmpty.wait(lock, [this]() { return m_Closed || !m_Items.empty(); });
+		if (m_Items.empty())
+		{
+			return false;
+		}
+
+		value = std::move(m_Items.front());
+		m_Items.pop_front();
+		lock.unlock();
+		m_NotFull.notify_one();
+		return true;
+	}
+
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Closed = true;
+		}
+		m_NotFull.notify_all();
+		m_NotEmpty.notify_all();
+	}
+
+private:
+	const size_t m_Capacity;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_NotFull;
+	std::condition_variable m_NotEmpty;
+	std::deque<T> m_Items;
+	bool m_Closed = false;
+};
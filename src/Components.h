@@ -395,6 +395,7 @@ private:
 struct ModelComponent
 {
 	std::shared_ptr<Model> model;
+	bool occluder = false;	// Rasterized into the CPU occlusion buffer
 };
 
 struct ECSTransformComponent
@@ -0,0 +1,80 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+FrameArena::FrameArena(size_t blockSize) : m_BlockSize(blockSize)
+{
+}
+
+FrameArena& FrameArena::ForThread()
+{
+	static thread_local FrameArena arena;
+	return arena;
+}
+
+void FrameArena::Reset()
+{
+	// Last frame spilled over, one block big enough for all of it keeps the next one off the heap
+	if (m_Blocks.size() > 1)
+	{
+		size_t capacity = GetCapacity();
+		m_Blocks.clear();
+		AddBlock(capacity);
+	}
+
+	m_Head = 0;
+	m_UsedBytes = 0;
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	// Aligned on the address, blocks only come with the default new alignment
+	size_t offset = 0;
+	if (!m_Blocks.empty())
+	{
+		uintptr_t base = reinterpret_cast<uintptr_t>(m_Blocks.back().data.get());
+		offset = AlignUp(base + m_Head, alignment) - base;
+	}
+
+	if (m_Blocks.empty() || offset + size > m_Blocks.back().size)
+	{
+		AddBlock(size + alignment);
+		uintptr_t base = reinterpret_cast<uintptr_t>(m_Blocks.back().data.get());
+		offset = AlignUp(base, alignment) - base;
+	}
+
+	m_UsedBytes += offset - m_Head + size;
+	m_Head = offset + size;
+	return m_Blocks.back().data.get() + offset;
+}
+
+size_t FrameArena::GetCapacity() const
+{
+	size_t capacity = 0;
+	for (const Block& block : m_Blocks)
+	{
+		capacity += block.size;
+	}
+	return capacity;
+}
+
+void FrameArena::AddBlock(size_t minSize)
+{
+	size_t size = std::max(m_BlockSize, minSize);
+	if (!m_Blocks.empty())
+	{
+		size = std::max(size, m_Blocks.back().size * 2);
+	}
+
+	m_Blocks.push_back({ std::make_unique<std::byte[]>(size), size });
+	m_Head = 0;
+}
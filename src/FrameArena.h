@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Linear allocator for memory that only lives until the end of the frame. Allocations bump an
+// offset and are never freed one by one, Reset drops them all at once. A frame that overflows the
+// block gets more, Reset then merges them into one block that fits, so steady frames never touch the heap.
+// One per thread through ForThread, every frame loop resets its own at the start of a frame.
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t blockSize = 64 * 1024);
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// The calling thread's arena, its first block is allocated on first use
+	static FrameArena& ForThread();
+
+	// Everything allocated since the last reset becomes invalid
+	void Reset();
+
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	template<typename T>
+	T* AllocateArray(size_t count) { return static_cast<T*>(Allocate(count * sizeof(T), alignof(T))); }
+
+	size_t GetUsedBytes() const { return m_UsedBytes; }
+	size_t GetCapacity() const;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<std::byte[]> data;
+		size_t size;
+	};
+
+	void AddBlock(size_t minSize);
+
+	size_t m_BlockSize;
+	std::vector<Block> m_Blocks;	// Allocating from the last one
+	size_t m_Head = 0;				// Offset in the last block
+	size_t m_UsedBytes = 0;
+};
+
+// STL allocator over a FrameArena, deallocate does nothing. Containers using it must not outlive the frame
+template<typename T>
+class FrameArenaAllocator
+{
+public:
+	using value_type = T;
+
+	FrameArenaAllocator() : m_Arena(&FrameArena::ForThread()) {}
+	explicit FrameArenaAllocator(FrameArena& arena) : m_Arena(&arena) {}
+	template<typename U>
+	FrameArenaAllocator(const FrameArenaAllocator<U>& other) : m_Arena(other.m_Arena) {}
+
+	T* allocate(size_t count) { return m_Arena->AllocateArray<T>(count); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const FrameArenaAllocator<U>& other) const { return m_Arena == other.m_Arena; }
+	template<typename U>
+	bool operator!=(const FrameArenaAllocator<U>& other) const { return m_Arena != other.m_Arena; }
+
+private:
+	template<typename U>
+	friend class FrameArenaAllocator;
+
+	FrameArena* m_Arena;
+};
+
+// Scratch vector for the frame being built, allocates from the calling thread's arena
+template<typename T>
+using FrameVector = std::vector<T, FrameArenaAllocator<T>>;
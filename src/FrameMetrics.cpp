@@ -0,0 +1,147 @@
+#include "FrameMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+namespace
+{
+	const char* const METRIC_NAMES[FrameMetrics::METRIC_COUNT] =
+	{
+		"FrameTime", "Simulation", "Acquire", "Record", "GPU", "InputLatency"
+	};
+
+	// Nearest rank on sorted values
+	float Percentile(const std::vector<float>& sorted, float fraction)
+	{
+		size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+		return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+	}
+}
+
+FrameMetrics::FrameMetrics()
+	: m_Samples(CAPACITY)
+{
+	m_Scratch.reserve(CAPACITY);
+}
+
+void FrameMetrics::Record(const Sample& sample)
+{
+	m_Samples[m_Head] = sample;
+	m_Head = (m_Head + 1) % CAPACITY;
+	m_Count = std::min(m_Count + 1, CAPACITY);
+	m_RecordedFrames++;
+}
+
+FrameMetrics::Summary FrameMetrics::Summarize()
+{
+	Summary summary{};
+	summary.frameCount = m_Count;
+	if (m_Count == 0)
+	{
+		return summary;
+	}
+
+	for (uint32_t metric = 0; metric < METRIC_COUNT; metric++)
+	{
+		m_Scratch.clear();
+		for (uint32_t i = 0; i < m_Count; i++)
+		{
+			m_Scratch.push_back(m_Samples[i].milliseconds[metric]);
+		}
+		std::sort(m_Scratch.begin(), m_Scratch.end());
+
+		Percentiles& percentiles = summary.metrics[metric];
+		percentiles.p50 = Percentile(m_Scratch, 0.50f);
+		percentiles.p95 = Percentile(m_Scratch, 0.95f);
+		percentiles.p99 = Percentile(m_Scratch, 0.99f);
+		percentiles.max = m_Scratch.back();
+		percentiles.mean = std::accumulate(m_Scratch.begin(), m_Scratch.end(), 0.0f) / m_Count;
+
+		if (metric == FRAME_TIME)
+		{
+			// Slowest 1%, at least one frame
+			size_t slowCount = std::max<size_t>(m_Count / 100, 1);
+			float slowMean = std::accumulate(m_Scratch.end() - slowCount, m_Scratch.end(), 0.0f) / slowCount;
+			summary.onePercentLowFps = slowMean > 0.0f ? 1000.0f / slowMean : 0.0f;
+		}
+	}
+	return summary;
+}
+
+void FrameMetrics::Publish(const Summary& summary)
+{
+	std::lock_guard<std::mutex> lock(m_PublishedMutex);
+	m_Published = summary;
+}
+
+FrameMetrics::Summary FrameMetrics::GetPublished() const
+{
+	std::lock_guard<std::mutex> lock(m_PublishedMutex);
+	return m_Published;
+}
+
+bool FrameMetrics::WriteCsv(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+
+	file << "Frame";
+	for (uint32_t metric = 0; metric < METRIC_COUNT; metric++)
+	{
+		file << "," << METRIC_NAMES[metric] << "(ms)";
+	}
+	file << "\n";
+
+	uint32_t oldest = (m_Head + CAPACITY - m_Count) % CAPACITY;
+	uint64_t firstFrame = m_RecordedFrames - m_Count;
+	for (uint32_t i = 0; i < m_Count; i++)
+	{
+		const Sample& sample = m_Samples[(oldest + i) % CAPACITY];
+		file << firstFrame + i;
+		for (float value : sample.milliseconds)
+		{
+			file << "," << value;
+		}
+		file << "\n";
+	}
+	return static_cast<bool>(file);
+}
+
+bool FrameMetrics::WriteJson(const std::string& path, const Summary& summary) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+
+	file << "{\n";
+	file << "  \"recordedFrames\": " << m_RecordedFrames << ",\n";
+	file << "  \"windowFrames\": " << summary.frameCount << ",\n";
+	file << "  \"onePercentLowFps\": " << summary.onePercentLowFps << ",\n";
+	file << "  \"metrics\": {\n";
+	for (uint32_t metric = 0; metric < METRIC_COUNT; metric++)
+	{
+		const Percentiles& percentiles = summary.metrics[metric];
+		file << "    \"" << METRIC_NAMES[metric] << "\": { "
+			<< "\"p50\": " << percentiles.p50 << ", "
+			<< "\"p95\": " << percentiles.p95 << ", "
+			<< "\"p99\": " << percentiles.p99 << ", "
+			<< "\"max\": " << percentiles.max << ", "
+			<< "\"mean\": " << percentiles.mean << " }"
+			<< (metric + 1 < METRIC_COUNT ? ",\n" : "\n");
+	}
+	file << "  }\n";
+	file << "}\n";
+	return static_cast<bool>(file);
+}
+
+const char* FrameMetrics::GetMetricName(Metric metric)
+{
+	return METRIC_NAMES[metric];
+}
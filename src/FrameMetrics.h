@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// History of the last CAPACITY frames, the oldest frame is overwritten once it is full. Recording a frame
+// is a copy into the ring; percentiles, the worst frame and the 1% low frame rate are only computed by
+// Summarize. Record and Summarize belong to the render thread (or to whoever joined it), the latest
+// published summary can be read from any thread.
+class FrameMetrics
+{
+public:
+	enum Metric
+	{
+		FRAME_TIME = 0,		// Simulation frame to frame, what the player feels
+		SIMULATION,			// Simulation thread work, without waiting on the render thread
+		ACQUIRE,			// Render thread waiting for a frame slot and a swap chain image
+		RECORD,				// Render thread recording and submitting
+		GPU,				// First to last GPU timestamp, read back a frame late
+		INPUT_LATENCY,		// Input sampling to the GPU finishing the frame that used it
+		METRIC_COUNT
+	};
+
+	static constexpr uint32_t CAPACITY = 4096;
+
+	struct Sample
+	{
+		std::array<float, METRIC_COUNT> milliseconds{};
+	};
+
+	struct Percentiles
+	{
+		float p50 = 0.0f;
+		float p95 = 0.0f;
+		float p99 = 0.0f;
+		float max = 0.0f;
+		float mean = 0.0f;
+	};
+
+	struct Summary
+	{
+		uint32_t frameCount = 0;		// Frames in the window the percentiles cover
+		std::array<Percentiles, METRIC_COUNT> metrics{};
+		float onePercentLowFps = 0.0f;	// Frame rate over the slowest 1% of frames
+	};
+
+	FrameMetrics();
+
+	FrameMetrics(const FrameMetrics&) = delete;
+	FrameMetrics& operator=(const FrameMetrics&) = delete;
+
+	void Record(const Sample& sample);
+	uint64_t GetRecordedFrames() const { return m_RecordedFrames; }
+
+	Summary Summarize();
+	void Publish(const Summary& summary);
+	Summary GetPublished() const;
+
+	// Every frame still in the ring, oldest first
+	bool WriteCsv(const std::string& path) const;
+	bool WriteJson(const std::string& path, const Summary& summary) const;
+
+	static const char* GetMetricName(Metric metric);
+
+private:
+	std::vector<Sample> m_Samples;
+	uint32_t m_Head = 0;		// Next sample to write
+	uint32_t m_Count = 0;
+	uint64_t m_RecordedFrames = 0;
+
+	std::vector<float> m_Scratch;	// Sorted copy of one metric, sized once
+
+	mutable std::mutex m_PublishedMutex;
+	Summary m_Published;
+};
@@ -48,13 +48,15 @@ Buffer::Buffer(
 
 Buffer::~Buffer() {
     unmap();
-    vkDestroyBuffer(m_Device.device(), buffer, nullptr);
-    vkFreeMemory(m_Device.device(), memory, nullptr);
+    m_Device.destroyBuffer(buffer, memory);
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
  *
+ * @note Host visible memory is shared with other buffers and stays mapped by the allocator, this
+ * only points into it
+ *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
@@ -62,20 +64,21 @@ Buffer::~Buffer() {
  * @return VkResult of the buffer mapping call
  */
 VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset) {
-    assert(buffer && memory && "Called map on buffer before create");
-    return vkMapMemory(m_Device.device(), memory, offset, size, 0, &mapped);
+    assert(buffer && memory.memory && "Called map on buffer before create");
+    if (!memory.mapped) {
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    }
+    mapped = static_cast<char*>(memory.mapped) + offset;
+    return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The memory itself stays mapped until the allocator frees it
  */
 void Buffer::unmap() {
-    if (mapped) {
-        vkUnmapMemory(m_Device.device(), memory);
-        mapped = nullptr;
-    }
+    mapped = nullptr;
 }
 
 /**
@@ -112,12 +115,7 @@ void Buffer::writeToBuffer(void* data, VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the flush call
  */
 VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-    VkMappedMemoryRange mappedRange = {};
-    mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = memory;
-    mappedRange.offset = offset;
-    mappedRange.size = size;
-    return vkFlushMappedMemoryRanges(m_Device.device(), 1, &mappedRange);
+    return m_Device.getMemoryAllocator().Flush(memory, size, offset);
 }
 
 /**
@@ -132,12 +130,7 @@ VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-    VkMappedMemoryRange mappedRange = {};
-    mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = memory;
-    mappedRange.offset = offset;
-    mappedRange.size = size;
-    return vkInvalidateMappedMemoryRanges(m_Device.device(), 1, &mappedRange);
+    return m_Device.getMemoryAllocator().Invalidate(memory, size, offset);
 }
 
 /**
@@ -44,7 +44,7 @@ private:
     Device& m_Device;
     void* mapped = nullptr;
     VkBuffer buffer = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    MemoryAllocation memory{};
 
     VkDeviceSize bufferSize;
     uint32_t instanceCount;
@@ -1,8 +1,29 @@
 #include "Descriptor.h"
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+// One slot of update template data, whichever member matches the binding's descriptor type
+union DescriptorInfo {
+    VkDescriptorImageInfo image;
+    VkDescriptorBufferInfo buffer;
+    VkBufferView texelBufferView;
+};
+
+template <typename T>
+uint64_t handleKey(T handle) {
+    uint64_t key = 0;
+    std::memcpy(&key, &handle, sizeof(handle));
+    return key;
+}
+
+}  // namespace
 
 // *************** Descriptor Set Layout Builder *********************
 
@@ -10,7 +31,8 @@ DescriptorSetLayout::Builder& DescriptorSetLayout::Builder::addBinding(
     uint32_t binding,
     VkDescriptorType descriptorType,
     VkShaderStageFlags stageFlags,
-    uint32_t count) {
+    uint32_t count,
+    VkDescriptorBindingFlagsEXT flags) {
     assert(bindings.count(binding) == 0 && "Binding already in use");
     VkDescriptorSetLayoutBinding layoutBinding{};
     layoutBinding.binding = binding;
@@ -18,25 +40,41 @@ DescriptorSetLayout::Builder& DescriptorSetLayout::Builder::addBinding(
     layoutBinding.descriptorCount = count;
     layoutBinding.stageFlags = stageFlags;
     bindings[binding] = layoutBinding;
+    bindingFlags[binding] = flags;
     return *this;
 }
 
 std::unique_ptr<DescriptorSetLayout> DescriptorSetLayout::Builder::build() const {
-    return std::make_unique<DescriptorSetLayout>(m_Device, bindings);
+    return std::make_unique<DescriptorSetLayout>(m_Device, bindings, bindingFlags);
 }
 
 // *************** Descriptor Set Layout *********************
 
 DescriptorSetLayout::DescriptorSetLayout(
-    Device& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+    Device& device,
+    std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+    std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> bindingFlags)
     : m_Device{ device }, bindings{ bindings } {
     std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+    std::vector<VkDescriptorBindingFlagsEXT> setLayoutBindingFlags{};
+    bool hasBindingFlags = false;
     for (auto kv : bindings) {
         setLayoutBindings.push_back(kv.second);
+
+        VkDescriptorBindingFlagsEXT flags = bindingFlags.count(kv.first) ? bindingFlags[kv.first] : 0;
+        setLayoutBindingFlags.push_back(flags);
+        hasBindingFlags |= flags != 0;
     }
 
+    // Same order as setLayoutBindings
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
     descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptorSetLayoutInfo.pNext = hasBindingFlags ? &bindingFlagsInfo : nullptr;
     descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
     descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
@@ -50,9 +88,56 @@ DescriptorSetLayout::DescriptorSetLayout(
 }
 
 DescriptorSetLayout::~DescriptorSetLayout() {
+    if (updateTemplate != VK_NULL_HANDLE) {
+        vkDestroyDescriptorUpdateTemplate(m_Device.device(), updateTemplate, nullptr);
+    }
     vkDestroyDescriptorSetLayout(m_Device.device(), descriptorSetLayout, nullptr);
 }
 
+VkDescriptorUpdateTemplate DescriptorSetLayout::getUpdateTemplate() {
+    if (updateTemplate != VK_NULL_HANDLE) {
+        return updateTemplate;
+    }
+
+    std::vector<uint32_t> sortedBindings{};
+    for (auto& kv : bindings) {
+        sortedBindings.push_back(kv.first);
+    }
+    std::sort(sortedBindings.begin(), sortedBindings.end());
+
+    std::vector<VkDescriptorUpdateTemplateEntry> entries{};
+    uint32_t descriptorIndex = 0;
+    for (uint32_t binding : sortedBindings) {
+        auto& layoutBinding = bindings[binding];
+
+        VkDescriptorUpdateTemplateEntry entry{};
+        entry.dstBinding = binding;
+        entry.dstArrayElement = 0;
+        entry.descriptorCount = layoutBinding.descriptorCount;
+        entry.descriptorType = layoutBinding.descriptorType;
+        entry.offset = descriptorIndex * sizeof(DescriptorInfo);
+        entry.stride = sizeof(DescriptorInfo);
+        entries.push_back(entry);
+
+        templateOffsets[binding] = descriptorIndex;
+        descriptorIndex += layoutBinding.descriptorCount;
+    }
+    templateDescriptorCount = descriptorIndex;
+
+    VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+    templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+    templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+    templateInfo.pDescriptorUpdateEntries = entries.data();
+    templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    templateInfo.descriptorSetLayout = descriptorSetLayout;
+
+    if (vkCreateDescriptorUpdateTemplate(m_Device.device(), &templateInfo, nullptr, &updateTemplate) !=
+        VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor update template!");
+    }
+    return updateTemplate;
+}
+
 // *************** Descriptor Pool Builder *********************
 
 DescriptorPool::Builder& DescriptorPool::Builder::addPoolSize(
@@ -108,8 +193,7 @@ bool DescriptorPool::allocateDescriptor(
     allocInfo.pSetLayouts = &descriptorSetLayout;
     allocInfo.descriptorSetCount = 1;
 
-    // Might want to create a "DescriptorPoolManager" class that handles this case, and builds
-    // a new pool whenever an old pool fills up. But this is beyond our current scope
+    // Fixed size, DescriptorAllocator chains new pools when this one fills up
     if (vkAllocateDescriptorSets(m_Device.device(), &allocInfo, &descriptor) != VK_SUCCESS) {
         return false;
     }
@@ -128,10 +212,140 @@ void DescriptorPool::resetPool() {
     vkResetDescriptorPool(m_Device.device(), descriptorPool, 0);
 }
 
+// *************** Descriptor Allocator *********************
+
+DescriptorAllocator::DescriptorAllocator(
+    Device& device,
+    uint32_t initialSetsPerPool,
+    std::vector<PoolSizeRatio> poolSizeRatios,
+    VkDescriptorPoolCreateFlags poolFlags)
+    : m_Device{ device },
+      poolSizeRatios{ poolSizeRatios },
+      poolFlags{ poolFlags },
+      setsPerPool{ initialSetsPerPool } {}
+
+DescriptorAllocator::~DescriptorAllocator() {
+    for (auto pool : fullPools) {
+        vkDestroyDescriptorPool(m_Device.device(), pool, nullptr);
+    }
+    for (auto pool : readyPools) {
+        vkDestroyDescriptorPool(m_Device.device(), pool, nullptr);
+    }
+}
+
+std::vector<DescriptorAllocator::PoolSizeRatio> DescriptorAllocator::defaultPoolSizeRatios() {
+    // Every type a layout may use needs an entry, a type missing here fails in every pool however many are chained
+    return {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+        { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+        { VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0.5f },
+        { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f },
+    };
+}
+
+bool DescriptorAllocator::allocateDescriptor(
+    const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor) {
+    VkDescriptorPool pool = getPool();
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pool;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    allocInfo.descriptorSetCount = 1;
+
+    VkResult result = vkAllocateDescriptorSets(m_Device.device(), &allocInfo, &descriptor);
+
+    // Retire the pool and try once more in a fresh one
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        fullPools.push_back(pool);
+
+        pool = getPool();
+        allocInfo.descriptorPool = pool;
+        result = vkAllocateDescriptorSets(m_Device.device(), &allocInfo, &descriptor);
+    }
+
+    // A pool that failed is not tried again before resetPools
+    if (result == VK_SUCCESS) {
+        readyPools.push_back(pool);
+    } else {
+        fullPools.push_back(pool);
+    }
+    return result == VK_SUCCESS;
+}
+
+void DescriptorAllocator::resetPools() {
+    for (auto pool : readyPools) {
+        vkResetDescriptorPool(m_Device.device(), pool, 0);
+    }
+    for (auto pool : fullPools) {
+        vkResetDescriptorPool(m_Device.device(), pool, 0);
+        readyPools.push_back(pool);
+    }
+    fullPools.clear();
+}
+
+VkDescriptorPool DescriptorAllocator::getPool() {
+    if (!readyPools.empty()) {
+        VkDescriptorPool pool = readyPools.back();
+        readyPools.pop_back();
+        return pool;
+    }
+
+    VkDescriptorPool pool = createPool(setsPerPool);
+    setsPerPool = std::min(setsPerPool + setsPerPool / 2, MAX_SETS_PER_POOL);
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount) {
+    std::vector<VkDescriptorPoolSize> poolSizes{};
+    for (auto& ratio : poolSizeRatios) {
+        poolSizes.push_back({ ratio.type, std::max(1u, static_cast<uint32_t>(ratio.ratio * setCount)) });
+    }
+
+    VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    descriptorPoolInfo.pPoolSizes = poolSizes.data();
+    descriptorPoolInfo.maxSets = setCount;
+    descriptorPoolInfo.flags = poolFlags;
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(m_Device.device(), &descriptorPoolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+    return pool;
+}
+
+// *************** Descriptor Set Cache *********************
+
+size_t DescriptorSetCache::KeyHash::operator()(const std::vector<uint64_t>& key) const {
+    size_t hash = key.size();
+    for (uint64_t word : key) {
+        hash ^= std::hash<uint64_t>{}(word) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+void DescriptorSetCache::clear() {
+    allocator.resetPools();
+    sets.clear();
+}
+
 // *************** Descriptor Writer *********************
 
 DescriptorWriter::DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorPool& pool)
-    : setLayout{ setLayout }, pool{ pool } {}
+    : setLayout{ setLayout }, pool{ &pool } {}
+
+DescriptorWriter::DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorAllocator& allocator)
+    : setLayout{ setLayout }, allocator{ &allocator } {}
+
+DescriptorWriter::DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorSetCache& cache)
+    : setLayout{ setLayout }, cache{ &cache } {}
 
 DescriptorWriter& DescriptorWriter::writeBuffer(
     uint32_t binding, VkDescriptorBufferInfo* bufferInfo) {
@@ -175,8 +389,35 @@ DescriptorWriter& DescriptorWriter::writeImage(
     return *this;
 }
 
+DescriptorWriter& DescriptorWriter::writeImageArrayElement(
+    uint32_t binding, uint32_t arrayElement, VkDescriptorImageInfo* imageInfo) {
+    assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
+
+    auto& bindingDescription = setLayout.bindings[binding];
+
+    assert(
+        arrayElement < bindingDescription.descriptorCount &&
+        "Array element out of range for binding");
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.descriptorType = bindingDescription.descriptorType;
+    write.dstBinding = binding;
+    write.dstArrayElement = arrayElement;
+    write.pImageInfo = imageInfo;
+    write.descriptorCount = 1;
+
+    writes.push_back(write);
+    return *this;
+}
+
 bool DescriptorWriter::build(VkDescriptorSet& set) {
-    bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
+    if (cache) {
+        return buildCached(set);
+    }
+
+    bool success = pool ? pool->allocateDescriptor(setLayout.getDescriptorSetLayout(), set)
+                        : allocator->allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
     if (!success) {
         return false;
     }
@@ -184,9 +425,82 @@ bool DescriptorWriter::build(VkDescriptorSet& set) {
     return true;
 }
 
+bool DescriptorWriter::buildCached(VkDescriptorSet& set) {
+    std::vector<uint64_t> key{ handleKey(setLayout.getDescriptorSetLayout()) };
+    for (auto& write : writes) {
+        key.push_back((static_cast<uint64_t>(write.dstBinding) << 32) | write.dstArrayElement);
+        key.push_back(write.descriptorType);
+        if (write.pImageInfo) {
+            key.push_back(handleKey(write.pImageInfo->sampler));
+            key.push_back(handleKey(write.pImageInfo->imageView));
+            key.push_back(write.pImageInfo->imageLayout);
+        } else if (write.pBufferInfo) {
+            key.push_back(handleKey(write.pBufferInfo->buffer));
+            key.push_back(write.pBufferInfo->offset);
+            key.push_back(write.pBufferInfo->range);
+        } else if (write.pTexelBufferView) {
+            key.push_back(handleKey(*write.pTexelBufferView));
+        }
+    }
+
+    auto it = cache->sets.find(key);
+    if (it != cache->sets.end()) {
+        set = it->second;
+        return true;
+    }
+
+    if (!cache->allocator.allocateDescriptor(setLayout.getDescriptorSetLayout(), set)) {
+        return false;
+    }
+    overwrite(set);
+    cache->sets.emplace(std::move(key), set);
+    return true;
+}
+
 void DescriptorWriter::overwrite(VkDescriptorSet& set) {
     for (auto& write : writes) {
         write.dstSet = set;
     }
-    vkUpdateDescriptorSets(pool.m_Device.device(), writes.size(), writes.data(), 0, nullptr);
+
+    if (coversLayout()) {
+        VkDescriptorUpdateTemplate updateTemplate = setLayout.getUpdateTemplate();
+
+        std::vector<DescriptorInfo> data(setLayout.templateDescriptorCount);
+        for (auto& write : writes) {
+            auto& info = data[setLayout.templateOffsets[write.dstBinding] + write.dstArrayElement];
+            if (write.pImageInfo) {
+                info.image = *write.pImageInfo;
+            } else if (write.pBufferInfo) {
+                info.buffer = *write.pBufferInfo;
+            } else {
+                info.texelBufferView = *write.pTexelBufferView;
+            }
+        }
+
+        vkUpdateDescriptorSetWithTemplate(setLayout.m_Device.device(), set, updateTemplate, data.data());
+        return;
+    }
+
+    // Partial updates, e.g. one element of a bindless array
+    vkUpdateDescriptorSets(setLayout.m_Device.device(), writes.size(), writes.data(), 0, nullptr);
+}
+
+bool DescriptorWriter::coversLayout() const {
+    size_t descriptorCount = 0;
+    for (auto& kv : setLayout.bindings) {
+        descriptorCount += kv.second.descriptorCount;
+    }
+    if (writes.size() != descriptorCount) {
+        return false;
+    }
+
+    // Every write targets a single in range element, so no duplicates means full coverage
+    std::unordered_set<uint64_t> written{};
+    for (auto& write : writes) {
+        if (write.descriptorCount != 1 ||
+            !written.insert((static_cast<uint64_t>(write.dstBinding) << 32) | write.dstArrayElement).second) {
+            return false;
+        }
+    }
+    return true;
 }
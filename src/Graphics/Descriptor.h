@@ -17,16 +17,20 @@ public:
             uint32_t binding,
             VkDescriptorType descriptorType,
             VkShaderStageFlags stageFlags,
-            uint32_t count = 1);
+            uint32_t count = 1,
+            VkDescriptorBindingFlagsEXT bindingFlags = 0);
         std::unique_ptr<DescriptorSetLayout> build() const;
 
     private:
         Device& m_Device;
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+        std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> bindingFlags{};
     };
 
     DescriptorSetLayout(
-        Device& Device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+        Device& Device,
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+        std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> bindingFlags = {});
     ~DescriptorSetLayout();
     DescriptorSetLayout(const DescriptorSetLayout&) = delete;
     DescriptorSetLayout& operator=(const DescriptorSetLayout&) = delete;
@@ -34,10 +38,17 @@ public:
     VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
 
 private:
+    // One entry per descriptor of every binding, in binding order, created on first use
+    VkDescriptorUpdateTemplate getUpdateTemplate();
+
     Device& m_Device;
     VkDescriptorSetLayout descriptorSetLayout;
     std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
 
+    VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+    std::unordered_map<uint32_t, uint32_t> templateOffsets;  // binding -> first entry in the template data
+    uint32_t templateDescriptorCount = 0;
+
     friend class DescriptorWriter;
 };
 
@@ -82,18 +93,97 @@ private:
     friend class DescriptorWriter;
 };
 
+// Chains descriptor pools as they fill up instead of failing, new pools grow geometrically.
+// resetPools() frees every set at once, which is how the per frame transient allocators are recycled.
+class DescriptorAllocator {
+public:
+    struct PoolSizeRatio {
+        VkDescriptorType type;
+        float ratio;  // Descriptors of this type per set
+    };
+
+    DescriptorAllocator(
+        Device& device,
+        uint32_t initialSetsPerPool = 64,
+        std::vector<PoolSizeRatio> poolSizeRatios = defaultPoolSizeRatios(),
+        VkDescriptorPoolCreateFlags poolFlags = 0);
+    ~DescriptorAllocator();
+    DescriptorAllocator(const DescriptorAllocator&) = delete;
+    DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+    bool allocateDescriptor(const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor);
+
+    // Every set allocated so far becomes invalid, the pools are kept for reuse
+    void resetPools();
+
+    uint32_t getPoolCount() const { return static_cast<uint32_t>(fullPools.size() + readyPools.size()); }
+
+    static std::vector<PoolSizeRatio> defaultPoolSizeRatios();
+
+private:
+    VkDescriptorPool getPool();
+    VkDescriptorPool createPool(uint32_t setCount);
+
+    static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+    Device& m_Device;
+    std::vector<PoolSizeRatio> poolSizeRatios;
+    VkDescriptorPoolCreateFlags poolFlags;
+    uint32_t setsPerPool;
+
+    std::vector<VkDescriptorPool> fullPools;
+    std::vector<VkDescriptorPool> readyPools;
+};
+
+// Hands back the same set for the same layout and resources, so rebuilding descriptors for
+// resources that didn't change costs a hash lookup instead of an allocation and an update
+class DescriptorSetCache {
+public:
+    DescriptorSetCache(Device& device) : allocator{ device } {}
+
+    DescriptorSetCache(const DescriptorSetCache&) = delete;
+    DescriptorSetCache& operator=(const DescriptorSetCache&) = delete;
+
+    // Call when cached resources are destroyed, frees every cached set
+    void clear();
+
+    uint32_t getSetCount() const { return static_cast<uint32_t>(sets.size()); }
+
+private:
+    struct KeyHash {
+        size_t operator()(const std::vector<uint64_t>& key) const;
+    };
+
+    DescriptorAllocator allocator;  // Owned, clear() resets it wholesale
+    std::unordered_map<std::vector<uint64_t>, VkDescriptorSet, KeyHash> sets;
+
+    friend class DescriptorWriter;
+};
+
 class DescriptorWriter {
 public:
     DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorPool& pool);
+    DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorAllocator& allocator);
+    // build reuses the set built earlier with the same layout and resources
+    DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorSetCache& cache);
 
     DescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
     DescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
+    // One element of an arrayed binding, e.g. a bindless texture table
+    DescriptorWriter& writeImageArrayElement(
+        uint32_t binding, uint32_t arrayElement, VkDescriptorImageInfo* imageInfo);
 
     bool build(VkDescriptorSet& set);
+    // Goes through the layout's update template when every descriptor of the layout is written
     void overwrite(VkDescriptorSet& set);
 
 private:
+    bool coversLayout() const;
+    bool buildCached(VkDescriptorSet& set);
+
     DescriptorSetLayout& setLayout;
-    DescriptorPool& pool;
+    DescriptorPool* pool = nullptr;
+    DescriptorAllocator* allocator = nullptr;
+    DescriptorSetCache* cache = nullptr;
     std::vector<VkWriteDescriptorSet> writes;
 };
\ No newline at end of file
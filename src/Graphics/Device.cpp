@@ -1,4 +1,7 @@
 #include "Device.h"
+#include "PipelineCache.h"
+#include "PipelineManager.h"
+#include "UploadManager.h"
 
 // std headers
 #include <cstring>
@@ -53,9 +56,30 @@ Device::Device(Window &window) : window{window} {
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+
+  memoryAllocator = std::make_unique<MemoryAllocator>(physicalDevice, device_);
+  graphicsTimeline = std::make_unique<Timeline>(device_);
+  if (transferQueue_ != graphicsQueue_) {
+    transferTimeline = std::make_unique<Timeline>(device_);
+  }
+  uploadManager = std::make_unique<UploadManager>(*this);
+  pipelineCache = std::make_unique<PipelineCache>(*this);
+  pipelineManager = std::make_unique<PipelineManager>(*this);
 }
 
 Device::~Device() {
+  // Workers build through the cache, stop them first
+  pipelineManager.reset();
+  // Writes the cache back to disk, needs the device
+  pipelineCache.reset();
+  // Waits for the batches in flight, its staging memory comes from the allocator
+  uploadManager.reset();
+  // Waits for the GPU, then runs the destroys still deferred
+  transferTimeline.reset();
+  graphicsTimeline.reset();
+  // Everything allocated from it is destroyed by now
+  memoryAllocator.reset();
+
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -78,7 +102,7 @@ void Device::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "Vulkan Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  appInfo.apiVersion = VK_API_VERSION_1_1;
 
   VkInstanceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -139,6 +163,9 @@ void Device::createLogicalDevice() {
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  if (indices.transferFamilyHasValue) {
+    uniqueQueueFamilies.insert(indices.transferFamily);
+  }
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -155,15 +182,47 @@ void Device::createLogicalDevice() {
   deviceFeatures.samplerAnisotropy = VK_TRUE;
   deviceFeatures.depthClamp = VK_TRUE;
 
+  // Precise occlusion queries give real sample counts (used to measure overdraw)
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise == VK_TRUE;
+  deviceFeatures.occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise;
+
+  // Bindless materials : one partially bound, runtime sized texture array indexed per draw
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures = {};
+  descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+  descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+  descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+
+  // Frame pacing, uploads and deferred destruction all count submissions on timelines
+  VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures = {};
+  timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+  timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+  descriptorIndexingFeatures.pNext = &timelineSemaphoreFeatures;
+
+  VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+  deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  deviceFeatures2.pNext = &descriptorIndexingFeatures;
+  deviceFeatures2.features = deviceFeatures;
+
+  // Optional : lines the GPU profiler's timestamps up with the CPU clock
+  std::vector<const char *> enabledExtensions = deviceExtensions;
+  calibratedTimestamps = checkCalibratedTimestampSupport();
+  if (calibratedTimestamps) {
+    enabledExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+  }
+
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = &deviceFeatures2;
 
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-  createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.pEnabledFeatures = nullptr;
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -180,6 +239,11 @@ void Device::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  if (indices.transferFamilyHasValue) {
+    vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
+  } else {
+    transferQueue_ = graphicsQueue_;
+  }
 }
 
 void Device::createCommandPool() {
@@ -212,8 +276,29 @@ bool Device::isDeviceSuitable(VkPhysicalDevice device) {
   VkPhysicalDeviceFeatures supportedFeatures;
   vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+  bool descriptorIndexingAdequate = false;
+  bool timelineSemaphoreAdequate = false;
+  if (extensionsSupported) {
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures = {};
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures = {};
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    descriptorIndexingFeatures.pNext = &timelineSemaphoreFeatures;
+
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &descriptorIndexingFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &supportedFeatures2);
+
+    descriptorIndexingAdequate = descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+                                 descriptorIndexingFeatures.descriptorBindingPartiallyBound &&
+                                 descriptorIndexingFeatures.runtimeDescriptorArray;
+    timelineSemaphoreAdequate = timelineSemaphoreFeatures.timelineSemaphore;
+  }
+
   return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-         supportedFeatures.samplerAnisotropy;
+         supportedFeatures.samplerAnisotropy && descriptorIndexingAdequate && timelineSemaphoreAdequate;
 }
 
 void Device::populateDebugMessengerCreateInfo(
@@ -320,6 +405,49 @@ bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool Device::checkCalibratedTimestampSupport() {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      physicalDevice,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  bool extensionFound = false;
+  for (const auto &extension : availableExtensions) {
+    if (strcmp(extension.extensionName, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) == 0) {
+      extensionFound = true;
+      break;
+    }
+  }
+  if (!extensionFound) {
+    return false;
+  }
+
+  // The extension alone is not enough, the device clock has to be one of the calibrateable domains
+  auto getTimeDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(
+      instance,
+      "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+  if (getTimeDomains == nullptr) {
+    return false;
+  }
+
+  uint32_t domainCount = 0;
+  getTimeDomains(physicalDevice, &domainCount, nullptr);
+  std::vector<VkTimeDomainEXT> timeDomains(domainCount);
+  getTimeDomains(physicalDevice, &domainCount, timeDomains.data());
+
+  for (VkTimeDomainEXT timeDomain : timeDomains) {
+    if (timeDomain == VK_TIME_DOMAIN_DEVICE_EXT) {
+      return true;
+    }
+  }
+  return false;
+}
+
 QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -348,6 +476,17 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
     i++;
   }
 
+  // Copies run on the DMA engine when there is one : transfer capable, no graphics or compute
+  for (uint32_t family = 0; family < queueFamilyCount; family++) {
+    VkQueueFlags flags = queueFamilies[family].queueFlags;
+    if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      indices.transferFamily = family;
+      indices.transferFamilyHasValue = true;
+      break;
+    }
+  }
+
   return indices;
 }
 
@@ -434,7 +573,7 @@ void Device::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory) {
+    MemoryAllocation &bufferMemory) {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
@@ -445,19 +584,13 @@ void Device::createBuffer(
     throw std::runtime_error("failed to create vertex buffer!");
   }
 
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
-  }
+  bufferMemory = memoryAllocator->AllocateForBuffer(buffer, properties);
+}
 
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+void Device::destroyBuffer(VkBuffer &buffer, MemoryAllocation &bufferMemory) {
+  vkDestroyBuffer(device_, buffer, nullptr);
+  buffer = VK_NULL_HANDLE;
+  memoryAllocator->Free(bufferMemory);
 }
 
 VkCommandBuffer Device::beginSingleTimeCommands() {
@@ -481,23 +614,36 @@ VkCommandBuffer Device::beginSingleTimeCommands() {
 void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   vkEndCommandBuffer(commandBuffer);
 
+  // Waits for this submission only, not for frames in flight
+  uint64_t signalValue = graphicsTimeline->Advance();
+  VkSemaphore timeline = graphicsTimeline->GetSemaphore();
+
+  VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues = &signalValue;
+
   VkSubmitInfo submitInfo{};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &timeline;
 
   vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue_);
+  graphicsTimeline->Wait(signalValue);
 
   vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
-void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+void Device::copyBuffer(
+    VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
   VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
   VkBufferCopy copyRegion{};
-  copyRegion.srcOffset = 0;  // Optional
-  copyRegion.dstOffset = 0;  // Optional
+  copyRegion.srcOffset = srcOffset;
+  copyRegion.dstOffset = dstOffset;
   copyRegion.size = size;
   vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -535,26 +681,18 @@ void Device::createImageWithInfo(
     const VkImageCreateInfo &imageInfo,
     VkMemoryPropertyFlags properties,
     VkImage &image,
-    VkDeviceMemory &imageMemory) {
+    MemoryAllocation &imageMemory) {
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
 
-  VkMemoryRequirements memRequirements;
-  vkGetImageMemoryRequirements(device_, image, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
-  }
+  imageMemory = memoryAllocator->AllocateForImage(image, imageInfo, properties);
+}
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-    throw std::runtime_error("failed to bind image memory!");
-  }
+void Device::destroyImage(VkImage &image, MemoryAllocation &imageMemory) {
+  vkDestroyImage(device_, image, nullptr);
+  image = VK_NULL_HANDLE;
+  memoryAllocator->Free(imageMemory);
 }
 
 void Device::TransitionImageLayout(VkCommandBuffer cmdbuffer, VkImage image, VkImageAspectFlags aspectMask, VkImageLayout oldImageLayout, VkImageLayout newImageLayout, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
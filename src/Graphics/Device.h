@@ -1,11 +1,18 @@
 #pragma once
 
 #include "../Window.h"
+#include "MemoryAllocator.h"
+#include "Timeline.h"
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
+class PipelineCache;
+class PipelineManager;
+class UploadManager;
+
 
 
 struct SwapChainSupportDetails {
@@ -17,8 +24,10 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  uint32_t transferFamily;  // Transfer only family (DMA engine), absent on some devices
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -46,8 +55,25 @@ class Device {
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  // The graphics queue when the device has no transfer only family
+  VkQueue transferQueue() { return transferQueue_; }
   VkSampleCountFlagBits msaaSampleCountFlagBits() { return msaaSamples; }
   VkFormat DepthFormat() { return depthFormat; }
+  bool OcclusionQueryPreciseSupported() { return occlusionQueryPrecise; }
+  // VK_EXT_calibrated_timestamps enabled, the device clock can be sampled from the CPU
+  bool CalibratedTimestampsSupported() { return calibratedTimestamps; }
+  // Persistent across runs, pass it to every pipeline creation
+  PipelineCache &getPipelineCache() { return *pipelineCache; }
+  // Background pipeline builds and shader hot reload
+  PipelineManager &getPipelineManager() { return *pipelineManager; }
+  // Every buffer and image memory comes from here
+  MemoryAllocator &getMemoryAllocator() { return *memoryAllocator; }
+  // Batched staging uploads, prefer it to copyBuffer / copyBufferToImage which wait for the queue
+  UploadManager &getUploadManager() { return *uploadManager; }
+  // Every graphics queue submission signals it, also drives deferred destruction
+  Timeline &getGraphicsTimeline() { return *graphicsTimeline; }
+  // Same timeline as the graphics one when there is no dedicated transfer queue
+  Timeline &getTransferTimeline() { return transferTimeline ? *transferTimeline : *graphicsTimeline; }
   VkPhysicalDeviceProperties GetPhysicalDeviceProperties();
  
 
@@ -63,10 +89,12 @@ class Device {
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      MemoryAllocation &bufferMemory);
+  void destroyBuffer(VkBuffer &buffer, MemoryAllocation &bufferMemory);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+  void copyBuffer(
+      VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
   void copyBufferToImage(
       VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
@@ -74,7 +102,8 @@ class Device {
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      MemoryAllocation &imageMemory);
+  void destroyImage(VkImage &image, MemoryAllocation &imageMemory);
   void TransitionImageLayout(VkCommandBuffer cmdbuffer,
       VkImage image,
       VkImageAspectFlags aspectMask,
@@ -108,6 +137,7 @@ class Device {
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool checkCalibratedTimestampSupport();
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
   VkSampleCountFlagBits getMaxUsableSampleCount();
   VkFormat getDepthFormat();
@@ -122,10 +152,23 @@ class Device {
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
 
   VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
   VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+  bool occlusionQueryPrecise = false;
+  bool calibratedTimestamps = false;
+
+  std::unique_ptr<MemoryAllocator> memoryAllocator;
+  std::unique_ptr<Timeline> graphicsTimeline;
+  std::unique_ptr<Timeline> transferTimeline;
+  std::unique_ptr<UploadManager> uploadManager;
+  std::unique_ptr<PipelineCache> pipelineCache;
+  std::unique_ptr<PipelineManager> pipelineManager;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-  const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  const std::vector<const char *> deviceExtensions = {
+      VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+      VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+      VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME};
 };
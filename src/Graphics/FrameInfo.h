@@ -2,12 +2,24 @@
 
 #include "CameraSystem.h"
 #include "Descriptor.h"
+#include "FrameUniformAllocator.h"
+#include "GpuProfiler.h"
 
 #include "vulkan/vulkan.h"
 
+#include <chrono>
+#include <vector>
+
 #define MAX_POINT_LIGHTS 10
 #define MAX_SPOT_LIGHTS 10
 
+// Chosen once at startup
+enum class RenderPath
+{
+	FORWARD = 0,	// Basic.frag shades every rasterized fragment
+	DEFERRED = 1	// G-buffer pass, then one full screen lighting pass
+};
+
 struct PointLight
 {
 	glm::vec4 position{}; // position x,y,z
@@ -49,6 +61,38 @@ struct GlobalUBO
 	alignas(4)int numOfActiveSpotLights;
 };
 
+// Entity drawn by SimpleRenderSystem, copied out of the ECS by the simulation thread
+struct RenderObject
+{
+	Entity entity;
+	ECSTransformComponent transform;
+	Model* model;		// Owned by the Application, outlives every snapshot
+	bool occluder;
+};
+
+// Light gizmo drawn by PointLightRenderSystem
+struct LightBillboard
+{
+	glm::vec4 position{};	// w=spot cutoff, -1 for point lights
+	glm::vec4 color{};		// color r=x, g=y, b=z, a=intensity
+	float radius;
+};
+
+// Everything a frame needs from the simulation. The simulation thread fills it, hands it to the
+// render thread whole and only gets it back once that frame is recorded, so it never changes under the renderer
+struct RenderSnapshot
+{
+	float frameTime = 0.0f;
+	std::chrono::high_resolution_clock::time_point inputSampleTime{};
+	float simulationTime = 0.0f;	// Milliseconds the simulation spent on this snapshot, waits excluded
+	bool dumpRenderStats = false;	// Printed by the render thread once the frame is recorded
+	bool metricsOverlay = false;	// Render thread publishes frame metric summaries for the title overlay
+	CameraSystem camera{};
+	GlobalUBO ubo{};		// Camera and lights, the render thread adds the rest
+	std::vector<RenderObject> objects;
+	std::vector<LightBillboard> lightBillboards;
+};
+
 struct FrameInfo
 {
 	int FrameIndex;
@@ -56,4 +100,9 @@ struct FrameInfo
 	VkCommandBuffer commandBuffer;
 	CameraSystem& cameraSystem;
 	VkDescriptorSet globalDescriptorSet;
+	VkDescriptorSet materialDescriptorSet;	// MaterialLibrary, bound by passes that shade materials
+	FrameUniformAllocator& frameUniforms;			// Per-frame uniform data, bound with dynamic offsets
+	GpuProfiler& gpuProfiler;						// PROFILE_GPU_SCOPE around each pass
+	uint32_t globalUBOOffset;						// Dynamic offset of the GlobalUBO for globalDescriptorSet
+	const RenderSnapshot& snapshot;					// Scene state of this frame, read instead of the ECS
 };
\ No newline at end of file
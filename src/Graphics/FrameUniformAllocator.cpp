@@ -0,0 +1,67 @@
+#include "FrameUniformAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace
+{
+	VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+FrameUniformAllocator::FrameUniformAllocator(Device& device, uint32_t frameCount, VkDeviceSize frameCapacity)
+{
+	const VkPhysicalDeviceLimits& limits = device.properties.limits;
+	m_Alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+	m_FrameCapacity = AlignUp(frameCapacity, m_Alignment);
+
+	// Not coherent on purpose, the written range is flushed once per frame
+	m_Buffer = std::make_unique<Buffer>(
+		device,
+		m_FrameCapacity,
+		frameCount,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	if (m_Buffer->map() != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to map frame uniform buffer!");
+	}
+}
+
+void FrameUniformAllocator::BeginFrame(uint32_t frameIndex)
+{
+	assert(frameIndex < m_Buffer->getInstanceCount() && "FrameUniformAllocator : frame index out of range");
+	m_FrameBase = frameIndex * m_FrameCapacity;
+	m_Head = 0;
+}
+
+void FrameUniformAllocator::Flush()
+{
+	if (m_Head > 0)
+	{
+		m_Buffer->flush(m_Head, m_FrameBase);
+	}
+}
+
+FrameUniformAllocator::Allocation FrameUniformAllocator::Allocate(VkDeviceSize size)
+{
+	VkDeviceSize offset = m_Head;
+	if (offset + size > m_FrameCapacity)
+	{
+		throw std::runtime_error("frame uniform allocator out of space!");
+	}
+	m_Head = AlignUp(offset + size, m_Alignment);
+
+	Allocation allocation{};
+	allocation.mapped = static_cast<char*>(m_Buffer->getMappedMemory()) + m_FrameBase + offset;
+	allocation.dynamicOffset = static_cast<uint32_t>(m_FrameBase + offset);
+	return allocation;
+}
+
+VkDescriptorBufferInfo FrameUniformAllocator::DescriptorInfo(VkDeviceSize range) const
+{
+	return VkDescriptorBufferInfo{ m_Buffer->getBuffer(), 0, range };
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Device.h"
+#include "Buffer.h"
+
+#include <cstring>
+#include <memory>
+
+// Per-frame bump allocator over one persistently mapped buffer. Every frame in flight owns its own
+// region, slices are handed out as dynamic offsets so a single descriptor set (written once at
+// offset 0) serves every frame. The region is reset by BeginFrame and flushed once by Flush.
+// Render thread only.
+class FrameUniformAllocator
+{
+public:
+	struct Allocation
+	{
+		void* mapped;
+		uint32_t dynamicOffset;		// Pass to vkCmdBindDescriptorSets
+	};
+
+	FrameUniformAllocator(Device& device, uint32_t frameCount, VkDeviceSize frameCapacity = 1024 * 1024);
+
+	FrameUniformAllocator(const FrameUniformAllocator&) = delete;
+	FrameUniformAllocator& operator=(const FrameUniformAllocator&) = delete;
+
+	// The frame's previous submission must have finished
+	void BeginFrame(uint32_t frameIndex);
+	// Flushes everything written since BeginFrame, call before the frame is submitted
+	void Flush();
+
+	Allocation Allocate(VkDeviceSize size);
+	template<typename T>
+	uint32_t Push(const T& data)
+	{
+		Allocation allocation = Allocate(sizeof(T));
+		memcpy(allocation.mapped, &data, sizeof(T));
+		return allocation.dynamicOffset;
+	}
+
+	// For UNIFORM_BUFFER_DYNAMIC / STORAGE_BUFFER_DYNAMIC bindings, range is the size the shader reads
+	VkDescriptorBufferInfo DescriptorInfo(VkDeviceSize range) const;
+
+	VkDeviceSize GetFrameUsage() const { return m_Head; }
+	VkDeviceSize GetFrameCapacity() const { return m_FrameCapacity; }
+
+private:
+	std::unique_ptr<Buffer> m_Buffer;
+	VkDeviceSize m_FrameCapacity;
+	VkDeviceSize m_Alignment;
+
+	VkDeviceSize m_FrameBase = 0;
+	VkDeviceSize m_Head = 0;		// Relative to m_FrameBase
+};
@@ -0,0 +1,302 @@
+#include "GeometryArena.h"
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+void GeometryArena::RangeAllocator::Reset(uint32_t capacity, uint32_t usedEnd)
+{
+	m_FreeRanges.clear();
+	if (usedEnd < capacity)
+	{
+		m_FreeRanges.insert({ usedEnd, capacity - usedEnd });
+	}
+}
+
+bool GeometryArena::RangeAllocator::Allocate(uint32_t count, uint32_t& offset)
+{
+	for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it)
+	{
+		if (it->second < count)
+		{
+			continue;
+		}
+
+		offset = it->first;
+		uint32_t remaining = it->second - count;
+		m_FreeRanges.erase(it);
+
+		if (remaining > 0)
+		{
+			m_FreeRanges.insert({ offset + count, remaining });
+		}
+		return true;
+	}
+
+	return false;
+}
+
+void GeometryArena::RangeAllocator::Free(uint32_t offset, uint32_t count)
+{
+	auto next = m_FreeRanges.lower_bound(offset);
+
+	// Merge with the following range
+	if (next != m_FreeRanges.end() && offset + count == next->first)
+	{
+		count += next->second;
+		next = m_FreeRanges.erase(next);
+	}
+
+	// Merge with the preceding range
+	if (next != m_FreeRanges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += count;
+			return;
+		}
+	}
+
+	m_FreeRanges.insert({ offset, count });
+}
+
+GeometryArena::GeometryArena(Device& device, VkDeviceSize attributeStride, uint32_t vertexCapacity, uint32_t indexCapacity)
+	: m_Device(device)
+{
+	m_Vertices.strides = { sizeof(glm::vec3), attributeStride };
+	m_Vertices.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+	m_Indices16.strides = { sizeof(uint16_t) };
+	m_Indices16.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+	m_Indices32.strides = { sizeof(uint32_t) };
+	m_Indices32.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+	CreatePool(m_Vertices, vertexCapacity);
+	CreatePool(m_Indices16, indexCapacity);
+	// Only primitives over 65536 vertices land here
+	CreatePool(m_Indices32, std::max(indexCapacity / 16, 1u));
+}
+
+GeometryArena::~GeometryArena()
+{
+}
+
+GeometryArena::Handle GeometryArena::UploadVertices(const glm::vec3* positions, const void* attributes, uint32_t vertexCount)
+{
+	Handle handle = Allocate(m_Vertices, vertexCount);
+	uint32_t offset = m_Vertices.ranges[handle].offset;
+
+	Upload(m_Vertices, 0, positions, offset, vertexCount);
+	Upload(m_Vertices, 1, attributes, offset, vertexCount);
+
+	return handle;
+}
+
+GeometryArena::Handle GeometryArena::UploadIndices(const void* indices, VkIndexType indexType, uint32_t indexCount)
+{
+	Pool& pool = GetIndexPool(indexType);
+
+	Handle handle = Allocate(pool, indexCount);
+	Upload(pool, 0, indices, pool.ranges[handle].offset, indexCount);
+
+	return handle;
+}
+
+void GeometryArena::FreeVertices(Handle handle)
+{
+	Free(m_Vertices, handle);
+}
+
+void GeometryArena::FreeIndices(Handle handle, VkIndexType indexType)
+{
+	Free(GetIndexPool(indexType), handle);
+}
+
+uint32_t GeometryArena::GetFirstVertex(Handle handle) const
+{
+	assert(handle < m_Vertices.ranges.size() && m_Vertices.ranges[handle].live && "GeometryArena: invalid vertex handle");
+	return m_Vertices.ranges[handle].offset;
+}
+
+uint32_t GeometryArena::GetFirstIndex(Handle handle, VkIndexType indexType) const
+{
+	const Pool& pool = GetIndexPool(indexType);
+	assert(handle < pool.ranges.size() && pool.ranges[handle].live && "GeometryArena: invalid index handle");
+	return pool.ranges[handle].offset;
+}
+
+void GeometryArena::Bind(VkCommandBuffer commandBuffer)
+{
+	VkBuffer buffers[] = { m_Vertices.buffers[0]->getBuffer(), m_Vertices.buffers[1]->getBuffer() };
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+
+	m_BoundCommandBuffer = commandBuffer;
+	m_BoundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+}
+
+void GeometryArena::BindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType)
+{
+	if (commandBuffer == m_BoundCommandBuffer && indexType == m_BoundIndexType)
+	{
+		return;
+	}
+
+	vkCmdBindIndexBuffer(commandBuffer, GetIndexPool(indexType).buffers[0]->getBuffer(), 0, indexType);
+
+	m_BoundCommandBuffer = commandBuffer;
+	m_BoundIndexType = indexType;
+}
+
+void GeometryArena::CreatePool(Pool& pool, uint32_t capacity)
+{
+	pool.capacity = capacity;
+	pool.buffers.clear();
+
+	for (VkDeviceSize stride : pool.strides)
+	{
+		pool.buffers.push_back(std::make_unique<Buffer>(
+			m_Device,
+			stride,
+			capacity,
+			pool.usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+	}
+
+	pool.allocator.Reset(capacity, 0);
+}
+
+GeometryArena::Handle GeometryArena::Allocate(Pool& pool, uint32_t count)
+{
+	uint32_t offset = 0;
+	if (!pool.allocator.Allocate(count, offset))
+	{
+		// Compacting may already make room, grow anyway so the next upload doesn't land here again
+		Reallocate(pool, std::max(pool.capacity * 2, pool.usedCount + count));
+
+		if (!pool.allocator.Allocate(count, offset))
+		{
+			throw std::runtime_error("GeometryArena: failed to allocate geometry range!");
+		}
+	}
+
+	Handle handle;
+	if (!pool.freeHandles.empty())
+	{
+		handle = pool.freeHandles.back();
+		pool.freeHandles.pop_back();
+	}
+	else
+	{
+		handle = static_cast<Handle>(pool.ranges.size());
+		pool.ranges.push_back({});
+	}
+
+	pool.ranges[handle] = { offset, count, true };
+	pool.usedCount += count;
+
+	return handle;
+}
+
+void GeometryArena::Free(Pool& pool, Handle handle)
+{
+	if (handle == INVALID_HANDLE)
+	{
+		return;
+	}
+
+	assert(handle < pool.ranges.size() && pool.ranges[handle].live && "GeometryArena: double free or invalid handle");
+
+	Range& range = pool.ranges[handle];
+	pool.allocator.Free(range.offset, range.count);
+	pool.usedCount -= range.count;
+
+	range.live = false;
+	pool.freeHandles.push_back(handle);
+}
+
+void GeometryArena::Upload(Pool& pool, uint32_t stream, const void* data, uint32_t offset, uint32_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	VkDeviceSize stride = pool.strides[stream];
+	VkAccessFlags dstAccess = (pool.usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) ? VK_ACCESS_INDEX_READ_BIT : VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+	m_Device.getUploadManager().UploadBuffer(pool.buffers[stream]->getBuffer(), data, stride * count, stride * offset,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, dstAccess);
+}
+
+void GeometryArena::Reallocate(Pool& pool, uint32_t newCapacity)
+{
+	// Uploads still queued write the old buffers
+	m_Device.getUploadManager().WaitIdle();
+
+	std::vector<std::unique_ptr<Buffer>> oldBuffers = std::move(pool.buffers);
+	CreatePool(pool, newCapacity);
+
+	// Live ranges in their current order, so relative placement is kept
+	std::vector<Handle> liveHandles;
+	for (Handle handle = 0; handle < pool.ranges.size(); handle++)
+	{
+		if (pool.ranges[handle].live)
+		{
+			liveHandles.push_back(handle);
+		}
+	}
+	std::sort(liveHandles.begin(), liveHandles.end(), [&](Handle a, Handle b) { return pool.ranges[a].offset < pool.ranges[b].offset; });
+
+	std::vector<VkBufferCopy> regions;
+	uint32_t packedOffset = 0;
+	for (Handle handle : liveHandles)
+	{
+		Range& range = pool.ranges[handle];
+		regions.push_back({ range.offset, packedOffset, range.count });
+
+		range.offset = packedOffset;
+		packedOffset += range.count;
+	}
+
+	if (!regions.empty())
+	{
+		VkCommandBuffer commandBuffer = m_Device.beginSingleTimeCommands();
+		for (size_t stream = 0; stream < pool.buffers.size(); stream++)
+		{
+			// Regions are in elements, scale them to this stream's stride
+			std::vector<VkBufferCopy> streamRegions = regions;
+			for (auto& region : streamRegions)
+			{
+				region.srcOffset *= pool.strides[stream];
+				region.dstOffset *= pool.strides[stream];
+				region.size *= pool.strides[stream];
+			}
+			vkCmdCopyBuffer(commandBuffer, oldBuffers[stream]->getBuffer(), pool.buffers[stream]->getBuffer(), static_cast<uint32_t>(streamRegions.size()), streamRegions.data());
+		}
+		m_Device.endSingleTimeCommands(commandBuffer);
+	}
+
+	pool.allocator.Reset(newCapacity, packedOffset);
+
+	// In flight frames, and the one being recorded, may still read the old buffers
+	auto retired = std::make_shared<std::vector<std::unique_ptr<Buffer>>>(std::move(oldBuffers));
+	m_Device.getGraphicsTimeline().DeferDestroy([retired]() { retired->clear(); });
+
+	// Old buffers are gone, whatever was bound has to be bound again
+	m_BoundCommandBuffer = VK_NULL_HANDLE;
+	m_BoundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+}
+
+GeometryArena::Pool& GeometryArena::GetIndexPool(VkIndexType indexType)
+{
+	return indexType == VK_INDEX_TYPE_UINT16 ? m_Indices16 : m_Indices32;
+}
+
+const GeometryArena::Pool& GeometryArena::GetIndexPool(VkIndexType indexType) const
+{
+	return indexType == VK_INDEX_TYPE_UINT16 ? m_Indices16 : m_Indices32;
+}
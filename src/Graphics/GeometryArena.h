@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Device.h"
+#include "Buffer.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm/glm.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+// Every model's vertices and indices live in a few large shared buffers :
+// vertex streams (binding 0 positions, binding 1 attributes) and one index buffer per index type.
+// The streams are bound once per command buffer and draws only differ by firstIndex / vertexOffset.
+// Ranges come from a first-fit free list, offsets can move when the arena grows or is defragmented,
+// so they are looked up through handles at draw time.
+class GeometryArena
+{
+public:
+	using Handle = uint32_t;
+	static constexpr Handle INVALID_HANDLE = ~0u;
+
+	GeometryArena(Device& device, VkDeviceSize attributeStride, uint32_t vertexCapacity = 1 << 18, uint32_t indexCapacity = 1 << 20);
+	~GeometryArena();
+
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	// Uploads go through a staging buffer and wait for the copy, load time only
+	Handle UploadVertices(const glm::vec3* positions, const void* attributes, uint32_t vertexCount);
+	Handle UploadIndices(const void* indices, VkIndexType indexType, uint32_t indexCount);
+
+	void FreeVertices(Handle handle);
+	void FreeIndices(Handle handle, VkIndexType indexType);
+
+	uint32_t GetFirstVertex(Handle handle) const;
+	uint32_t GetFirstIndex(Handle handle, VkIndexType indexType) const;
+
+	// Binds both vertex streams, position-only pipelines simply never fetch binding 1
+	void Bind(VkCommandBuffer commandBuffer);
+	// Skipped when this index type is already bound on commandBuffer
+	void BindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType);
+
+	uint32_t GetVertexCount() const { return m_Vertices.usedCount; }
+	uint32_t GetVertexCapacity() const { return m_Vertices.capacity; }
+
+private:
+	// First-fit allocator over [0, capacity), free ranges keyed by offset so neighbours coalesce
+	class RangeAllocator
+	{
+	public:
+		void Reset(uint32_t capacity, uint32_t usedEnd);
+		bool Allocate(uint32_t count, uint32_t& offset);
+		void Free(uint32_t offset, uint32_t count);
+
+	private:
+		std::map<uint32_t, uint32_t> m_FreeRanges;	// offset -> count
+	};
+
+	struct Range
+	{
+		uint32_t offset = 0;
+		uint32_t count = 0;
+		bool live = false;
+	};
+
+	struct Pool
+	{
+		std::vector<VkDeviceSize> strides;
+		std::vector<std::unique_ptr<Buffer>> buffers;	// One per stream
+		VkBufferUsageFlags usage = 0;
+
+		RangeAllocator allocator;
+		uint32_t capacity = 0;
+		uint32_t usedCount = 0;
+
+		std::vector<Range> ranges;						// Indexed by handle
+		std::vector<Handle> freeHandles;
+	};
+
+	void CreatePool(Pool& pool, uint32_t capacity);
+	Handle Allocate(Pool& pool, uint32_t count);
+	void Free(Pool& pool, Handle handle);
+	void Upload(Pool& pool, uint32_t stream, const void* data, uint32_t offset, uint32_t count);
+
+	// New buffers of newCapacity with every live range packed to the front. Drains the UploadManager
+	// and copies on the GPU, the old buffers are freed through the graphics timeline once frames stop reading them
+	void Reallocate(Pool& pool, uint32_t newCapacity);
+
+	Pool& GetIndexPool(VkIndexType indexType);
+	const Pool& GetIndexPool(VkIndexType indexType) const;
+
+	Device& m_Device;
+
+	Pool m_Vertices;
+	Pool m_Indices16;
+	Pool m_Indices32;
+
+	VkCommandBuffer m_BoundCommandBuffer = VK_NULL_HANDLE;
+	VkIndexType m_BoundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+};
@@ -0,0 +1,214 @@
+#include "GpuProfiler.h"
+#include "../Instrumentation.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+GpuProfiler::GpuProfiler(Device& device) : m_Device(device)
+{
+	uint32_t graphicsFamily = m_Device.findPhysicalQueueFamilies().graphicsFamily;
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_Device.GetPhysicalDevice(), &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_Device.GetPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[graphicsFamily].timestampValidBits;
+	m_Enabled = validBits > 0;
+	if (!m_Enabled)
+	{
+		return;
+	}
+	m_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	m_TimestampPeriod = m_Device.properties.limits.timestampPeriod;
+
+	if (m_Device.CalibratedTimestampsSupported())
+	{
+		m_GetCalibratedTimestamps = (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(m_Device.device(), "vkGetCalibratedTimestampsEXT");
+	}
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 2 * MAX_SCOPES_PER_FRAME;
+
+	for (FrameQueries& frame : m_Frames)
+	{
+		if (vkCreateQueryPool(m_Device.device(), &queryPoolInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create GpuProfiler:QueryPool");
+		}
+		frame.scopeNames.reserve(MAX_SCOPES_PER_FRAME);
+	}
+	m_Timestamps.resize(2 * MAX_SCOPES_PER_FRAME);
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	if (!m_Enabled)
+	{
+		return;
+	}
+
+	m_Device.getGraphicsTimeline().WaitIdle();
+	for (FrameQueries& frame : m_Frames)
+	{
+		vkDestroyQueryPool(m_Device.device(), frame.queryPool, nullptr);
+	}
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if (!m_Enabled)
+	{
+		return;
+	}
+	assert(m_CurrentFrame == nullptr && "GpuProfiler : BeginFrame called twice without EndFrame");
+
+	// The slot about to be reused has finished for sure, the others are read as soon as their frame has
+	Timeline& timeline = m_Device.getGraphicsTimeline();
+	for (uint32_t i = 0; i < m_Frames.size(); i++)
+	{
+		FrameQueries& frame = m_Frames[i];
+		if (frame.pending && (i == frameIndex || timeline.IsComplete(frame.timelineValue)))
+		{
+			ReadBack(frame);
+		}
+	}
+
+	FrameQueries& frame = m_Frames[frameIndex];
+	vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, 2 * MAX_SCOPES_PER_FRAME);
+	frame.scopeNames.clear();
+	m_CurrentFrame = &frame;
+}
+
+void GpuProfiler::EndFrame(uint64_t timelineValue)
+{
+	if (m_CurrentFrame == nullptr)
+	{
+		return;
+	}
+
+	m_CurrentFrame->timelineValue = timelineValue;
+	m_CurrentFrame->submitTime = static_cast<long long>(Instrumentor::NowMicroseconds());
+	m_CurrentFrame->pending = !m_CurrentFrame->scopeNames.empty();
+	m_CurrentFrame = nullptr;
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (m_CurrentFrame == nullptr || m_CurrentFrame->scopeNames.size() >= MAX_SCOPES_PER_FRAME)
+	{
+		return INVALID_SCOPE;
+	}
+
+	uint32_t scope = static_cast<uint32_t>(m_CurrentFrame->scopeNames.size());
+	m_CurrentFrame->scopeNames.push_back(name);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_CurrentFrame->queryPool, 2 * scope);
+	return scope;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+	if (m_CurrentFrame == nullptr || scope == INVALID_SCOPE)
+	{
+		return;
+	}
+
+	// Bottom of pipe : written once every command recorded before it has completed
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_CurrentFrame->queryPool, 2 * scope + 1);
+}
+
+void GpuProfiler::ReadBack(FrameQueries& frame)
+{
+	frame.pending = false;
+
+	uint32_t queryCount = static_cast<uint32_t>(frame.scopeNames.size()) * 2;
+	// No wait flag : the frame's timeline value has been reached, a scope left open stays unavailable and drops the frame
+	VkResult result = vkGetQueryPoolResults(
+		m_Device.device(),
+		frame.queryPool,
+		0, queryCount,
+		queryCount * sizeof(uint64_t), m_Timestamps.data(), sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+	{
+		return;
+	}
+
+	uint64_t frameBegin = ~0ull;
+	uint64_t frameEnd = 0;
+	for (uint32_t i = 0; i < queryCount; i++)
+	{
+		m_Timestamps[i] &= m_TimestampMask;
+		frameBegin = std::min(frameBegin, m_Timestamps[i]);
+		frameEnd = std::max(frameEnd, m_Timestamps[i]);
+	}
+	m_FrameGpuTime = static_cast<float>((frameEnd - frameBegin) * m_TimestampPeriod / 1000000.0);
+
+	if (m_GetCalibratedTimestamps != nullptr)
+	{
+		Calibrate();
+	}
+	else
+	{
+		// The GPU cannot start a frame before it was submitted, so every frame gives a lower bound on the
+		// offset between the clocks. Keeping the tightest one converges whenever the GPU runs idle.
+		if (!m_Calibrated || ToCpuMicroseconds(frameBegin) < frame.submitTime)
+		{
+			m_GpuBase = frameBegin;
+			m_CpuBase = static_cast<double>(frame.submitTime);
+			m_Calibrated = true;
+		}
+	}
+
+	Instrumentor& instrumentor = Instrumentor::Get();
+	if (!instrumentor.IsSessionActive())
+	{
+		return;
+	}
+	if (!m_TrackNamed)
+	{
+		instrumentor.WriteTrackName(GPU_TRACK_ID, "GPU");
+		m_TrackNamed = true;
+	}
+
+	for (uint32_t scope = 0; scope < frame.scopeNames.size(); scope++)
+	{
+		uint64_t begin = m_Timestamps[2 * scope];
+		uint64_t end = m_Timestamps[2 * scope + 1];
+		if (end < begin)
+		{
+			continue;	// The counter wrapped within the scope
+		}
+		instrumentor.WriteProfile({ frame.scopeNames[scope], ToCpuMicroseconds(begin), ToCpuMicroseconds(end), GPU_TRACK_ID });
+	}
+}
+
+void GpuProfiler::Calibrate()
+{
+	VkCalibratedTimestampInfoEXT timestampInfo{};
+	timestampInfo.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	timestampInfo.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+
+	uint64_t timestamp = 0;
+	uint64_t maxDeviation = 0;
+	// The CPU clock is read on both sides, the device clock was sampled somewhere in between
+	double before = Instrumentor::NowMicroseconds();
+	VkResult result = m_GetCalibratedTimestamps(m_Device.device(), 1, &timestampInfo, &timestamp, &maxDeviation);
+	double after = Instrumentor::NowMicroseconds();
+	if (result != VK_SUCCESS)
+	{
+		return;
+	}
+
+	m_GpuBase = timestamp & m_TimestampMask;
+	m_CpuBase = (before + after) * 0.5;
+	m_Calibrated = true;
+}
+
+long long GpuProfiler::ToCpuMicroseconds(uint64_t timestamp) const
+{
+	double ticks = static_cast<double>(static_cast<int64_t>(timestamp - m_GpuBase));
+	return static_cast<long long>(m_CpuBase + ticks * m_TimestampPeriod / 1000.0);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Device.h"
+#include "SwapChain.h"
+#include "../Instrumentation.h"
+
+#include <array>
+#include <vector>
+
+// GPU side of the profiler : every scope writes a timestamp pair into its frame's query pool, the
+// pairs are read back once the frame's timeline value is reached (normally a frame later) and go
+// into the Instrumentor trace on their own "GPU" track, on the same time axis as the CPU scopes.
+// With VK_EXT_calibrated_timestamps the GPU clock is sampled against the CPU clock every readback,
+// otherwise the offset is estimated from submission times. Scopes are no-ops when the graphics
+// queue has no timestamp support. Render thread only.
+class GpuProfiler
+{
+public:
+	static constexpr uint32_t MAX_SCOPES_PER_FRAME = 64;
+	static constexpr uint32_t GPU_TRACK_ID = Instrumentor::FIRST_RESERVED_TRACK_ID;	// Never handed to a thread
+
+	GpuProfiler(Device& device);
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// Call right after vkBeginCommandBuffer, the frame's previous submission must have finished
+	void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+	// Call once the frame is submitted, with the timeline value its submission signals
+	void EndFrame(uint64_t timelineValue);
+
+	// Name must outlive the readback, string literals only. Returns an id for EndScope
+	uint32_t BeginScope(VkCommandBuffer commandBuffer, const char* name);
+	void EndScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+	bool IsEnabled() const { return m_Enabled; }
+	// Milliseconds between the first and last timestamp of the latest frame read back
+	float GetFrameGpuTime() const { return m_FrameGpuTime; }
+
+private:
+	static constexpr uint32_t INVALID_SCOPE = ~0u;
+
+	struct FrameQueries
+	{
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		std::vector<const char*> scopeNames;	// Timestamps 2 * i and 2 * i + 1
+		uint64_t timelineValue = 0;
+		long long submitTime = 0;				// CPU microseconds, fallback calibration only
+		bool pending = false;					// Written by a submitted frame, not read back yet
+	};
+
+	void ReadBack(FrameQueries& frame);
+	void Calibrate();
+	long long ToCpuMicroseconds(uint64_t timestamp) const;
+
+	Device& m_Device;
+	std::array<FrameQueries, SwapChain::MAX_FRAMES_IN_FLIGHT> m_Frames;
+	FrameQueries* m_CurrentFrame = nullptr;
+	std::vector<uint64_t> m_Timestamps;		// Readback scratch
+
+	bool m_Enabled = false;
+	bool m_TrackNamed = false;
+	double m_TimestampPeriod = 1.0;			// Nanoseconds per tick
+	uint64_t m_TimestampMask = ~0ull;		// timestampValidBits
+
+	// CPU microseconds = m_CpuBase + (timestamp - m_GpuBase) * period
+	bool m_Calibrated = false;
+	uint64_t m_GpuBase = 0;
+	double m_CpuBase = 0.0;
+
+	float m_FrameGpuTime = 0.0f;
+
+	PFN_vkGetCalibratedTimestampsEXT m_GetCalibratedTimestamps = nullptr;
+};
+
+// Both timestamps land in commandBuffer, keep the scope inside a single command buffer
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+		: m_Profiler(profiler), m_CommandBuffer(commandBuffer), m_Scope(profiler.BeginScope(commandBuffer, name))
+	{
+	}
+
+	~GpuProfileScope()
+	{
+		m_Profiler.EndScope(m_CommandBuffer, m_Scope);
+	}
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	GpuProfiler& m_Profiler;
+	VkCommandBuffer m_CommandBuffer;
+	uint32_t m_Scope;
+};
+
+#define PROFILE_GPU_SCOPE(profiler, commandBuffer, name) ::GpuProfileScope PROFILE_CONCAT(gpuTimer, __LINE__)(profiler, commandBuffer, name);
@@ -0,0 +1,150 @@
+#include "MaterialLibrary.h"
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+MaterialLibrary::MaterialLibrary(Device& device) : m_Device(device)
+{
+	// Leave room for the shadow maps and G-buffer inputs bound next to the material set
+	const uint32_t reservedSampledImages = 16;
+	VkPhysicalDeviceLimits limits = m_Device.GetPhysicalDeviceProperties().limits;
+	uint32_t sampledImageLimit = std::min(limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages);
+	m_MaxTextures = std::min(MAX_TEXTURES, sampledImageLimit - std::min(sampledImageLimit, reservedSampledImages));
+
+	if (m_MaxTextures == 0)
+	{
+		throw std::runtime_error("Device sampled image limit too low for the bindless texture array!");
+	}
+
+	m_SetLayout = DescriptorSetLayout::Builder(m_Device)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, m_MaxTextures, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT)
+		.addBinding(1, VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, SAMPLER_COUNT)
+		.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		.build();
+
+	m_Pool = DescriptorPool::Builder(m_Device)
+		.setMaxSets(1)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, m_MaxTextures)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_SAMPLER, SAMPLER_COUNT)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
+		.build();
+
+	m_MaterialBuffer = std::make_unique<Buffer>(
+		m_Device,
+		sizeof(GPUMaterial),
+		MAX_MATERIALS,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	CreateSamplers();
+
+	std::array<VkDescriptorImageInfo, SAMPLER_COUNT> samplerInfos{};
+	auto materialBufferInfo = m_MaterialBuffer->descriptorInfo();
+
+	DescriptorWriter writer(*m_SetLayout, *m_Pool);
+	writer.writeBuffer(2, &materialBufferInfo);
+	for (uint32_t i = 0; i < SAMPLER_COUNT; i++)
+	{
+		samplerInfos[i].sampler = m_Samplers[i];
+		writer.writeImageArrayElement(1, i, &samplerInfos[i]);
+	}
+
+	if (!writer.build(m_DescriptorSet))
+	{
+		throw std::runtime_error("Failed to allocate the bindless material descriptor set!");
+	}
+
+	// Slot 0, what unset material textures point at
+	RegisterTexture(std::make_shared<Texture>(m_Device, "Assets/Textures/white.png"));
+}
+
+MaterialLibrary::~MaterialLibrary()
+{
+	for (VkSampler sampler : m_Samplers)
+	{
+		vkDestroySampler(m_Device.device(), sampler, nullptr);
+	}
+}
+
+uint32_t MaterialLibrary::RegisterTexture(std::shared_ptr<Texture> texture)
+{
+	auto it = m_TextureSlots.find(texture.get());
+	if (it != m_TextureSlots.end())
+	{
+		return it->second;
+	}
+
+	if (m_Textures.size() >= m_MaxTextures)
+	{
+		throw std::runtime_error("Bindless texture array is full!");
+	}
+
+	uint32_t slot = static_cast<uint32_t>(m_Textures.size());
+
+	// Sampler comes from the sampler table, only the view and layout are read
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView = texture->GetImageView();
+	imageInfo.imageLayout = texture->GetImageLayout();
+
+	DescriptorWriter(*m_SetLayout, *m_Pool)
+		.writeImageArrayElement(0, slot, &imageInfo)
+		.overwrite(m_DescriptorSet);
+
+	m_TextureSlots[texture.get()] = slot;
+	m_Textures.push_back(texture);
+
+	return slot;
+}
+
+uint32_t MaterialLibrary::AddMaterial(const GPUMaterial& material)
+{
+	if (m_MaterialCount >= MAX_MATERIALS)
+	{
+		throw std::runtime_error("Material buffer is full!");
+	}
+
+	assert(material.albedoTexture < m_Textures.size() && material.normalTexture < m_Textures.size() &&
+		material.metallicRoughnessTexture < m_Textures.size() && material.emissiveTexture < m_Textures.size() &&
+		material.occlusionTexture < m_Textures.size() && "MaterialLibrary: material references an unregistered texture");
+	assert(material.sampler < SAMPLER_COUNT && "MaterialLibrary: invalid sampler index");
+
+	uint32_t materialIndex = m_MaterialCount++;
+	m_Device.getUploadManager().UploadBuffer(m_MaterialBuffer->getBuffer(), &material, sizeof(GPUMaterial), sizeof(GPUMaterial) * materialIndex,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+	return materialIndex;
+}
+
+void MaterialLibrary::CreateSamplers()
+{
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.mipLodBias = 0.0f;
+	samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;		// Shared by textures of any mip count
+	samplerInfo.maxAnisotropy = 4.0f;
+	samplerInfo.anisotropyEnable = VK_TRUE;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+	std::array<VkSamplerAddressMode, SAMPLER_COUNT> addressModes{};
+	addressModes[LINEAR_REPEAT] = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	addressModes[LINEAR_CLAMP] = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+	for (uint32_t i = 0; i < SAMPLER_COUNT; i++)
+	{
+		samplerInfo.addressModeU = addressModes[i];
+		samplerInfo.addressModeV = addressModes[i];
+		samplerInfo.addressModeW = addressModes[i];
+
+		if (vkCreateSampler(m_Device.device(), &samplerInfo, nullptr, &m_Samplers[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create material sampler!");
+		}
+	}
+}
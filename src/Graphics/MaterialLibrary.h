@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Device.h"
+#include "Buffer.h"
+#include "Texture.h"
+#include "Descriptor.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm/glm.hpp>
+
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Bindless material data shared by every model :
+// binding 0 is a partially bound array of sampled images, binding 1 a small sampler table
+// and binding 2 a storage buffer of GPUMaterial. Draws select their material through
+// firstInstance (gl_InstanceIndex), so the one descriptor set is bound once per pass.
+// Textures and materials are registered at load time, before any frame records the set.
+class MaterialLibrary
+{
+public:
+	enum SamplerType : uint32_t
+	{
+		LINEAR_REPEAT = 0,
+		LINEAR_CLAMP = 1,
+		SAMPLER_COUNT
+	};
+
+	static constexpr uint32_t DEFAULT_TEXTURE = 0;		// White, registered by the constructor
+
+	// std430 layout, must match struct Material in Basic.frag and GBuffer.frag
+	struct GPUMaterial
+	{
+		glm::vec4 albedoFactor{ 1.0f };
+		glm::vec4 emissiveFactor{ 0.0f };	// w = emissive strength
+		float metallicFactor = 1.0f;
+		float roughnessFactor = 1.0f;
+
+		uint32_t albedoTexture = DEFAULT_TEXTURE;
+		uint32_t normalTexture = DEFAULT_TEXTURE;
+		uint32_t metallicRoughnessTexture = DEFAULT_TEXTURE;
+		uint32_t emissiveTexture = DEFAULT_TEXTURE;
+		uint32_t occlusionTexture = DEFAULT_TEXTURE;
+		uint32_t sampler = LINEAR_REPEAT;
+	};
+	static_assert(sizeof(GPUMaterial) % 16 == 0, "GPUMaterial must keep the std430 array stride");
+
+	static constexpr uint32_t MAX_TEXTURES = 1024;		// Clamped to the device sampled image limits
+	static constexpr uint32_t MAX_MATERIALS = 4096;
+
+	MaterialLibrary(Device& device);
+	~MaterialLibrary();
+
+	MaterialLibrary(const MaterialLibrary&) = delete;
+	MaterialLibrary& operator=(const MaterialLibrary&) = delete;
+
+	// Returns the texture's slot in the bindless array, the same texture always gets the same slot
+	uint32_t RegisterTexture(std::shared_ptr<Texture> texture);
+	// Returns the material ID to draw with
+	uint32_t AddMaterial(const GPUMaterial& material);
+
+	std::shared_ptr<Texture> GetDefaultTexture() const { return m_Textures[DEFAULT_TEXTURE]; }
+
+	VkDescriptorSetLayout GetDescriptorSetLayout() const { return m_SetLayout->getDescriptorSetLayout(); }
+	VkDescriptorSet GetDescriptorSet() const { return m_DescriptorSet; }
+
+	uint32_t GetTextureCount() const { return static_cast<uint32_t>(m_Textures.size()); }
+	uint32_t GetMaterialCount() const { return m_MaterialCount; }
+
+private:
+	void CreateSamplers();
+
+	Device& m_Device;
+	uint32_t m_MaxTextures = MAX_TEXTURES;
+
+	std::unique_ptr<DescriptorSetLayout> m_SetLayout;
+	std::unique_ptr<DescriptorPool> m_Pool;
+	VkDescriptorSet m_DescriptorSet = VK_NULL_HANDLE;
+
+	// Kept alive for as long as their descriptors can be sampled
+	std::vector<std::shared_ptr<Texture>> m_Textures;
+	std::unordered_map<Texture*, uint32_t> m_TextureSlots;
+
+	std::array<VkSampler, SAMPLER_COUNT> m_Samplers{};
+
+	std::unique_ptr<Buffer> m_MaterialBuffer;
+	uint32_t m_MaterialCount = 0;
+};
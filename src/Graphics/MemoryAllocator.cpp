@@ -0,0 +1,525 @@
+#include "MemoryAllocator.h"
+#include "../Instrumentation.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+	constexpr VkDeviceSize MEGABYTE = 1024 * 1024;
+	constexpr VkDeviceSize LARGE_HEAP_BLOCK_SIZE = 256 * MEGABYTE;
+	constexpr VkDeviceSize SMALL_HEAP_BLOCK_SIZE = 64 * MEGABYTE;
+
+	VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	VkDeviceSize AlignDown(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return value / alignment * alignment;
+	}
+}
+
+struct MemoryBlock
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;
+	uint32_t poolIndex = 0;
+	uint32_t allocationCount = 0;
+	VkDeviceSize usedBytes = 0;
+
+	std::map<VkDeviceSize, VkDeviceSize> freeRanges;		// offset -> size, so neighbours coalesce
+	std::multimap<VkDeviceSize, VkDeviceSize> freeBySize;	// size -> offset, for the best fit lookup
+
+	void AddFreeRange(VkDeviceSize offset, VkDeviceSize rangeSize)
+	{
+		freeRanges[offset] = rangeSize;
+		freeBySize.emplace(rangeSize, offset);
+	}
+
+	void RemoveFreeRange(VkDeviceSize offset)
+	{
+		auto range = freeRanges.find(offset);
+		assert(range != freeRanges.end() && "MemoryBlock : removing a range that is not free");
+
+		auto sizeRange = freeBySize.equal_range(range->second);
+		for (auto it = sizeRange.first; it != sizeRange.second; ++it)
+		{
+			if (it->second == offset)
+			{
+				freeBySize.erase(it);
+				break;
+			}
+		}
+		freeRanges.erase(range);
+	}
+
+	// Smallest free range that still fits once aligned, the padding in front stays free
+	bool Allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, VkDeviceSize& offset)
+	{
+		for (auto it = freeBySize.lower_bound(allocationSize); it != freeBySize.end(); ++it)
+		{
+			VkDeviceSize rangeOffset = it->second;
+			VkDeviceSize rangeEnd = rangeOffset + it->first;
+			VkDeviceSize alignedOffset = AlignUp(rangeOffset, alignment);
+			if (alignedOffset + allocationSize > rangeEnd)
+			{
+				continue;
+			}
+
+			RemoveFreeRange(rangeOffset);
+			if (alignedOffset > rangeOffset)
+			{
+				AddFreeRange(rangeOffset, alignedOffset - rangeOffset);
+			}
+			if (alignedOffset + allocationSize < rangeEnd)
+			{
+				AddFreeRange(alignedOffset + allocationSize, rangeEnd - alignedOffset - allocationSize);
+			}
+
+			offset = alignedOffset;
+			return true;
+		}
+
+		return false;
+	}
+
+	void Free(VkDeviceSize offset, VkDeviceSize allocationSize)
+	{
+		VkDeviceSize start = offset;
+		VkDeviceSize end = offset + allocationSize;
+
+		auto next = freeRanges.lower_bound(start);
+		if (next != freeRanges.end() && next->first == end)
+		{
+			end += next->second;
+			RemoveFreeRange(next->first);
+		}
+
+		next = freeRanges.lower_bound(start);
+		if (next != freeRanges.begin())
+		{
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == start)
+			{
+				start = previous->first;
+				RemoveFreeRange(previous->first);
+			}
+		}
+
+		AddFreeRange(start, end - start);
+	}
+};
+
+MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device) : m_Device(device)
+{
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_NonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+	m_MaxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+	m_Pools.resize(m_MemoryProperties.memoryTypeCount * POOL_KIND_COUNT);
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+	{
+		VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[i].heapIndex].size;
+
+		// Small heaps (resizable BAR windows, integrated carve-outs) get blocks scaled to the heap
+		VkDeviceSize blockSize = LARGE_HEAP_BLOCK_SIZE;
+		if (heapSize < 1024 * MEGABYTE)
+		{
+			blockSize = AlignUp(heapSize / 8, MEGABYTE);
+		}
+		else if (heapSize < 4096 * MEGABYTE)
+		{
+			blockSize = SMALL_HEAP_BLOCK_SIZE;
+		}
+
+		for (uint32_t kind = 0; kind < POOL_KIND_COUNT; kind++)
+		{
+			m_Pools[i * POOL_KIND_COUNT + kind].preferredBlockSize = blockSize;
+		}
+	}
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+	for (auto& pool : m_Pools)
+	{
+		for (auto& block : pool.blocks)
+		{
+			vkFreeMemory(m_Device, block->memory, nullptr);
+		}
+	}
+
+	for (auto& [memory, dedicated] : m_Dedicated)
+	{
+		vkFreeMemory(m_Device, memory, nullptr);
+	}
+}
+
+MemoryAllocation MemoryAllocator::AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties)
+{
+	VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.buffer = buffer;
+
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicatedRequirements;
+	vkGetBufferMemoryRequirements2(m_Device, &requirementsInfo, &requirements);
+
+	bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	MemoryAllocation allocation = Allocate(requirements.memoryRequirements, properties, POOL_LINEAR, dedicated, buffer, VK_NULL_HANDLE);
+
+	if (vkBindBufferMemory(m_Device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+	{
+		Free(allocation);
+		throw std::runtime_error("failed to bind buffer memory!");
+	}
+
+	return allocation;
+}
+
+MemoryAllocation MemoryAllocator::AllocateForImage(VkImage image, const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties)
+{
+	VkImageMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.image = image;
+
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicatedRequirements;
+	vkGetImageMemoryRequirements2(m_Device, &requirementsInfo, &requirements);
+
+	bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+
+	// Resizing frees and reallocates the attachments every frame of a drag, their own pool keeps
+	// that churn inside already allocated blocks instead of going through vkAllocateMemory
+	bool renderTarget = (imageInfo.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+	PoolKind kind = POOL_LINEAR;
+	if (imageInfo.tiling != VK_IMAGE_TILING_LINEAR)
+	{
+		kind = renderTarget ? POOL_RENDER_TARGET : POOL_OPTIMAL;
+	}
+	MemoryAllocation allocation = Allocate(requirements.memoryRequirements, properties, kind, dedicated, VK_NULL_HANDLE, image);
+
+	if (vkBindImageMemory(m_Device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+	{
+		Free(allocation);
+		throw std::runtime_error("failed to bind image memory!");
+	}
+
+	return allocation;
+}
+
+void MemoryAllocator::Free(MemoryAllocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	if (!allocation.block)
+	{
+		m_Dedicated.erase(allocation.memory);
+		vkFreeMemory(m_Device, allocation.memory, nullptr);
+		allocation = {};
+		return;
+	}
+
+	MemoryBlock* block = allocation.block;
+	block->Free(allocation.offset, allocation.size);
+	block->allocationCount--;
+	block->usedBytes -= allocation.size;
+	allocation = {};
+
+	if (block->allocationCount > 0)
+	{
+		return;
+	}
+
+	// Keep one empty block per pool around so a resource freed and recreated does not hit the driver
+	Pool& pool = m_Pools[block->poolIndex];
+	uint32_t emptyBlocks = static_cast<uint32_t>(std::count_if(pool.blocks.begin(), pool.blocks.end(),
+		[](const std::unique_ptr<MemoryBlock>& poolBlock) { return poolBlock->allocationCount == 0; }));
+	if (emptyBlocks > 1)
+	{
+		DestroyBlock(block);
+	}
+}
+
+VkResult MemoryAllocator::Flush(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+{
+	if (IsCoherent(allocation.memoryTypeIndex))
+	{
+		return VK_SUCCESS;
+	}
+
+	VkMappedMemoryRange mappedRange = GetMappedRange(allocation, size, offset);
+	return vkFlushMappedMemoryRanges(m_Device, 1, &mappedRange);
+}
+
+VkResult MemoryAllocator::Invalidate(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+{
+	if (IsCoherent(allocation.memoryTypeIndex))
+	{
+		return VK_SUCCESS;
+	}
+
+	VkMappedMemoryRange mappedRange = GetMappedRange(allocation, size, offset);
+	return vkInvalidateMappedMemoryRanges(m_Device, 1, &mappedRange);
+}
+
+std::vector<MemoryAllocator::HeapStats> MemoryAllocator::GetHeapStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	std::vector<HeapStats> stats(m_MemoryProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; i++)
+	{
+		stats[i].heapSize = m_MemoryProperties.memoryHeaps[i].size;
+	}
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(m_Pools.size()); i++)
+	{
+		HeapStats& heap = stats[m_MemoryProperties.memoryTypes[i / POOL_KIND_COUNT].heapIndex];
+		for (auto& block : m_Pools[i].blocks)
+		{
+			heap.blockCount++;
+			heap.blockBytes += block->size;
+			heap.allocationCount += block->allocationCount;
+			heap.usedBytes += block->usedBytes;
+		}
+	}
+
+	for (auto& [memory, dedicated] : m_Dedicated)
+	{
+		HeapStats& heap = stats[m_MemoryProperties.memoryTypes[dedicated.memoryTypeIndex].heapIndex];
+		heap.dedicatedCount++;
+		heap.dedicatedBytes += dedicated.size;
+		heap.allocationCount++;
+		heap.usedBytes += dedicated.size;
+	}
+
+	return stats;
+}
+
+uint32_t MemoryAllocator::GetDeviceMemoryCount() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	uint32_t count = static_cast<uint32_t>(m_Dedicated.size());
+	for (auto& pool : m_Pools)
+	{
+		count += static_cast<uint32_t>(pool.blocks.size());
+	}
+	return count;
+}
+
+void MemoryAllocator::PrintStats() const
+{
+	std::vector<HeapStats> stats = GetHeapStats();
+	for (uint32_t i = 0; i < static_cast<uint32_t>(stats.size()); i++)
+	{
+		const HeapStats& heap = stats[i];
+		if (heap.allocationCount == 0 && heap.blockCount == 0)
+		{
+			continue;
+		}
+
+		std::cout << "Memory heap " << i << " : " << heap.allocationCount << " allocations using " << heap.usedBytes / MEGABYTE << " MB, "
+			<< heap.blockCount << " blocks (" << heap.blockBytes / MEGABYTE << " MB), "
+			<< heap.dedicatedCount << " dedicated (" << heap.dedicatedBytes / MEGABYTE << " MB), heap size " << heap.heapSize / MEGABYTE << " MB" << std::endl;
+	}
+	std::cout << "Device memory objects : " << GetDeviceMemoryCount() << " / " << m_MaxAllocationCount << std::endl;
+}
+
+MemoryAllocation MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, PoolKind kind, bool dedicated, VkBuffer buffer, VkImage image)
+{
+	PROFILE_FUNCTION();
+
+	uint32_t memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, properties);
+	VkDeviceSize minAlignment = GetMinAlignment(memoryTypeIndex);
+	VkDeviceSize alignment = std::max(requirements.alignment, minAlignment);
+	VkDeviceSize size = AlignUp(requirements.size, minAlignment);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	uint32_t poolIndex = memoryTypeIndex * POOL_KIND_COUNT + kind;
+	Pool& pool = m_Pools[poolIndex];
+	if (dedicated || size > pool.preferredBlockSize / 2)
+	{
+		return AllocateDedicated(size, memoryTypeIndex, buffer, image);
+	}
+
+	VkDeviceSize offset = 0;
+	MemoryBlock* block = nullptr;
+	for (auto& poolBlock : pool.blocks)
+	{
+		if (poolBlock->Allocate(size, alignment, offset))
+		{
+			block = poolBlock.get();
+			break;
+		}
+	}
+
+	if (!block)
+	{
+		block = CreateBlock(pool, size, memoryTypeIndex, poolIndex);
+		bool allocated = block->Allocate(size, alignment, offset);
+		assert(allocated && "MemoryAllocator : new block too small for its first allocation");
+	}
+
+	block->allocationCount++;
+	block->usedBytes += size;
+
+	MemoryAllocation allocation{};
+	allocation.memory = block->memory;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.block = block;
+	return allocation;
+}
+
+MemoryAllocation MemoryAllocator::AllocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image)
+{
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.buffer = buffer;
+	dedicatedInfo.image = image;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = &dedicatedInfo;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	MemoryAllocation allocation{};
+	if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate dedicated memory!");
+	}
+
+	if (IsHostVisible(memoryTypeIndex) && vkMapMemory(m_Device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped) != VK_SUCCESS)
+	{
+		vkFreeMemory(m_Device, allocation.memory, nullptr);
+		throw std::runtime_error("failed to map dedicated memory!");
+	}
+
+	allocation.size = size;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	m_Dedicated[allocation.memory] = { size, memoryTypeIndex };
+	return allocation;
+}
+
+MemoryBlock* MemoryAllocator::CreateBlock(Pool& pool, VkDeviceSize minSize, uint32_t memoryTypeIndex, uint32_t poolIndex)
+{
+	// The first blocks of a pool start at an eighth of the preferred size and double,
+	// so memory types only used for a few small buffers don't reserve a whole block
+	uint32_t shift = 3 - std::min<uint32_t>(static_cast<uint32_t>(pool.blocks.size()), 3);
+	VkDeviceSize blockSize = std::max(pool.preferredBlockSize >> shift, minSize);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	auto block = std::make_unique<MemoryBlock>();
+	while (true)
+	{
+		allocInfo.allocationSize = blockSize;
+		VkResult result = vkAllocateMemory(m_Device, &allocInfo, nullptr, &block->memory);
+		if (result == VK_SUCCESS)
+		{
+			break;
+		}
+
+		// Out of memory for a full block, retry smaller down to what the allocation needs
+		if (blockSize / 2 < minSize)
+		{
+			throw std::runtime_error("failed to allocate memory block!");
+		}
+		blockSize /= 2;
+	}
+
+	if (IsHostVisible(memoryTypeIndex) && vkMapMemory(m_Device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS)
+	{
+		vkFreeMemory(m_Device, block->memory, nullptr);
+		throw std::runtime_error("failed to map memory block!");
+	}
+
+	block->size = blockSize;
+	block->poolIndex = poolIndex;
+	block->AddFreeRange(0, blockSize);
+
+	pool.blocks.push_back(std::move(block));
+	return pool.blocks.back().get();
+}
+
+void MemoryAllocator::DestroyBlock(MemoryBlock* block)
+{
+	Pool& pool = m_Pools[block->poolIndex];
+	auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](const std::unique_ptr<MemoryBlock>& poolBlock) { return poolBlock.get() == block; });
+	assert(it != pool.blocks.end() && "MemoryAllocator : block not owned by its pool");
+
+	vkFreeMemory(m_Device, block->memory, nullptr);
+	pool.blocks.erase(it);
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool MemoryAllocator::IsHostVisible(uint32_t memoryTypeIndex) const
+{
+	return (m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+bool MemoryAllocator::IsCoherent(uint32_t memoryTypeIndex) const
+{
+	return (m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+VkDeviceSize MemoryAllocator::GetMinAlignment(uint32_t memoryTypeIndex) const
+{
+	return IsHostVisible(memoryTypeIndex) && !IsCoherent(memoryTypeIndex) ? m_NonCoherentAtomSize : 1;
+}
+
+VkMappedMemoryRange MemoryAllocator::GetMappedRange(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const
+{
+	// Non coherent allocations are aligned and sized to whole atoms, the widened range stays inside them
+	VkDeviceSize start = allocation.offset + offset;
+	VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : start + size;
+
+	VkMappedMemoryRange mappedRange{};
+	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	mappedRange.memory = allocation.memory;
+	mappedRange.offset = AlignDown(start, m_NonCoherentAtomSize);
+	mappedRange.size = AlignUp(end, m_NonCoherentAtomSize) - mappedRange.offset;
+	return mappedRange;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../Window.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct MemoryBlock;
+
+// A range of device memory handed out by MemoryAllocator. Host visible memory stays mapped for
+// the lifetime of its VkDeviceMemory, so resources sharing a block can all be written at once.
+struct MemoryAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;			// Start of this range, null for device local memory
+	uint32_t memoryTypeIndex = 0;
+	MemoryBlock* block = nullptr;	// Null for dedicated allocations
+};
+
+// Device memory blocks sub-allocated with a best fit free list. Buffers and linear images share
+// one set of blocks per memory type, optimal images another, so neighbours never break
+// bufferImageGranularity. Optimal render targets get blocks of their own : they are recreated on
+// every resize and would fragment the texture blocks. Resources the driver wants on their own
+// memory and anything over half a block get a dedicated vkAllocateMemory.
+class MemoryAllocator
+{
+public:
+	struct HeapStats
+	{
+		VkDeviceSize heapSize = 0;
+		uint32_t blockCount = 0;
+		VkDeviceSize blockBytes = 0;
+		uint32_t dedicatedCount = 0;
+		VkDeviceSize dedicatedBytes = 0;
+		uint32_t allocationCount = 0;	// Sub-allocations and dedicated ones
+		VkDeviceSize usedBytes = 0;
+	};
+
+	MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+	~MemoryAllocator();
+
+	MemoryAllocator(const MemoryAllocator&) = delete;
+	MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+	// Allocate and bind, throw when no memory type or memory is available
+	MemoryAllocation AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+	MemoryAllocation AllocateForImage(VkImage image, const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties);
+	// Resets allocation, the resource bound to it must already be destroyed
+	void Free(MemoryAllocation& allocation);
+
+	// Offset and size are relative to the allocation, no-ops on coherent memory
+	VkResult Flush(const MemoryAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+	VkResult Invalidate(const MemoryAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+	std::vector<HeapStats> GetHeapStats() const;
+	// Live VkDeviceMemory objects, against maxMemoryAllocationCount
+	uint32_t GetDeviceMemoryCount() const;
+	void PrintStats() const;
+
+private:
+	enum PoolKind : uint32_t
+	{
+		POOL_LINEAR = 0,	// Buffers and linear images
+		POOL_OPTIMAL = 1,	// Optimal tiling images
+		POOL_RENDER_TARGET = 2,	// Optimal tiling color and depth attachments
+		POOL_KIND_COUNT
+	};
+
+	struct Pool
+	{
+		VkDeviceSize preferredBlockSize = 0;
+		std::vector<std::unique_ptr<MemoryBlock>> blocks;
+	};
+
+	struct DedicatedAllocation
+	{
+		VkDeviceSize size;
+		uint32_t memoryTypeIndex;
+	};
+
+	MemoryAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, PoolKind kind, bool dedicated, VkBuffer buffer, VkImage image);
+	MemoryAllocation AllocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex, VkBuffer buffer, VkImage image);
+	MemoryBlock* CreateBlock(Pool& pool, VkDeviceSize minSize, uint32_t memoryTypeIndex, uint32_t poolIndex);
+	void DestroyBlock(MemoryBlock* block);
+
+	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	bool IsHostVisible(uint32_t memoryTypeIndex) const;
+	bool IsCoherent(uint32_t memoryTypeIndex) const;
+	// Non coherent ranges must start and end on nonCoherentAtomSize
+	VkDeviceSize GetMinAlignment(uint32_t memoryTypeIndex) const;
+	VkMappedMemoryRange GetMappedRange(const MemoryAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const;
+
+	VkDevice m_Device;
+	VkPhysicalDeviceMemoryProperties m_MemoryProperties{};
+	VkDeviceSize m_NonCoherentAtomSize = 1;
+	uint32_t m_MaxAllocationCount = 0;
+
+	mutable std::mutex m_Mutex;
+	std::vector<Pool> m_Pools;	// memoryTypeIndex * POOL_KIND_COUNT + kind
+	std::map<VkDeviceMemory, DedicatedAllocation> m_Dedicated;
+};
@@ -0,0 +1,299 @@
+#include "OcclusionCuller.h"
+#include "../FrameArena.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define OCCLUSION_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+OcclusionCuller::OcclusionCuller()
+{
+	m_Depth.resize(WIDTH * HEIGHT, 1.0f);
+	m_HiZ.resize(HIZ_WIDTH * HIZ_HEIGHT, 1.0f);
+	m_TileBins.resize(TILES_X * TILES_Y);
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjection)
+{
+	m_ViewProjection = viewProjection;
+
+	m_Triangles.clear();
+	for (auto& bin : m_TileBins)
+	{
+		bin.clear();
+	}
+
+	std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+	std::fill(m_HiZ.begin(), m_HiZ.end(), 1.0f);
+}
+
+void OcclusionCuller::AddOccluder(const glm::mat4& modelMatrix, const void* positions, size_t positionStride, const uint32_t* indices, uint32_t indexCount, uint32_t baseVertex)
+{
+	const glm::mat4 mvp = m_ViewProjection * modelMatrix;
+	const uint8_t* positionBytes = static_cast<const uint8_t*>(positions);
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		glm::vec3 screen[3];
+		bool clipped = false;
+
+		for (uint32_t v = 0; v < 3; v++)
+		{
+			const glm::vec3& position = *reinterpret_cast<const glm::vec3*>(positionBytes + (size_t)(indices[i + v] + baseVertex) * positionStride);
+			glm::vec4 clip = mvp * glm::vec4(position, 1.0f);
+
+			// Crossing the near plane, dropping an occluder is always safe
+			if (clip.w <= 1e-5f || clip.z < 0.0f)
+			{
+				clipped = true;
+				break;
+			}
+
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			screen[v] = glm::vec3((ndc.x * 0.5f + 0.5f) * WIDTH, (ndc.y * 0.5f + 0.5f) * HEIGHT, ndc.z);
+		}
+
+		if (clipped)
+		{
+			continue;
+		}
+
+		float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+		if (std::abs(area) < 1e-6f)
+		{
+			continue;
+		}
+
+		// Occluders are double sided, just make the winding positive
+		if (area < 0.0f)
+		{
+			std::swap(screen[1], screen[2]);
+			area = -area;
+		}
+
+		float minXf = std::min({ screen[0].x, screen[1].x, screen[2].x });
+		float maxXf = std::max({ screen[0].x, screen[1].x, screen[2].x });
+		float minYf = std::min({ screen[0].y, screen[1].y, screen[2].y });
+		float maxYf = std::max({ screen[0].y, screen[1].y, screen[2].y });
+
+		if (maxXf < 0.0f || maxYf < 0.0f || minXf >= WIDTH || minYf >= HEIGHT)
+		{
+			continue;
+		}
+
+		ScreenTriangle triangle{};
+		triangle.minX = std::max(0, (int)std::floor(minXf));
+		triangle.minY = std::max(0, (int)std::floor(minYf));
+		triangle.maxX = std::min((int)WIDTH - 1, (int)std::ceil(maxXf));
+		triangle.maxY = std::min((int)HEIGHT - 1, (int)std::ceil(maxYf));
+
+		// Edge k is opposite vertex k
+		for (uint32_t e = 0; e < 3; e++)
+		{
+			const glm::vec3& a = screen[(e + 1) % 3];
+			const glm::vec3& b = screen[(e + 2) % 3];
+			triangle.edgeA[e] = a.y - b.y;
+			triangle.edgeB[e] = b.x - a.x;
+			triangle.edgeC[e] = a.x * b.y - a.y * b.x;
+		}
+
+		// Barycentric weights are E_k / area, so depth is linear in x and y
+		float invArea = 1.0f / area;
+		glm::vec3 z = glm::vec3(screen[0].z, screen[1].z, screen[2].z);
+		triangle.zA = glm::dot(triangle.edgeA, z) * invArea;
+		triangle.zB = glm::dot(triangle.edgeB, z) * invArea;
+		triangle.zC = glm::dot(triangle.edgeC, z) * invArea;
+
+		uint32_t triangleIndex = static_cast<uint32_t>(m_Triangles.size());
+		m_Triangles.push_back(triangle);
+
+		for (int ty = triangle.minY / (int)TILE_HEIGHT; ty <= triangle.maxY / (int)TILE_HEIGHT; ty++)
+		{
+			for (int tx = triangle.minX / (int)TILE_WIDTH; tx <= triangle.maxX / (int)TILE_WIDTH; tx++)
+			{
+				m_TileBins[ty * TILES_X + tx].push_back(triangleIndex);
+			}
+		}
+	}
+}
+
+void OcclusionCuller::Rasterize()
+{
+	FrameVector<uint32_t> tiles(TILES_X * TILES_Y);
+	std::iota(tiles.begin(), tiles.end(), 0);
+
+	// Tiles own disjoint parts of the depth and HiZ buffers
+	std::for_each(std::execution::par, tiles.begin(), tiles.end(), [this](uint32_t tileIndex)
+		{
+			RasterizeTile(tileIndex);
+			BuildHiZ(tileIndex);
+		});
+}
+
+void OcclusionCuller::RasterizeTile(uint32_t tileIndex)
+{
+	const int tileMinX = (int)((tileIndex % TILES_X) * TILE_WIDTH);
+	const int tileMinY = (int)((tileIndex / TILES_X) * TILE_HEIGHT);
+	const int tileMaxX = tileMinX + (int)TILE_WIDTH - 1;
+	const int tileMaxY = tileMinY + (int)TILE_HEIGHT - 1;
+
+	for (uint32_t triangleIndex : m_TileBins[tileIndex])
+	{
+		const ScreenTriangle& triangle = m_Triangles[triangleIndex];
+
+		// Rows are processed 4 pixels at a time, tile bounds are multiples of 4
+		const int minX = std::max(triangle.minX, tileMinX) & ~3;
+		const int maxX = std::min(triangle.maxX, tileMaxX);
+		const int minY = std::max(triangle.minY, tileMinY);
+		const int maxY = std::min(triangle.maxY, tileMaxY);
+
+#ifdef OCCLUSION_CULLER_SSE
+		const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+		const __m128 edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+		const __m128 edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+		const __m128 zA = _mm_set1_ps(triangle.zA);
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			const float py = (float)y + 0.5f;
+			const __m128 rowE0 = _mm_set1_ps(triangle.edgeB[0] * py + triangle.edgeC[0]);
+			const __m128 rowE1 = _mm_set1_ps(triangle.edgeB[1] * py + triangle.edgeC[1]);
+			const __m128 rowE2 = _mm_set1_ps(triangle.edgeB[2] * py + triangle.edgeC[2]);
+			const __m128 rowZ = _mm_set1_ps(triangle.zB * py + triangle.zC);
+
+			float* depthRow = &m_Depth[y * WIDTH];
+			for (int x = minX; x <= maxX; x += 4)
+			{
+				const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), pixelOffsets);
+
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, px), rowE0), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, px), rowE1), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, px), rowE2), zero));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				const __m128 z = _mm_add_ps(_mm_mul_ps(zA, px), rowZ);
+				const __m128 depth = _mm_loadu_ps(depthRow + x);
+				const __m128 nearest = _mm_min_ps(depth, z);
+				_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, depth)));
+			}
+		}
+#else
+		for (int y = minY; y <= maxY; y++)
+		{
+			const float py = (float)y + 0.5f;
+			float* depthRow = &m_Depth[y * WIDTH];
+			for (int x = minX; x <= maxX; x++)
+			{
+				const float px = (float)x + 0.5f;
+				glm::vec3 edges = triangle.edgeA * px + triangle.edgeB * py + triangle.edgeC;
+				if (edges.x < 0.0f || edges.y < 0.0f || edges.z < 0.0f)
+				{
+					continue;
+				}
+				depthRow[x] = std::min(depthRow[x], triangle.zA * px + triangle.zB * py + triangle.zC);
+			}
+		}
+#endif
+	}
+}
+
+void OcclusionCuller::BuildHiZ(uint32_t tileIndex)
+{
+	const uint32_t blockMinX = ((tileIndex % TILES_X) * TILE_WIDTH) / HIZ_BLOCK_SIZE;
+	const uint32_t blockMinY = ((tileIndex / TILES_X) * TILE_HEIGHT) / HIZ_BLOCK_SIZE;
+
+	for (uint32_t by = blockMinY; by < blockMinY + TILE_HEIGHT / HIZ_BLOCK_SIZE; by++)
+	{
+		for (uint32_t bx = blockMinX; bx < blockMinX + TILE_WIDTH / HIZ_BLOCK_SIZE; bx++)
+		{
+			float farthest = 0.0f;
+			for (uint32_t y = by * HIZ_BLOCK_SIZE; y < (by + 1) * HIZ_BLOCK_SIZE; y++)
+			{
+				const float* depthRow = &m_Depth[y * WIDTH + bx * HIZ_BLOCK_SIZE];
+				farthest = std::max(farthest, *std::max_element(depthRow, depthRow + HIZ_BLOCK_SIZE));
+			}
+			m_HiZ[by * HIZ_WIDTH + bx] = farthest;
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const glm::mat4& modelMatrix, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	const glm::mat4 mvp = m_ViewProjection * modelMatrix;
+
+	float minXf = (float)WIDTH, minYf = (float)HEIGHT, minZ = 1.0f;
+	float maxXf = 0.0f, maxYf = 0.0f;
+	for (uint32_t corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 position(
+			(corner & 1) ? boundsMax.x : boundsMin.x,
+			(corner & 2) ? boundsMax.y : boundsMin.y,
+			(corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = mvp * glm::vec4(position, 1.0f);
+
+		// Box crosses the near plane, camera is (nearly) inside it
+		if (clip.w <= 1e-5f || clip.z < 0.0f)
+		{
+			return true;
+		}
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		float x = (ndc.x * 0.5f + 0.5f) * WIDTH;
+		float y = (ndc.y * 0.5f + 0.5f) * HEIGHT;
+		minXf = std::min(minXf, x);
+		maxXf = std::max(maxXf, x);
+		minYf = std::min(minYf, y);
+		maxYf = std::max(maxYf, y);
+		minZ = std::min(minZ, ndc.z);
+	}
+
+	// Outside the view or past the far plane
+	if (maxXf < 0.0f || maxYf < 0.0f || minXf >= WIDTH || minYf >= HEIGHT || minZ >= 1.0f)
+	{
+		return false;
+	}
+
+	const int minX = std::max(0, (int)std::floor(minXf));
+	const int minY = std::max(0, (int)std::floor(minYf));
+	const int maxX = std::min((int)WIDTH - 1, (int)std::ceil(maxXf));
+	const int maxY = std::min((int)HEIGHT - 1, (int)std::ceil(maxYf));
+
+	for (int by = minY / (int)HIZ_BLOCK_SIZE; by <= maxY / (int)HIZ_BLOCK_SIZE; by++)
+	{
+		for (int bx = minX / (int)HIZ_BLOCK_SIZE; bx <= maxX / (int)HIZ_BLOCK_SIZE; bx++)
+		{
+			// Whole block is covered by nearer occluders
+			if (m_HiZ[by * HIZ_WIDTH + bx] < minZ)
+			{
+				continue;
+			}
+
+			const int blockMinX = std::max(minX, bx * (int)HIZ_BLOCK_SIZE);
+			const int blockMaxX = std::min(maxX, (bx + 1) * (int)HIZ_BLOCK_SIZE - 1);
+			const int blockMinY = std::max(minY, by * (int)HIZ_BLOCK_SIZE);
+			const int blockMaxY = std::min(maxY, (by + 1) * (int)HIZ_BLOCK_SIZE - 1);
+			for (int y = blockMinY; y <= blockMaxY; y++)
+			{
+				for (int x = blockMinX; x <= blockMaxX; x++)
+				{
+					if (m_Depth[y * WIDTH + x] >= minZ)
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+
+	return false;
+}
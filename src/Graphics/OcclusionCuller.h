@@ -0,0 +1,78 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Low resolution CPU depth rasterizer for occlusion culling.
+// Occluder triangles are binned into screen tiles, tiles are rasterized in parallel (4 pixels per SSE op),
+// then a hierarchical depth buffer (max depth per block) is built for fast AABB rejection.
+// No Vulkan dependency, results are deterministic for a given input.
+class OcclusionCuller
+{
+public:
+	static constexpr uint32_t WIDTH = 320;
+	static constexpr uint32_t HEIGHT = 192;
+	static constexpr uint32_t TILE_WIDTH = 64;
+	static constexpr uint32_t TILE_HEIGHT = 32;
+	static constexpr uint32_t TILES_X = WIDTH / TILE_WIDTH;
+	static constexpr uint32_t TILES_Y = HEIGHT / TILE_HEIGHT;
+	static constexpr uint32_t HIZ_BLOCK_SIZE = 8;
+	static constexpr uint32_t HIZ_WIDTH = WIDTH / HIZ_BLOCK_SIZE;
+	static constexpr uint32_t HIZ_HEIGHT = HEIGHT / HIZ_BLOCK_SIZE;
+
+	OcclusionCuller();
+
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+	// Clears the depth buffer and drops last frame's occluders
+	void BeginFrame(const glm::mat4& viewProjection);
+
+	// Positions are read with a byte stride so interleaved vertex data can be passed directly.
+	// indices[i] + baseVertex addresses the position array.
+	void AddOccluder(
+		const glm::mat4& modelMatrix,
+		const void* positions,
+		size_t positionStride,
+		const uint32_t* indices,
+		uint32_t indexCount,
+		uint32_t baseVertex = 0);
+
+	// Rasterizes every occluder added this frame and builds the hierarchical depth buffer
+	void Rasterize();
+
+	// False when the box is fully behind occluders or fully outside the view
+	bool IsVisible(const glm::mat4& modelMatrix, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+	const std::vector<float>& GetDepthBuffer() const { return m_Depth; }
+	uint32_t GetOccluderTriangleCount() const { return static_cast<uint32_t>(m_Triangles.size()); }
+
+private:
+	struct ScreenTriangle
+	{
+		// Edge functions E(x, y) = A * x + B * y + C, positive inside
+		glm::vec3 edgeA;
+		glm::vec3 edgeB;
+		glm::vec3 edgeC;
+
+		// Depth plane z(x, y) = zA * x + zB * y + zC
+		float zA, zB, zC;
+
+		int minX, minY, maxX, maxY;
+	};
+
+	void RasterizeTile(uint32_t tileIndex);
+	void BuildHiZ(uint32_t tileIndex);
+
+	glm::mat4 m_ViewProjection{ 1.0f };
+
+	std::vector<ScreenTriangle> m_Triangles;
+	std::vector<std::vector<uint32_t>> m_TileBins;
+
+	std::vector<float> m_Depth;		// Nearest occluder depth per pixel, 1.0 = nothing
+	std::vector<float> m_HiZ;		// Farthest value of m_Depth per block
+};
@@ -1,9 +1,71 @@
 #include "Pipeline.h"
+#include "RenderStats.h"
+#include "PipelineCache.h"
 #include "../Model.h"
+#include "../Instrumentation.h"
 
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <cassert>
+#include <cstring>
+
+SpecializationConstants& SpecializationConstants::Set(uint32_t constantID, int32_t value)
+{
+    SetData(constantID, &value, sizeof(value));
+    return *this;
+}
+
+SpecializationConstants& SpecializationConstants::Set(uint32_t constantID, uint32_t value)
+{
+    SetData(constantID, &value, sizeof(value));
+    return *this;
+}
+
+SpecializationConstants& SpecializationConstants::Set(uint32_t constantID, float value)
+{
+    SetData(constantID, &value, sizeof(value));
+    return *this;
+}
+
+SpecializationConstants& SpecializationConstants::Set(uint32_t constantID, bool value)
+{
+    VkBool32 boolValue = value ? VK_TRUE : VK_FALSE;
+    SetData(constantID, &boolValue, sizeof(boolValue));
+    return *this;
+}
+
+VkSpecializationInfo SpecializationConstants::GetInfo() const
+{
+    VkSpecializationInfo info{};
+    info.mapEntryCount = static_cast<uint32_t>(m_Entries.size());
+    info.pMapEntries = m_Entries.data();
+    info.dataSize = m_Data.size();
+    info.pData = m_Data.data();
+    return info;
+}
+
+void SpecializationConstants::SetData(uint32_t constantID, const void* data, size_t size)
+{
+    for (auto& entry : m_Entries)
+    {
+        if (entry.constantID == constantID)
+        {
+            assert(entry.size == size && "SpecializationConstants : constant set again with a different size");
+            std::memcpy(m_Data.data() + entry.offset, data, size);
+            return;
+        }
+    }
+
+    VkSpecializationMapEntry entry{};
+    entry.constantID = constantID;
+    entry.offset = static_cast<uint32_t>(m_Data.size());
+    entry.size = size;
+    m_Entries.push_back(entry);
+
+    m_Data.resize(m_Data.size() + size);
+    std::memcpy(m_Data.data() + entry.offset, data, size);
+}
 
 Pipeline::Pipeline(
     Device& device, 
@@ -24,6 +86,9 @@ Pipeline::Pipeline(
     CreateShaderModule(vertCode, &m_VertexShaderModule);
     CreateShaderModule(fragCode, &m_FragmentShaderModule);
 
+    VkSpecializationInfo vertexSpecializationInfo = configInfo.vertexSpecialization.GetInfo();
+    VkSpecializationInfo fragmentSpecializationInfo = configInfo.fragmentSpecialization.GetInfo();
+
     VkPipelineShaderStageCreateInfo shaderStage[2];
     shaderStage[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStage[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -31,7 +96,7 @@ Pipeline::Pipeline(
     shaderStage[0].pName = "main";
     shaderStage[0].flags = 0;
     shaderStage[0].pNext = nullptr;
-    shaderStage[0].pSpecializationInfo = nullptr;
+    shaderStage[0].pSpecializationInfo = configInfo.vertexSpecialization.IsEmpty() ? nullptr : &vertexSpecializationInfo;
 
     shaderStage[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStage[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -39,7 +104,7 @@ Pipeline::Pipeline(
     shaderStage[1].pName = "main";
     shaderStage[1].flags = 0;
     shaderStage[1].pNext = nullptr;
-    shaderStage[1].pSpecializationInfo = nullptr;
+    shaderStage[1].pSpecializationInfo = configInfo.fragmentSpecialization.IsEmpty() ? nullptr : &fragmentSpecializationInfo;
 
     auto& bindingDescriptions = configInfo.bindingDescription;
     auto& attributeDescriptions = configInfo.attributeDescription;
@@ -73,10 +138,16 @@ Pipeline::Pipeline(
     pipelineInfo.basePipelineIndex = -1;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_GraphicsPipeline) != VK_SUCCESS)
+    PipelineCache& pipelineCache = device.getPipelineCache();
+    auto createStart = std::chrono::high_resolution_clock::now();
     {
-        throw std::runtime_error("Failed to create graphics pipeline");
+        PROFILE_SCOPE("vkCreateGraphicsPipelines");
+        if (vkCreateGraphicsPipelines(device.device(), pipelineCache.GetHandle(), 1, &pipelineInfo, nullptr, &m_GraphicsPipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create graphics pipeline");
+        }
     }
+    pipelineCache.RecordPipelineCreation(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - createStart).count());
 }
 
 Pipeline::~Pipeline()
@@ -89,7 +160,7 @@ Pipeline::~Pipeline()
 
 void Pipeline::bind(VkCommandBuffer commandBuffer)
 {
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
+    CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
 }
 
 void Pipeline::DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
@@ -167,8 +238,8 @@ void Pipeline::DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
     configInfo.dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
     configInfo.dynamicStateCreateInfo.flags = 0;
 
-    configInfo.bindingDescription = Model::Vertex::getBindingDescriptions();
-    configInfo.attributeDescription = Model::Vertex::getAttributeDescriptions();
+    configInfo.bindingDescription = Model::PackedVertex::getBindingDescriptions();
+    configInfo.attributeDescription = Model::PackedVertex::getAttributeDescriptions();
 }
 
 std::vector<char> Pipeline::ReadFile(const std::string& filePath)
@@ -217,3 +288,53 @@ void Pipeline::EnableAlphaBlending(PipelineConfigInfo& configInfo)
     configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
     configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 }
+
+void Pipeline::EnableDepthOnly(PipelineConfigInfo& configInfo)
+{
+    // Color attachment stays bound (render pass compatibility) but nothing is written to it
+    configInfo.colorBlendAttachment.blendEnable = VK_FALSE;
+    configInfo.colorBlendAttachment.colorWriteMask = 0;
+
+    EnablePositionOnly(configInfo);
+}
+
+void Pipeline::EnablePositionOnly(PipelineConfigInfo& configInfo)
+{
+    // Only the position stream is bound and fetched, see GeometryArena::Bind
+    configInfo.bindingDescription = Model::PackedVertex::getPositionBindingDescriptions();
+    configInfo.attributeDescription = Model::PackedVertex::getPositionAttributeDescriptions();
+}
+
+void Pipeline::CopyPipelineConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst)
+{
+    dst.bindingDescription = src.bindingDescription;
+    dst.attributeDescription = src.attributeDescription;
+    dst.inputAssemblyInfo = src.inputAssemblyInfo;
+    dst.viewportInfo = src.viewportInfo;
+    dst.rasterizationInfo = src.rasterizationInfo;
+    dst.multisampleInfo = src.multisampleInfo;
+    dst.colorBlendAttachment = src.colorBlendAttachment;
+    dst.colorBlendInfo = src.colorBlendInfo;
+    dst.depthStencilInfo = src.depthStencilInfo;
+    dst.dynamicStateEnables = src.dynamicStateEnables;
+    dst.dynamicStateCreateInfo = src.dynamicStateCreateInfo;
+    dst.pipelineLayout = src.pipelineLayout;
+    dst.renderPass = src.renderPass;
+    dst.subpass = src.subpass;
+    dst.vertexSpecialization = src.vertexSpecialization;
+    dst.fragmentSpecialization = src.fragmentSpecialization;
+
+    // Blend attachments either live in the config itself or in an array owned by the caller (G-buffer)
+    if (src.colorBlendInfo.attachmentCount == 0 || src.colorBlendInfo.pAttachments == &src.colorBlendAttachment)
+    {
+        dst.colorBlendInfo.pAttachments = &dst.colorBlendAttachment;
+    }
+    else
+    {
+        dst.colorBlendAttachments.assign(src.colorBlendInfo.pAttachments, src.colorBlendInfo.pAttachments + src.colorBlendInfo.attachmentCount);
+        dst.colorBlendInfo.pAttachments = dst.colorBlendAttachments.data();
+    }
+
+    dst.dynamicStateCreateInfo.pDynamicStates = dst.dynamicStateEnables.data();
+    dst.dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dst.dynamicStateEnables.size());
+}
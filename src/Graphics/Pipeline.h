@@ -5,6 +5,27 @@
 #include <string>
 #include <vector>
 
+// Values for a shader's layout(constant_id = N) constants. They are baked in when the pipeline is
+// created, so the driver can unroll the loops they bound and strip the branches they disable.
+class SpecializationConstants
+{
+public:
+	SpecializationConstants& Set(uint32_t constantID, int32_t value);
+	SpecializationConstants& Set(uint32_t constantID, uint32_t value);
+	SpecializationConstants& Set(uint32_t constantID, float value);
+	SpecializationConstants& Set(uint32_t constantID, bool value);	// GLSL bool constants are 32 bit
+
+	bool IsEmpty() const { return m_Entries.empty(); }
+	// Points into this object, valid until it is modified or destroyed
+	VkSpecializationInfo GetInfo() const;
+
+private:
+	void SetData(uint32_t constantID, const void* data, size_t size);
+
+	std::vector<VkSpecializationMapEntry> m_Entries;
+	std::vector<uint8_t> m_Data;
+};
+
 struct PipelineConfigInfo
 {
 	struct PipelineConfigInfo(const PipelineConfigInfo&) = delete;
@@ -18,6 +39,7 @@ struct PipelineConfigInfo
 	VkPipelineRasterizationStateCreateInfo rasterizationInfo;
 	VkPipelineMultisampleStateCreateInfo multisampleInfo;
 	VkPipelineColorBlendAttachmentState colorBlendAttachment;
+	std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments{};	// Storage for copies with more than one attachment
 	VkPipelineColorBlendStateCreateInfo colorBlendInfo;
 	VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
 	std::vector<VkDynamicState> dynamicStateEnables;
@@ -25,6 +47,8 @@ struct PipelineConfigInfo
 	VkPipelineLayout pipelineLayout = nullptr;
 	VkRenderPass renderPass = nullptr;
 	uint32_t subpass = 0;
+	SpecializationConstants vertexSpecialization{};
+	SpecializationConstants fragmentSpecialization{};
 };
 
 class Pipeline
@@ -44,6 +68,10 @@ public:
 	void bind(VkCommandBuffer commandBuffer);
 	static void DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 	static void EnableAlphaBlending(PipelineConfigInfo& configInfo);
+	static void EnableDepthOnly(PipelineConfigInfo& configInfo);
+	static void EnablePositionOnly(PipelineConfigInfo& configInfo);
+	// Deep copy, dst's internal pointers are redirected to its own storage
+	static void CopyPipelineConfigInfo(const PipelineConfigInfo& src, PipelineConfigInfo& dst);
 
 private:
 	
@@ -0,0 +1,204 @@
+#include "PipelineCache.h"
+#include "../Instrumentation.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+PipelineCache::PipelineCache(Device& device, const std::string& filePath)
+	: m_Device(device), m_FilePath(filePath)
+{
+	PROFILE_FUNCTION();
+
+	m_Properties = m_Device.GetPhysicalDeviceProperties();
+
+	std::vector<char> initialData = Load();
+	m_Warm = !initialData.empty();
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = initialData.size();
+	cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+	if (vkCreatePipelineCache(m_Device.device(), &cacheInfo, nullptr, &m_PipelineCache) != VK_SUCCESS)
+	{
+		// The driver may still reject data that passed our checks, start empty rather than fail
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = nullptr;
+		m_Warm = false;
+
+		if (vkCreatePipelineCache(m_Device.device(), &cacheInfo, nullptr, &m_PipelineCache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline cache!");
+		}
+	}
+
+	std::cout << "Pipeline cache : " << (m_Warm ? "warm start, " : "cold start, ") << initialData.size() << " bytes loaded" << std::endl;
+}
+
+PipelineCache::~PipelineCache()
+{
+	Save();
+	vkDestroyPipelineCache(m_Device.device(), m_PipelineCache, nullptr);
+}
+
+void PipelineCache::Save()
+{
+	PROFILE_FUNCTION();
+
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(m_Device.device(), m_PipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+	{
+		return;
+	}
+
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(m_Device.device(), m_PipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+	{
+		return;
+	}
+	data.resize(dataSize);
+
+	FileHeader header = MakeHeader(data);
+
+	// Write next to the old file and swap, a crash mid write must not leave a truncated cache behind
+	std::string tempPath = m_FilePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "Pipeline cache : failed to open " << tempPath << " for writing" << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		if (!file.good())
+		{
+			std::cerr << "Pipeline cache : failed to write " << tempPath << std::endl;
+			return;
+		}
+	}
+	std::remove(m_FilePath.c_str());
+	std::rename(tempPath.c_str(), m_FilePath.c_str());
+
+	std::cout << "Pipeline cache : " << (m_Warm ? "warm" : "cold") << " start created " << GetPipelineCount() << " pipelines in "
+		<< GetPipelineCreationTime() << " ms, saved " << data.size() << " bytes" << std::endl;
+}
+
+void PipelineCache::RecordPipelineCreation(double milliseconds)
+{
+	std::lock_guard<std::mutex> lock(m_StatsMutex);
+	m_PipelineCount++;
+	m_PipelineCreationTime += milliseconds;
+}
+
+uint32_t PipelineCache::GetPipelineCount() const
+{
+	std::lock_guard<std::mutex> lock(m_StatsMutex);
+	return m_PipelineCount;
+}
+
+double PipelineCache::GetPipelineCreationTime() const
+{
+	std::lock_guard<std::mutex> lock(m_StatsMutex);
+	return m_PipelineCreationTime;
+}
+
+std::vector<char> PipelineCache::Load()
+{
+	std::ifstream file(m_FilePath, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		return {};
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	if (fileSize < sizeof(FileHeader))
+	{
+		return {};
+	}
+
+	FileHeader header{};
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (header.dataSize != fileSize - sizeof(FileHeader))
+	{
+		std::cout << "Pipeline cache : size mismatch, discarding " << m_FilePath << std::endl;
+		return {};
+	}
+
+	std::vector<char> data(header.dataSize);
+	file.read(data.data(), data.size());
+	if (!file.good() || !IsCompatible(header, data))
+	{
+		std::cout << "Pipeline cache : stale or corrupt, discarding " << m_FilePath << std::endl;
+		return {};
+	}
+
+	return data;
+}
+
+bool PipelineCache::IsCompatible(const FileHeader& header, const std::vector<char>& data) const
+{
+	if (header.magic != FILE_MAGIC || header.version != FILE_VERSION ||
+		header.vendorID != m_Properties.vendorID ||
+		header.deviceID != m_Properties.deviceID ||
+		header.driverVersion != m_Properties.driverVersion ||
+		std::memcmp(header.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+		header.checksum != Checksum(data))
+	{
+		return false;
+	}
+
+	// The driver's own header leads the blob, check it agrees too
+	struct VulkanCacheHeader
+	{
+		uint32_t headerSize;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	VulkanCacheHeader vulkanHeader{};
+	if (data.size() < sizeof(vulkanHeader))
+	{
+		return false;
+	}
+	std::memcpy(&vulkanHeader, data.data(), sizeof(vulkanHeader));
+
+	return vulkanHeader.headerSize >= sizeof(vulkanHeader) &&
+		vulkanHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		vulkanHeader.vendorID == m_Properties.vendorID &&
+		vulkanHeader.deviceID == m_Properties.deviceID &&
+		std::memcmp(vulkanHeader.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+PipelineCache::FileHeader PipelineCache::MakeHeader(const std::vector<char>& data) const
+{
+	FileHeader header{};
+	header.magic = FILE_MAGIC;
+	header.version = FILE_VERSION;
+	header.vendorID = m_Properties.vendorID;
+	header.deviceID = m_Properties.deviceID;
+	header.driverVersion = m_Properties.driverVersion;
+	std::memcpy(header.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.checksum = Checksum(data);
+	return header;
+}
+
+// FNV-1a
+uint64_t PipelineCache::Checksum(const std::vector<char>& data)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : data)
+	{
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Device.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// VkPipelineCache persisted between runs. The blob on disk carries its own header (driver version,
+// vendor, device, cache UUID, size and checksum) and is dropped when any of it doesn't match the
+// current device, so a driver update simply means one cold start.
+// Data is written back on destruction, it already contains whatever was loaded plus every pipeline created since.
+class PipelineCache
+{
+public:
+	PipelineCache(Device& device, const std::string& filePath = "pipeline_cache.bin");
+	~PipelineCache();
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	VkPipelineCache GetHandle() const { return m_PipelineCache; }
+
+	// True when a valid blob from a previous run seeded the cache
+	bool IsWarm() const { return m_Warm; }
+
+	void Save();
+
+	// Pipeline creation time, reported with the cache state on Save. Pipelines are built from
+	// several threads, so the time is summed over all of them rather than wall clock
+	void RecordPipelineCreation(double milliseconds);
+	uint32_t GetPipelineCount() const;
+	double GetPipelineCreationTime() const;
+
+private:
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t checksum;
+	};
+
+	static constexpr uint32_t FILE_MAGIC = 0x43505650;	// "PVPC"
+	static constexpr uint32_t FILE_VERSION = 1;
+
+	// Returns the Vulkan cache data if the file exists and matches this device
+	std::vector<char> Load();
+	bool IsCompatible(const FileHeader& header, const std::vector<char>& data) const;
+	FileHeader MakeHeader(const std::vector<char>& data) const;
+
+	static uint64_t Checksum(const std::vector<char>& data);
+
+	Device& m_Device;
+	std::string m_FilePath;
+	VkPhysicalDeviceProperties m_Properties;
+
+	VkPipelineCache m_PipelineCache = VK_NULL_HANDLE;
+	bool m_Warm = false;
+
+	mutable std::mutex m_StatsMutex;
+	uint32_t m_PipelineCount = 0;
+	double m_PipelineCreationTime = 0.0;
+};
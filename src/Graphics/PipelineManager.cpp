@@ -0,0 +1,427 @@
+#include "PipelineManager.h"
+#include "../Instrumentation.h"
+
+#include <shaderc/shaderc.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace
+{
+	// Resolves #include "file" next to the including source, like glslc does for CompileShaders.bat
+	class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface
+	{
+	public:
+		shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override
+		{
+			auto include = new Include;
+			std::filesystem::path path = std::filesystem::path(requestingSource).parent_path() / requestedSource;
+			std::ifstream file(path, std::ios::binary);
+			if (file.is_open())
+			{
+				include->name = path.generic_string();
+				include->content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+			else
+			{
+				// An empty name tells shaderc the include failed, the content is the error
+				include->content = "Failed to open file path: " + path.generic_string();
+			}
+			include->result = { include->name.data(), include->name.size(), include->content.data(), include->content.size(), include };
+			return &include->result;
+		}
+
+		void ReleaseInclude(shaderc_include_result* data) override
+		{
+			delete static_cast<Include*>(data->user_data);
+		}
+
+	private:
+		struct Include
+		{
+			std::string name;
+			std::string content;
+			shaderc_include_result result;
+		};
+	};
+
+	// Every file sourcePath pulls in through #include "file", nested ones included
+	void CollectIncludes(const std::filesystem::path& sourcePath, std::vector<std::string>& includePaths)
+	{
+		std::ifstream file(sourcePath);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			size_t directive = line.find_first_not_of(" \t");
+			if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+			{
+				continue;
+			}
+			size_t open = line.find('"', directive);
+			size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+			if (close == std::string::npos)
+			{
+				continue;
+			}
+
+			std::string includePath = (sourcePath.parent_path() / line.substr(open + 1, close - open - 1)).generic_string();
+			if (std::find(includePaths.begin(), includePaths.end(), includePath) == includePaths.end())
+			{
+				includePaths.push_back(includePath);
+				CollectIncludes(includePath, includePaths);
+			}
+		}
+	}
+
+	std::filesystem::file_time_type NewestWriteTime(const std::string& sourcePath, const std::vector<std::string>& includePaths, std::error_code& error)
+	{
+		auto newest = std::filesystem::last_write_time(sourcePath, error);
+		for (const std::string& includePath : includePaths)
+		{
+			std::error_code includeError;
+			auto lastWrite = std::filesystem::last_write_time(includePath, includeError);
+			if (!includeError && lastWrite > newest)
+			{
+				newest = lastWrite;
+			}
+		}
+		return newest;
+	}
+}
+
+bool AsyncPipeline::bind(VkCommandBuffer commandBuffer)
+{
+	if (!m_Pipeline)
+	{
+		return false;
+	}
+
+	m_Pipeline->bind(commandBuffer);
+	return true;
+}
+
+PipelineManager::PipelineManager(Device& device, uint32_t workerCount) : m_Device(device)
+{
+	if (workerCount == 0)
+	{
+		// Leave one hardware thread to the render loop
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		m_Workers.emplace_back(&PipelineManager::WorkerLoop, this);
+	}
+}
+
+PipelineManager::~PipelineManager()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_JobMutex);
+		m_Stopping = true;
+		m_Jobs = {};
+	}
+	m_JobAvailable.notify_all();
+
+	for (auto& worker : m_Workers)
+	{
+		worker.join();
+	}
+
+	// Replaced pipelines are owned by the graphics timeline until the frames using them finished
+	m_Completed.clear();
+}
+
+std::shared_ptr<AsyncPipeline> PipelineManager::Request(const std::string& vertexPath, const std::string& fragPath, const PipelineConfigInfo& configInfo)
+{
+	assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "PipelineManager : pipelineLayout not provided in configInfo");
+	assert(configInfo.renderPass != VK_NULL_HANDLE && "PipelineManager : renderPass not provided in configInfo");
+
+	std::shared_ptr<AsyncPipeline> pipeline(new AsyncPipeline());
+	pipeline->m_VertexPath = vertexPath;
+	pipeline->m_FragPath = fragPath;
+	Pipeline::CopyPipelineConfigInfo(configInfo, pipeline->m_ConfigInfo);
+
+	m_Pipelines.push_back(pipeline);
+	WatchShader(vertexPath);
+	WatchShader(fragPath);
+
+	QueueBuild(pipeline);
+	return pipeline;
+}
+
+void PipelineManager::Update()
+{
+	PROFILE_FUNCTION();
+
+	PublishCompleted();
+
+	auto now = std::chrono::steady_clock::now();
+	if (m_HotReloadEnabled && now - m_LastPoll >= m_PollInterval)
+	{
+		m_LastPoll = now;
+		PollShaders();
+	}
+}
+
+void PipelineManager::WaitIdle()
+{
+	PROFILE_FUNCTION();
+	{
+		std::unique_lock<std::mutex> lock(m_JobMutex);
+		m_JobsDone.wait(lock, [this]() { return m_Jobs.empty() && m_ActiveJobs == 0; });
+	}
+
+	PublishCompleted();
+}
+
+uint32_t PipelineManager::GetPendingBuildCount() const
+{
+	std::lock_guard<std::mutex> lock(m_JobMutex);
+	return static_cast<uint32_t>(m_Jobs.size()) + m_ActiveJobs;
+}
+
+void PipelineManager::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_JobMutex);
+			m_JobAvailable.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+			if (m_Stopping)
+			{
+				return;
+			}
+
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop();
+			m_ActiveJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_JobMutex);
+			m_ActiveJobs--;
+			if (m_Jobs.empty() && m_ActiveJobs == 0)
+			{
+				m_JobsDone.notify_all();
+			}
+		}
+	}
+}
+
+void PipelineManager::Enqueue(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_JobMutex);
+		m_Jobs.push(std::move(job));
+	}
+	m_JobAvailable.notify_one();
+}
+
+void PipelineManager::QueueBuild(const std::shared_ptr<AsyncPipeline>& target)
+{
+	// Paths and config never change after Request, only m_Pipeline does and that is render thread only
+	Enqueue([this, target]()
+	{
+		PROFILE_SCOPE("PipelineManager::Build");
+		try
+		{
+			auto pipeline = std::make_unique<Pipeline>(m_Device, target->m_VertexPath, target->m_FragPath, target->m_ConfigInfo);
+
+			std::lock_guard<std::mutex> lock(m_CompletedMutex);
+			m_Completed.push_back({ target, std::move(pipeline) });
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "PipelineManager : failed to build " << target->m_VertexPath << " / " << target->m_FragPath << " : " << e.what() << std::endl;
+		}
+	});
+}
+
+void PipelineManager::PublishCompleted()
+{
+	std::vector<CompletedBuild> completed;
+	{
+		std::lock_guard<std::mutex> lock(m_CompletedMutex);
+		completed.swap(m_Completed);
+	}
+
+	for (auto& build : completed)
+	{
+		auto target = build.target.lock();
+		if (!target)
+		{
+			continue;
+		}
+
+		if (target->m_Pipeline)
+		{
+			// Frames already submitted may still bind it
+			std::shared_ptr<Pipeline> retired = std::move(target->m_Pipeline);
+			m_Device.getGraphicsTimeline().DeferDestroy([retired]() mutable { retired.reset(); });
+		}
+		target->m_Pipeline = std::move(build.pipeline);
+	}
+}
+
+void PipelineManager::WatchShader(const std::string& spirvPath)
+{
+	const std::string extension = ".spv";
+	if (spirvPath.size() <= extension.size() || spirvPath.compare(spirvPath.size() - extension.size(), extension.size(), extension) != 0)
+	{
+		return;
+	}
+
+	std::string sourcePath = spirvPath.substr(0, spirvPath.size() - extension.size());
+	if (m_WatchedShaders.count(sourcePath))
+	{
+		return;
+	}
+
+	std::vector<std::string> includePaths;
+	CollectIncludes(sourcePath, includePaths);
+
+	std::error_code error;
+	auto lastWrite = NewestWriteTime(sourcePath, includePaths, error);
+	if (error)
+	{
+		// Shipped without sources, nothing to reload from
+		return;
+	}
+
+	m_WatchedShaders[sourcePath] = { spirvPath, std::move(includePaths), lastWrite };
+}
+
+void PipelineManager::PollShaders()
+{
+	PROFILE_FUNCTION();
+
+	m_Pipelines.erase(
+		std::remove_if(m_Pipelines.begin(), m_Pipelines.end(), [](const std::weak_ptr<AsyncPipeline>& pipeline) { return pipeline.expired(); }),
+		m_Pipelines.end());
+
+	for (auto& [sourcePath, watched] : m_WatchedShaders)
+	{
+		std::error_code error;
+		auto lastWrite = NewestWriteTime(sourcePath, watched.includePaths, error);
+		if (error || lastWrite == watched.lastWrite)
+		{
+			continue;
+		}
+		watched.lastWrite = lastWrite;
+
+		// The edit may have added or removed includes
+		watched.includePaths.clear();
+		CollectIncludes(sourcePath, watched.includePaths);
+
+		std::vector<std::shared_ptr<AsyncPipeline>> users;
+		for (auto& weakPipeline : m_Pipelines)
+		{
+			auto pipeline = weakPipeline.lock();
+			if (pipeline && (pipeline->m_VertexPath == watched.spirvPath || pipeline->m_FragPath == watched.spirvPath))
+			{
+				users.push_back(pipeline);
+			}
+		}
+
+		if (!users.empty())
+		{
+			Enqueue([this, sourcePath = sourcePath, spirvPath = watched.spirvPath, users]() { ReloadShader(sourcePath, spirvPath, users); });
+		}
+	}
+}
+
+void PipelineManager::ReloadShader(const std::string& sourcePath, const std::string& spirvPath, const std::vector<std::shared_ptr<AsyncPipeline>>& users)
+{
+	PROFILE_FUNCTION();
+
+	std::vector<uint32_t> spirv;
+	std::string errors;
+	if (!CompileShader(sourcePath, spirv, errors))
+	{
+		// Editors can save in several writes, the next change retries
+		std::cerr << "Shader hot reload : " << sourcePath << " failed to compile, keeping the current pipelines\n" << errors << std::endl;
+		return;
+	}
+
+	// Written aside then renamed, builds reading the old .spv on other workers never see a partial file
+	const std::string tempPath = spirvPath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "Shader hot reload : failed to write " << tempPath << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, spirvPath, error);
+	if (error)
+	{
+		std::filesystem::remove(spirvPath, error);
+		std::filesystem::rename(tempPath, spirvPath, error);
+		if (error)
+		{
+			std::cerr << "Shader hot reload : failed to replace " << spirvPath << " : " << error.message() << std::endl;
+			return;
+		}
+	}
+
+	std::cout << "Shader hot reload : " << sourcePath << " recompiled, rebuilding " << users.size() << " pipelines" << std::endl;
+
+	for (auto& user : users)
+	{
+		QueueBuild(user);
+	}
+}
+
+bool PipelineManager::CompileShader(const std::string& sourcePath, std::vector<uint32_t>& spirv, std::string& errors)
+{
+	std::ifstream file(sourcePath, std::ios::binary);
+	if (!file.is_open())
+	{
+		errors = "Failed to open file path: " + sourcePath;
+		return false;
+	}
+	std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	shaderc_shader_kind kind;
+	std::string extension = std::filesystem::path(sourcePath).extension().string();
+	if (extension == ".vert")
+	{
+		kind = shaderc_vertex_shader;
+	}
+	else if (extension == ".frag")
+	{
+		kind = shaderc_fragment_shader;
+	}
+	else
+	{
+		errors = "Unknown shader stage for " + sourcePath;
+		return false;
+	}
+
+	// Same defaults as glslc in CompileShaders.bat, so a reloaded shader matches a rebuilt one
+	shaderc::Compiler compiler;
+	shaderc::CompileOptions options;
+	options.SetIncluder(std::make_unique<ShaderIncluder>());
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, kind, sourcePath.c_str(), options);
+
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		errors = result.GetErrorMessage();
+		return false;
+	}
+
+	spirv.assign(result.cbegin(), result.cend());
+	return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Device.h"
+#include "Pipeline.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Pipeline built in the background by PipelineManager. Empty until its first build completes,
+// after that a hot reload only replaces it at a frame boundary (PipelineManager::Update).
+class AsyncPipeline
+{
+public:
+	AsyncPipeline(const AsyncPipeline&) = delete;
+	AsyncPipeline& operator=(const AsyncPipeline&) = delete;
+
+	bool IsReady() const { return m_Pipeline != nullptr; }
+
+	// Records nothing and returns false while the pipeline is still being built
+	bool bind(VkCommandBuffer commandBuffer);
+
+private:
+	friend class PipelineManager;
+	AsyncPipeline() = default;
+
+	std::string m_VertexPath;
+	std::string m_FragPath;
+	PipelineConfigInfo m_ConfigInfo;	// Kept for rebuilds
+	std::unique_ptr<Pipeline> m_Pipeline;
+};
+
+// Worker threads that create pipelines in parallel (through the device's pipeline cache), and a
+// shader watcher : when a GLSL source next to a .spv (or a file it includes) is edited it is recompiled with shaderc,
+// the .spv is rewritten and every pipeline using it is rebuilt. Finished builds are only
+// published by Update, a replaced pipeline is destroyed once no frame in flight can use it.
+class PipelineManager
+{
+public:
+	// workerCount 0 picks one less than the hardware threads
+	PipelineManager(Device& device, uint32_t workerCount = 0);
+	~PipelineManager();
+
+	PipelineManager(const PipelineManager&) = delete;
+	PipelineManager& operator=(const PipelineManager&) = delete;
+
+	// Copies configInfo and queues the build, the handle is usable (but not ready) right away
+	std::shared_ptr<AsyncPipeline> Request(const std::string& vertexPath, const std::string& fragPath, const PipelineConfigInfo& configInfo);
+
+	// Call once per frame after the frame slot wait, before recording
+	void Update();
+
+	// Blocks until every queued build is done and publishes them
+	void WaitIdle();
+
+	void SetHotReloadEnabled(bool enabled) { m_HotReloadEnabled = enabled; }
+	bool IsHotReloadEnabled() const { return m_HotReloadEnabled; }
+	uint32_t GetPendingBuildCount() const;
+
+private:
+	struct CompletedBuild
+	{
+		std::weak_ptr<AsyncPipeline> target;
+		std::unique_ptr<Pipeline> pipeline;
+	};
+
+	struct WatchedShader
+	{
+		std::string spirvPath;
+		std::vector<std::string> includePaths;		// #include'd sources, an edit to any of them recompiles too
+		std::filesystem::file_time_type lastWrite;	// Newest of the source and its includes
+	};
+
+	void WorkerLoop();
+	void Enqueue(std::function<void()> job);
+	void QueueBuild(const std::shared_ptr<AsyncPipeline>& target);
+	void PublishCompleted();
+
+	void WatchShader(const std::string& spirvPath);
+	void PollShaders();
+	// Compiles sourcePath to SPIR-V and rewrites spirvPath, then rebuilds every pipeline using it
+	void ReloadShader(const std::string& sourcePath, const std::string& spirvPath, const std::vector<std::shared_ptr<AsyncPipeline>>& users);
+
+	static bool CompileShader(const std::string& sourcePath, std::vector<uint32_t>& spirv, std::string& errors);
+
+	Device& m_Device;
+
+	std::vector<std::thread> m_Workers;
+	std::queue<std::function<void()>> m_Jobs;
+	mutable std::mutex m_JobMutex;
+	std::condition_variable m_JobAvailable;
+	std::condition_variable m_JobsDone;
+	uint32_t m_ActiveJobs = 0;
+	bool m_Stopping = false;
+
+	std::mutex m_CompletedMutex;
+	std::vector<CompletedBuild> m_Completed;
+
+	// Render thread only
+	std::vector<std::weak_ptr<AsyncPipeline>> m_Pipelines;
+	std::unordered_map<std::string, WatchedShader> m_WatchedShaders;	// GLSL source path -> watch state
+	bool m_HotReloadEnabled = true;
+	std::chrono::steady_clock::time_point m_LastPoll{};
+	const std::chrono::milliseconds m_PollInterval{ 500 };
+};
@@ -0,0 +1,144 @@
+#include "RenderStats.h"
+
+#include <cassert>
+#include <iomanip>
+
+namespace
+{
+	const char* const COUNTER_NAMES[RenderStats::COUNTER_COUNT] =
+	{
+		"Draws", "Instances", "Indices", "Triangles", "PipelineBinds", "DescriptorBinds", "PushConstantBytes", "RenderPasses"
+	};
+
+	// Same smoothing as the measured overdraw, roughly the last ten frames
+	constexpr double AVERAGE_WEIGHT = 0.1;
+}
+
+RenderStats::RenderStats()
+{
+	InitPass(m_Passes[0], "Unscoped");
+}
+
+RenderStats& RenderStats::Get()
+{
+	static RenderStats stats;
+	return stats;
+}
+
+void RenderStats::BeginFrame()
+{
+	for (uint32_t i = 0; i < m_PassCount; i++)
+	{
+		m_Passes[i].frame.fill(0);
+	}
+	m_PassDepth = 0;
+}
+
+void RenderStats::EndFrame()
+{
+	assert(m_PassDepth == 0 && "RenderStats : a pass is still open at the end of the frame");
+
+	m_FrameTotals.fill(0);
+	bool emit = Instrumentor::Get().IsCapturing() && m_FrameCount % EMIT_INTERVAL == 0;
+	for (uint32_t i = 0; i < m_PassCount; i++)
+	{
+		Pass& pass = m_Passes[i];
+		for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++)
+		{
+			double value = static_cast<double>(pass.frame[counter]);
+			pass.average[counter] = pass.averaged ? pass.average[counter] + (value - pass.average[counter]) * AVERAGE_WEIGHT : value;
+			m_FrameTotals[counter] += pass.frame[counter];
+
+			if (emit)
+			{
+				Instrumentor::Get().RecordCounter(pass.counterNameIDs[counter], pass.average[counter]);
+			}
+		}
+		pass.averaged = true;
+	}
+	m_FrameCount++;
+}
+
+uint32_t RenderStats::FindPass(const char* name)
+{
+	for (uint32_t i = 1; i < m_PassCount; i++)
+	{
+		if (m_Passes[i].name == name)
+		{
+			return i;
+		}
+	}
+
+	assert(m_PassCount < MAX_PASSES && "RenderStats : too many passes");
+	if (m_PassCount == MAX_PASSES)
+	{
+		return 0;
+	}
+
+	InitPass(m_Passes[m_PassCount], name);
+	return m_PassCount++;
+}
+
+void RenderStats::InitPass(Pass& pass, const char* name)
+{
+	// Once per pass, the profiler keeps pointers to the counter names
+	pass.name = name;
+	for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++)
+	{
+		pass.counterNames[counter] = std::string(name) + "/" + COUNTER_NAMES[counter];
+		pass.counterNameIDs[counter] = Instrumentor::Get().InternName(pass.counterNames[counter].c_str());
+	}
+}
+
+void RenderStats::PushPass(const char* name)
+{
+	assert(m_PassDepth + 1 < MAX_PASS_DEPTH && "RenderStats : passes nested too deep");
+	m_PassStack[++m_PassDepth] = FindPass(name);
+}
+
+void RenderStats::PopPass()
+{
+	assert(m_PassDepth > 0 && "RenderStats : PopPass without PushPass");
+	m_PassDepth--;
+}
+
+void RenderStats::RecordDraw(uint32_t count, uint32_t instanceCount, bool indexed)
+{
+	auto& frame = m_Passes[m_PassStack[m_PassDepth]].frame;
+	frame[DRAW_CALLS]++;
+	frame[INSTANCES] += instanceCount;
+	if (indexed)
+	{
+		frame[INDICES] += static_cast<uint64_t>(count) * instanceCount;
+	}
+	frame[TRIANGLES] += static_cast<uint64_t>(count / 3) * instanceCount;
+}
+
+uint64_t RenderStats::GetFrameTotal(Counter counter) const
+{
+	return m_FrameTotals[counter];
+}
+
+void RenderStats::Dump(std::ostream& out) const
+{
+	out << "Render stats, average per frame over " << m_FrameCount << " frames\n";
+	out << std::left << std::setw(24) << "Pass";
+	for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++)
+	{
+		out << std::right << std::setw(19) << COUNTER_NAMES[counter];
+	}
+	out << "\n";
+
+	out << std::fixed << std::setprecision(1);
+	for (uint32_t i = 0; i < m_PassCount; i++)
+	{
+		const Pass& pass = m_Passes[i];
+		out << std::left << std::setw(24) << pass.name;
+		for (uint32_t counter = 0; counter < COUNTER_COUNT; counter++)
+		{
+			out << std::right << std::setw(19) << pass.average[counter];
+		}
+		out << "\n";
+	}
+	out << std::defaultfloat;
+}
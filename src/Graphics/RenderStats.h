@@ -0,0 +1,133 @@
+#pragma once
+
+#include "../Instrumentation.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Counts the work the render systems record, per named pass and per frame. Commands go through the
+// Cmd* wrappers below, which forward to vkCmd* and add to the innermost pass opened with
+// PROFILE_RENDER_STATS. Each counter keeps a rolling average per pass that is sent to the profiler
+// as counter tracks every EMIT_INTERVAL frames and printed by Dump. Lives until exit, the profiler
+// keeps pointers to its counter names. Render thread only.
+class RenderStats
+{
+public:
+	enum Counter
+	{
+		DRAW_CALLS = 0,
+		INSTANCES,
+		INDICES,
+		TRIANGLES,				// Triangle lists assumed : every pipeline in the engine uses them
+		PIPELINE_BINDS,
+		DESCRIPTOR_BINDS,		// vkCmdBindDescriptorSets calls
+		PUSH_CONSTANT_BYTES,
+		RENDER_PASS_BEGINS,
+		COUNTER_COUNT
+	};
+
+	static constexpr uint32_t MAX_PASSES = 32;
+	static constexpr uint32_t MAX_PASS_DEPTH = 8;
+	static constexpr uint32_t EMIT_INTERVAL = 30;
+
+	RenderStats();
+
+	RenderStats(const RenderStats&) = delete;
+	RenderStats& operator=(const RenderStats&) = delete;
+
+	static RenderStats& Get();
+
+	// Starts counting a new frame, outside any pass
+	void BeginFrame();
+	// Folds the frame into the rolling averages
+	void EndFrame();
+
+	// Name must be a string literal, passes are told apart by pointer
+	void PushPass(const char* name);
+	void PopPass();
+
+	void Add(Counter counter, uint64_t value) { m_Passes[m_PassStack[m_PassDepth]].frame[counter] += value; }
+	void RecordDraw(uint32_t count, uint32_t instanceCount, bool indexed);
+
+	// Totals of the last frame over every pass
+	uint64_t GetFrameTotal(Counter counter) const;
+	// Table of the rolling averages, one line per pass
+	void Dump(std::ostream& out) const;
+
+private:
+	struct Pass
+	{
+		const char* name = nullptr;
+		std::array<uint64_t, COUNTER_COUNT> frame{};
+		std::array<double, COUNTER_COUNT> average{};
+		std::array<std::string, COUNTER_COUNT> counterNames;	// "<pass>/<counter>", interned by the profiler
+		std::array<uint32_t, COUNTER_COUNT> counterNameIDs{};
+		bool averaged = false;		// Averages start from the first frame the pass ends
+	};
+
+	uint32_t FindPass(const char* name);
+	static void InitPass(Pass& pass, const char* name);
+
+	std::array<Pass, MAX_PASSES> m_Passes;	// 0 is everything recorded outside a named pass
+	uint32_t m_PassCount = 1;
+	std::array<uint32_t, MAX_PASS_DEPTH> m_PassStack{};
+	uint32_t m_PassDepth = 0;
+
+	std::array<uint64_t, COUNTER_COUNT> m_FrameTotals{};
+	uint64_t m_FrameCount = 0;
+};
+
+class RenderStatsScope
+{
+public:
+	RenderStatsScope(const char* name) { RenderStats::Get().PushPass(name); }
+	~RenderStatsScope() { RenderStats::Get().PopPass(); }
+
+	RenderStatsScope(const RenderStatsScope&) = delete;
+	RenderStatsScope& operator=(const RenderStatsScope&) = delete;
+};
+
+#define PROFILE_RENDER_STATS(name) ::RenderStatsScope PROFILE_CONCAT(renderStats, __LINE__)(name);
+
+// Same arguments as the vkCmd* they forward to
+
+inline void CmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+	vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+	RenderStats::Get().RecordDraw(vertexCount, instanceCount, false);
+}
+
+inline void CmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
+{
+	vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+	RenderStats::Get().RecordDraw(indexCount, instanceCount, true);
+}
+
+inline void CmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline)
+{
+	vkCmdBindPipeline(commandBuffer, pipelineBindPoint, pipeline);
+	RenderStats::Get().Add(RenderStats::PIPELINE_BINDS, 1);
+}
+
+inline void CmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout, uint32_t firstSet,
+	uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets, uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets)
+{
+	vkCmdBindDescriptorSets(commandBuffer, pipelineBindPoint, layout, firstSet, descriptorSetCount, pDescriptorSets, dynamicOffsetCount, pDynamicOffsets);
+	RenderStats::Get().Add(RenderStats::DESCRIPTOR_BINDS, 1);
+}
+
+inline void CmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* pValues)
+{
+	vkCmdPushConstants(commandBuffer, layout, stageFlags, offset, size, pValues);
+	RenderStats::Get().Add(RenderStats::PUSH_CONSTANT_BYTES, size);
+}
+
+inline void CmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* pRenderPassBegin, VkSubpassContents contents)
+{
+	vkCmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+	RenderStats::Get().Add(RenderStats::RENDER_PASS_BEGINS, 1);
+}
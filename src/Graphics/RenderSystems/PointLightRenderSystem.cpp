@@ -1,13 +1,15 @@
 #include "PointLightRenderSystem.h"
+#include "../RenderStats.h"
 #include "../../Instrumentation.h"
+#include "../../FrameArena.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm/glm.hpp>
 #include <glm/glm/gtc/constants.hpp>
 #include<stdexcept>
+#include <algorithm>
 #include <cassert>
-#include <map>
 
 extern Coordinator m_Coord;
 
@@ -30,15 +32,19 @@ PointLightRenderSystem::~PointLightRenderSystem()
 	vkDestroyPipelineLayout(m_Device.device(), m_PipelineLayout, nullptr);
 }
 
-void PointLightRenderSystem::Update(FrameInfo& frameInfo, GlobalUBO& ubo)
+void PointLightRenderSystem::Update(RenderSnapshot& snapshot)
 {
-	auto rotateLight = glm::rotate(glm::mat4(1.0f), frameInfo.frameTime, { 0.0f, -1.0f, 0.0f });
+	PROFILE_FUNCTION();
+	GlobalUBO& ubo = snapshot.ubo;
+	snapshot.lightBillboards.clear();
+
+	auto rotateLight = glm::rotate(glm::mat4(1.0f), snapshot.frameTime, { 0.0f, -1.0f, 0.0f });
 	int pointLightIndex = 0;
 	int spotLightIndex = 0;
 
 	//ubo.directionalLightData.direction = glm::vec4(point, 0.02f);
 
-	auto rotateDirLight = glm::rotate(glm::mat4(1.0f), frameInfo.frameTime, { 0.0f, 0.0f, -1.0f });
+	auto rotateDirLight = glm::rotate(glm::mat4(1.0f), snapshot.frameTime, { 0.0f, 0.0f, -1.0f });
 	//auto re = rotateDirLight * glm::vec4(ubo.dirLightDirection.x, ubo.dirLightDirection.y, ubo.dirLightDirection.z, 1.0f);
 	//ubo.dirLightDirection = glm::vec4(re.x, re.y, re.z, ubo.dirLightDirection.w);
 
@@ -74,6 +80,12 @@ void PointLightRenderSystem::Update(FrameInfo& frameInfo, GlobalUBO& ubo)
 			ubo.spotLights[spotLightIndex].cutOffs = glm::vec4(lightObj.cutOff, lightObj.outerCutOff, 0.0f, 0.0f);
 			spotLightIndex++;
 		}
+
+		LightBillboard billboard{};
+		billboard.position = glm::vec4(transform.position, lightObj.isPoint ? -1.0f : lightObj.cutOff);
+		billboard.color = glm::vec4(lightObj.lightColor, lightObj.lightIntensity);
+		billboard.radius = lightObj.lightObjectRadius;
+		snapshot.lightBillboards.push_back(billboard);
 	}
 	ubo.numOfActivePointLights = pointLightIndex;
 	ubo.numOfActiveSpotLights = spotLightIndex;
@@ -83,49 +95,52 @@ void PointLightRenderSystem::Update(FrameInfo& frameInfo, GlobalUBO& ubo)
 void PointLightRenderSystem::Render(FrameInfo& frameInfo, GlobalUBO& globalUBO)
 {
 	PROFILE_FUNCTION();
+	PROFILE_GPU_SCOPE(frameInfo.gpuProfiler, frameInfo.commandBuffer, "LightBillboards");
+	PROFILE_RENDER_STATS("LightBillboards");
 	//sort lights
-	std::map<float, Entity> sorted;
-	for (auto& entity : m_Entities)
+	const std::vector<LightBillboard>& billboards = frameInfo.snapshot.lightBillboards;
+	FrameVector<std::pair<float, size_t>> sorted;
+	sorted.reserve(billboards.size());
+	for (size_t i = 0; i < billboards.size(); i++)
 	{
-		auto& transform = m_Coord.GetComponent<ECSTransformComponent>(entity);
-
 		//calculate distance
-		auto offset = frameInfo.cameraSystem.GetEditorCameraPosition() - transform.position;
+		auto offset = frameInfo.cameraSystem.GetEditorCameraPosition() - glm::vec3(billboards[i].position);
 		float disSquared = glm::dot(offset, offset);
-		sorted[disSquared] = entity;
+		sorted.push_back({ disSquared, i });
 	}
+	std::sort(sorted.begin(), sorted.end());
 
-	m_Pipeline->bind(frameInfo.commandBuffer);
-	vkCmdBindDescriptorSets(
+	if (!m_Pipeline->bind(frameInfo.commandBuffer))
+	{
+		return;
+	}
+	CmdBindDescriptorSets(
 		frameInfo.commandBuffer,
 		VK_PIPELINE_BIND_POINT_GRAPHICS,
 		m_PipelineLayout,
 		0, 1,
 		&frameInfo.globalDescriptorSet,
-		0,
-		nullptr);
+		1,
+		&frameInfo.globalUBOOffset);
 
-	//iterate through sorted map in reverse order (Point and Spot Light Objects)
+	//iterate through sorted lights in reverse order (Point and Spot Light Objects)
 	for (auto it = sorted.rbegin(); it != sorted.rend(); it++)
 	{
-		auto& entity = it->second;
-
-		auto& lightObj = m_Coord.GetComponent<LightObjectComponent>(entity);
-		auto& transform = m_Coord.GetComponent<ECSTransformComponent>(entity);
+		const LightBillboard& billboard = billboards[it->second];
 
 		LightObjectPushConstant push{};
-		push.position = glm::vec4(transform.position, lightObj.isPoint ? -1.0f : lightObj.cutOff);
-		push.color = glm::vec4(lightObj.lightColor, lightObj.lightIntensity);
-		push.radius = lightObj.lightObjectRadius;
+		push.position = billboard.position;
+		push.color = billboard.color;
+		push.radius = billboard.radius;
 
-		vkCmdPushConstants(
+		CmdPushConstants(
 			frameInfo.commandBuffer,
 			m_PipelineLayout,
 			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 			0,
 			sizeof(LightObjectPushConstant),
 			&push);
-		vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
+		CmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
 	}
 	
 	// Directional Light Data
@@ -138,14 +153,14 @@ void PointLightRenderSystem::Render(FrameInfo& frameInfo, GlobalUBO& globalUBO)
 	push.color = globalUBO.directionalLightData.color;
 	push.radius = 5.0f * globalUBO.directionalLightData.color.w;
 
-	vkCmdPushConstants(
+	CmdPushConstants(
 		frameInfo.commandBuffer,
 		m_PipelineLayout,
 		VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 		0,
 		sizeof(LightObjectPushConstant),
 		&push);
-	vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
+	CmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
 }
 
 void PointLightRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
@@ -178,11 +193,13 @@ void PointLightRenderSystem::createPipeline(VkRenderPass renderpass)
 	Pipeline::DefaultPipelineConfigInfo(pipelineConfig);
 	Pipeline::EnableAlphaBlending(pipelineConfig);
 
+	PipelineManager& pipelines = m_Device.getPipelineManager();
+
 	pipelineConfig.bindingDescription.clear();
 	pipelineConfig.attributeDescription.clear();
 	pipelineConfig.renderPass = renderpass;
 	pipelineConfig.pipelineLayout = m_PipelineLayout;
 	pipelineConfig.multisampleInfo.rasterizationSamples = m_Device.msaaSampleCountFlagBits();
 
-	m_Pipeline = std::make_unique<Pipeline>(m_Device, "Assets/Shaders/PointLight.vert.spv", "Assets/Shaders/PointLight.frag.spv", pipelineConfig);
+	m_Pipeline = pipelines.Request("Assets/Shaders/PointLight.vert.spv", "Assets/Shaders/PointLight.frag.spv", pipelineConfig);
 }
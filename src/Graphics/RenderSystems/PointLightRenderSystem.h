@@ -2,7 +2,7 @@
 
 #include "../Device.h"
 #include "../FrameInfo.h"
-#include "../Pipeline.h"
+#include "../PipelineManager.h"
 #include "../Camera.h"
 #include "../../Components.h"
 
@@ -18,7 +18,8 @@ public:
 	PointLightRenderSystem(const PointLightRenderSystem&) = delete;
 	PointLightRenderSystem& operator=(const PointLightRenderSystem&) = delete;
 
-	void Update(FrameInfo& frameInfo, GlobalUBO& ubo);
+	// Simulation thread : copies the lights into the snapshot's ubo and billboards
+	void Update(RenderSnapshot& snapshot);
 	void Render(FrameInfo& frameInfo, GlobalUBO& globalUBO);
 
 	glm::vec3 point = { 1.0f, -6.0f, 0.0f };
@@ -27,7 +28,7 @@ private:
 	void createPipeline(VkRenderPass renderpass);
 
 	Device& m_Device;
-	std::unique_ptr<Pipeline> m_Pipeline;
+	std::shared_ptr<AsyncPipeline> m_Pipeline;
 	VkPipelineLayout m_PipelineLayout;
 
 };
\ No newline at end of file
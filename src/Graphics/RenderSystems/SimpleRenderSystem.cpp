@@ -1,11 +1,14 @@
 #include "SimpleRenderSystem.h"
+#include "../RenderStats.h"
 #include "../../Instrumentation.h"
+#include "../../FrameArena.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm/glm.hpp>
 #include <glm/glm/gtc/constants.hpp>
 
+#include <array>
 #include <memory>
 #include<stdexcept>
 #include <cassert>
@@ -40,8 +43,28 @@ struct CascadedShadowPassPushConstantData
 	int cascadeIndex{};
 };
 
+struct DeferredLightingPushConstantData
+{
+	glm::mat4 inverseProjection{ 1.0f };
+};
+
+// constant_id values of the SPECIALIZATION CONSTANTS block in Basic.frag and DeferredLighting.frag
+enum LightingConstantID : uint32_t
+{
+	ACTIVE_CASCADE_COUNT_ID = 0,
+	CASCADE_PCF_RADIUS_ID = 1,
+	SPOT_PCF_RADIUS_ID = 2,
+	POINT_SHADOW_SAMPLES_ID = 3,
+	DIRECTIONAL_SHADOWS_ID = 4,
+	POINT_SHADOWS_ID = 5,
+	SPOT_SHADOWS_ID = 6,
+	POINT_LIGHTS_ID = 7,
+	SPOT_LIGHTS_ID = 8
+};
+
 
-SimpleRenderSystem::SimpleRenderSystem(Device& device, VkRenderPass renderPass, std::vector<VkDescriptorSetLayout> setLayouts, DescriptorPool& descriptorPool) :m_Device(device)
+SimpleRenderSystem::SimpleRenderSystem(Device& device, VkRenderPass renderPass, std::vector<VkDescriptorSetLayout> setLayouts, DescriptorAllocator& descriptorAllocator, FrameUniformAllocator& frameUniforms, RenderPath renderPath) 
+	:m_Device(device), m_DescriptorAllocator(descriptorAllocator), m_RenderPath(renderPath)
 {
 	PrepareShadowPassUBO();
 
@@ -56,7 +79,15 @@ SimpleRenderSystem::SimpleRenderSystem(Device& device, VkRenderPass renderPass,
 	//PrepareShadowPassFramebuffer();
 	PrepareCascadeShadowPass();
 
-	createPipelineLayout(setLayouts, descriptorPool);
+	PrepareDepthPrepass();
+
+	if (m_RenderPath == RenderPath::DEFERRED)
+	{
+		// Attachments are sized on the first G-buffer pass
+		PrepareGBufferRenderPass();
+	}
+
+	createPipelineLayout(setLayouts, descriptorAllocator, frameUniforms);
 	createPipeline(renderPass);
 }
 
@@ -66,24 +97,29 @@ SimpleRenderSystem::~SimpleRenderSystem()
 	vkDestroyPipelineLayout(m_Device.device(), m_ShadowPassPipelineLayout, nullptr);
 	vkDestroyPipelineLayout(m_Device.device(), m_PointShadowPassPipelineLayout, nullptr);
 
+	vkDestroyQueryPool(m_Device.device(), m_OverdrawQueryPool, nullptr);
+
+	vkDestroyPipelineLayout(m_Device.device(), m_GBufferPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(m_Device.device(), m_DeferredLightingPipelineLayout, nullptr);
+	DestroyGBufferAttachments(m_Device, m_GBuffer);
+	vkDestroySampler(m_Device.device(), m_GBuffer.sampler, nullptr);
+	vkDestroyRenderPass(m_Device.device(), m_GBuffer.renderPass, nullptr);
+
 	// Depth attachment
 	vkDestroyImageView(m_Device.device(), m_ShadowPass.shadowMapImage.view, nullptr);
-	vkDestroyImage(m_Device.device(), m_ShadowPass.shadowMapImage.image, nullptr);
-	vkFreeMemory(m_Device.device(), m_ShadowPass.shadowMapImage.mem, nullptr);
+	m_Device.destroyImage(m_ShadowPass.shadowMapImage.image, m_ShadowPass.shadowMapImage.mem);
 
 	vkDestroyImageView(m_Device.device(), m_PointShadowPass.pointShadowMapImage.view, nullptr);
-	vkDestroyImage(m_Device.device(), m_PointShadowPass.pointShadowMapImage.image, nullptr);
-	vkFreeMemory(m_Device.device(), m_PointShadowPass.pointShadowMapImage.mem, nullptr);
+	m_Device.destroyImage(m_PointShadowPass.pointShadowMapImage.image, m_PointShadowPass.pointShadowMapImage.mem);
 
 	vkDestroyImageView(m_Device.device(), m_SpotShadowPass.spotShadowMapImage.view, nullptr);
-	vkDestroyImage(m_Device.device(), m_SpotShadowPass.spotShadowMapImage.image, nullptr);
-	vkFreeMemory(m_Device.device(), m_SpotShadowPass.spotShadowMapImage.mem, nullptr);
+	m_Device.destroyImage(m_SpotShadowPass.spotShadowMapImage.image, m_SpotShadowPass.spotShadowMapImage.mem);
 }
 
 void SimpleRenderSystem::RenderShadowPass(FrameInfo frameInfo, GlobalUBO& globalUBO)
 {
 	PROFILE_FUNCTION();
-	UpdateShadowPassBuffer(globalUBO);
+	UpdateShadowPassBuffer(frameInfo, globalUBO);
 
 	VkClearValue clearValues[2];
 	clearValues[0].depthStencil = { 1.0f, 0 };
@@ -97,7 +133,7 @@ void SimpleRenderSystem::RenderShadowPass(FrameInfo frameInfo, GlobalUBO& global
 	renderPassBeginInfo.clearValueCount = 1;
 	renderPassBeginInfo.pClearValues = clearValues;
 
-	vkCmdBeginRenderPass(frameInfo.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	CmdBeginRenderPass(frameInfo.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 	VkViewport viewport {};
 	viewport.width = (float)m_ShadowPass.width;
@@ -128,22 +164,26 @@ void SimpleRenderSystem::RenderShadowPass(FrameInfo frameInfo, GlobalUBO& global
 		0.0f,
 		depthBiasSlope);
 
-	m_ShadowPassPipeline->bind(frameInfo.commandBuffer);
-
-	std::vector<VkDescriptorSet> globSet = { frameInfo.globalDescriptorSet, m_ShadowPassDescriptorSet };
-	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ShadowPassPipelineLayout, 0, globSet.size(), globSet.data(), 0, nullptr);
+	if (m_ShadowPassPipeline->bind(frameInfo.commandBuffer))
+	{
+		std::array<VkDescriptorSet, 2> globSet = { frameInfo.globalDescriptorSet, m_ShadowPassDescriptorSet };
+		std::array<uint32_t, 2> dynamicOffsets = { frameInfo.globalUBOOffset, m_ShadowPassOffset };
+		CmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ShadowPassPipelineLayout, 0, globSet.size(), globSet.data(), dynamicOffsets.size(), dynamicOffsets.data());
 
-	RenderGameObjects(frameInfo.commandBuffer, m_ShadowPassPipelineLayout, PushConstantType::MAIN, globSet.size(), false);
+		RenderGameObjects(frameInfo, m_ShadowPassPipelineLayout, PushConstantType::MAIN);
+	}
 
 	vkCmdEndRenderPass(frameInfo.commandBuffer);
 }
 
 void SimpleRenderSystem::RenderCascadedShadowPass(FrameInfo frameInfo, GlobalUBO& globalUBO)
 {
+	PROFILE_GPU_SCOPE(frameInfo.gpuProfiler, frameInfo.commandBuffer, "CascadedShadowPass");
+	PROFILE_RENDER_STATS("CascadedShadowPass");
 	UpdateCascades(globalUBO);
 
-	m_CascadedShadowPassBuffer->writeToBuffer(&m_CascadedShadowPass.ubo);
-	m_CascadedShadowPassBuffer->flush();
+	// Read again by the lighting pass of this frame
+	m_CascadedShadowPassOffset = frameInfo.frameUniforms.Push(m_CascadedShadowPass.ubo);
 
 	VkClearValue clearValues[1];
 	clearValues[0].depthStencil = { 1.0f, 0 };
@@ -172,21 +212,25 @@ void SimpleRenderSystem::RenderCascadedShadowPass(FrameInfo frameInfo, GlobalUBO
 	scissor.offset.y = 0;
 	vkCmdSetScissor(frameInfo.commandBuffer, 0, 1, &scissor);
 
-	std::vector<VkDescriptorSet> globSet = { frameInfo.globalDescriptorSet, m_CascadedShadowPassDescriptorSet };
-	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_CascadedShadowPassPipelineLayout, 0, globSet.size(), globSet.data(), 0, nullptr);
+	std::array<VkDescriptorSet, 2> globSet = { frameInfo.globalDescriptorSet, m_CascadedShadowPassDescriptorSet };
+	std::array<uint32_t, 2> dynamicOffsets = { frameInfo.globalUBOOffset, m_CascadedShadowPassOffset };
+	CmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_CascadedShadowPassPipelineLayout, 0, globSet.size(), globSet.data(), dynamicOffsets.size(), dynamicOffsets.data());
 
 	// One pass per cascade
 	// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's descriptor set)
 	for (uint32_t j = 0; j < CASCADE_SHADOW_MAP_COUNT; j++) 
 	{
 		renderPassBeginInfo.framebuffer = m_CascadedShadowPass.cascades[j].frameBuffer;
-		vkCmdBeginRenderPass(frameInfo.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		CmdBeginRenderPass(frameInfo.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		m_CascadeIndex = j;
 
-		m_CascadedShadowPassPipeline->bind(frameInfo.commandBuffer);
-
-		RenderGameObjects(frameInfo.commandBuffer, m_CascadedShadowPassPipelineLayout, PushConstantType::CASCADEDSHADOW, globSet.size(), false);
+		// The pass still runs while the pipeline builds and for cascades the shadow quality leaves out,
+		// it clears the cascade and transitions it for sampling
+		if (j < m_ActiveCascadeCount && m_CascadedShadowPassPipeline->bind(frameInfo.commandBuffer))
+		{
+			RenderGameObjects(frameInfo, m_CascadedShadowPassPipelineLayout, PushConstantType::CASCADEDSHADOW);
+		}
 		vkCmdEndRenderPass(frameInfo.commandBuffer);
 	}
 }
@@ -194,6 +238,8 @@ void SimpleRenderSystem::RenderCascadedShadowPass(FrameInfo frameInfo, GlobalUBO
 void SimpleRenderSystem::RenderPointShadowPass(FrameInfo frameInfo, GlobalUBO& globalUBO)
 {
 	PROFILE_FUNCTION();
+	PROFILE_GPU_SCOPE(frameInfo.gpuProfiler, frameInfo.commandBuffer, "PointShadowPass");
+	PROFILE_RENDER_STATS("PointShadowPass");
 	VkViewport viewport{};
 	viewport.width = (float)m_PointShadowPass.width;
 	viewport.height = (float)m_PointShadowPass.height;
@@ -208,6 +254,7 @@ void SimpleRenderSystem::RenderPointShadowPass(FrameInfo frameInfo, GlobalUBO& g
 	scissor.offset.y = 0;
 	vkCmdSetScissor(frameInfo.commandBuffer, 0, 1, &scissor);
 
+	m_PointShadowPassOffset = frameInfo.frameUniforms.Push(m_PointShadowPassUBO);
 
 	for (uint32_t i = 0; i < globalUBO.numOfActivePointLights; i++)
 	{
@@ -223,31 +270,355 @@ void SimpleRenderSystem::RenderPointShadowPass(FrameInfo frameInfo, GlobalUBO& g
 void SimpleRenderSystem::RenderMainPass(FrameInfo frameInfo)
 {
 	PROFILE_FUNCTION();
-	m_SpotShadowLightProjectionsBuffer->writeToBuffer(&m_SpotShadowLightProjectionsUBO);
-	m_SpotShadowLightProjectionsBuffer->flush();
+	PROFILE_GPU_SCOPE(frameInfo.gpuProfiler, frameInfo.commandBuffer, "MainPass");
+	PROFILE_RENDER_STATS("MainPass");
+	// Whichever pass writes depth first carries the overdraw query
+	VkQueryControlFlags queryFlags = m_Device.OcclusionQueryPreciseSupported() ? VK_QUERY_CONTROL_PRECISE_BIT : 0;
+
+	if (m_DepthPrepassActive)
+	{
+		vkCmdBeginQuery(frameInfo.commandBuffer, m_OverdrawQueryPool, frameInfo.FrameIndex, queryFlags);
+		RenderDepthPrepass(frameInfo);
+		vkCmdEndQuery(frameInfo.commandBuffer, m_OverdrawQueryPool, frameInfo.FrameIndex);
 
-	m_MainPipeline->bind(frameInfo.commandBuffer);
+		m_MainDepthEqualPipeline->bind(frameInfo.commandBuffer);
+	}
+	else if (!m_MainPipeline->bind(frameInfo.commandBuffer))
+	{
+		// Still building, nothing to shade with yet
+		return;
+	}
 
-	std::vector<VkDescriptorSet> globSet = 
-	{ 
-		frameInfo.globalDescriptorSet, 
+	std::array<VkDescriptorSet, 6> globSet =
+	{
+		frameInfo.globalDescriptorSet,
 		//m_ShadowPassDescriptorSet, m_ShadowMapDescriptorSet,
 		m_CascadedShadowPassDescriptorSet, m_CascadedShadowMapDescriptorSet,
 		m_PointShadowMapDescriptorSet,
-		m_SpotShadowMapDescriptorSet
+		m_SpotShadowMapDescriptorSet,
+		frameInfo.materialDescriptorSet	// Bindless, every draw indexes it with its material ID
 	};
-	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_MainPipelineLayout, 0, globSet.size(), globSet.data(), 0, nullptr);
+	std::array<uint32_t, 3> dynamicOffsets = { frameInfo.globalUBOOffset, m_CascadedShadowPassOffset, m_SpotShadowLightProjectionsOffset };
+	CmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_MainPipelineLayout, 0, globSet.size(), globSet.data(), dynamicOffsets.size(), dynamicOffsets.data());
+
+	if (!m_DepthPrepassActive)
+	{
+		vkCmdBeginQuery(frameInfo.commandBuffer, m_OverdrawQueryPool, frameInfo.FrameIndex, queryFlags);
+	}
+
+	RenderGameObjects(frameInfo, m_MainPipelineLayout, PushConstantType::MAIN, true);
 
-	RenderGameObjects(frameInfo.commandBuffer, m_MainPipelineLayout, PushConstantType::MAIN, globSet.size(), true);
+	if (!m_DepthPrepassActive)
+	{
+		vkCmdEndQuery(frameInfo.commandBuffer, m_OverdrawQueryPool, frameInfo.FrameIndex);
+	}
+
+	m_OverdrawQueryIssued[frameInfo.FrameIndex] = true;
 }
 
-void SimpleRenderSystem::RenderGameObjects(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, PushConstantType type, int setCount, bool renderMaterial)
+void SimpleRenderSystem::RenderDepthPrepass(FrameInfo frameInfo)
 {
-	//auto rotateCube = glm::rotate(glm::mat4(1.0f), frameInfo.frameTime, { -1.0f, -1.0f, -1.0f });
+	PROFILE_FUNCTION();
+	PROFILE_GPU_SCOPE(frameInfo.gpuProfiler, frameInfo.commandBuffer, "DepthPrepass");
+	PROFILE_RENDER_STATS("DepthPrepass");
+	m_DepthPrepassPipeline->bind(frameInfo.commandBuffer);
+
+	// Prepass only reads the camera from the global set
+	std::array<VkDescriptorSet, 1> globSet = { frameInfo.globalDescriptorSet };
+	CmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_MainPipelineLayout, 0, globSet.size(), globSet.data(), 1, &frameInfo.globalUBOOffset);
+
+	RenderGameObjects(frameInfo, m_MainPipelineLayout, PushConstantType::MAIN, true);
+}
+
+void SimpleRenderSystem::UpdateDepthPrepass(FrameInfo frameInfo, VkExtent2D extent)
+{
+	PROFILE_FUNCTION();
+	uint32_t query = static_cast<uint32_t>(frameInfo.FrameIndex);
+
+	// The frame fence for this index has already been waited on, so the last result is normally ready
+	if (m_OverdrawQueryIssued[query])
+	{
+		uint64_t samplesPassed = 0;
+		VkResult result = vkGetQueryPoolResults(
+			m_Device.device(),
+			m_OverdrawQueryPool,
+			query, 1,
+			sizeof(samplesPassed), &samplesPassed, sizeof(samplesPassed),
+			VK_QUERY_RESULT_64_BIT);
+
+		double screenSamples = static_cast<double>(extent.width) * extent.height * m_Device.msaaSampleCountFlagBits();
+		if (result == VK_SUCCESS && screenSamples > 0.0)
+		{
+			float overdraw = static_cast<float>(samplesPassed / screenSamples);
+			m_MeasuredOverdraw = m_MeasuredOverdraw == 0.0f ? overdraw : glm::mix(m_MeasuredOverdraw, overdraw, 0.1f);
+		}
+	}
+
+	switch (m_DepthPrepassMode)
+	{
+	case DepthPrepassMode::OFF:
+		m_DepthPrepassActive = false;
+		break;
+	case DepthPrepassMode::ON:
+		m_DepthPrepassActive = true;
+		break;
+	case DepthPrepassMode::AUTO:
+		// Imprecise queries only guarantee zero/non-zero, keep the prepass on since the main pass is the expensive one
+		if (!m_Device.OcclusionQueryPreciseSupported())
+			m_DepthPrepassActive = true;
+		else if (!m_DepthPrepassActive && m_MeasuredOverdraw > m_DepthPrepassEnableOverdraw)
+			m_DepthPrepassActive = true;
+		else if (m_DepthPrepassActive && m_MeasuredOverdraw < m_DepthPrepassDisableOverdraw)
+			m_DepthPrepassActive = false;
+		break;
+	}
+
+	// Plain main pass until both prepass pipelines are built
+	if (!m_DepthPrepassPipeline->IsReady() || !m_MainDepthEqualPipeline->IsReady())
+	{
+		m_DepthPrepassActive = false;
+	}
+
+	vkCmdResetQueryPool(frameInfo.commandBuffer, m_OverdrawQueryPool, query, 1);
+	m_OverdrawQueryIssued[query] = false;
+}
+
+void SimpleRenderSystem::RenderGBufferPass(FrameInfo frameInfo, VkExtent2D extent)
+{
+	PROFILE_FUNCTION();
+	PROFILE_GPU_SCOPE(frameInfo.gpuProfiler, frameInfo.commandBuffer, "GBufferPass");
+	PROFILE_RENDER_STATS("GBufferPass");
+	assert(m_RenderPath == RenderPath::DEFERRED && "SimpleRenderSystem:RenderGBufferPass needs the deferred render path");
+
+	if (extent.width != m_GBuffer.width || extent.height != m_GBuffer.height)
+	{
+		PrepareGBufferAttachments(extent);
+	}
+
+	std::array<VkClearValue, 4> clearValues{};
+	clearValues[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+	clearValues[1].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+	clearValues[2].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+	clearValues[3].depthStencil = { 1.0f, 0 };
+
+	VkRenderPassBeginInfo renderPassBeginInfo{};
+	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassBeginInfo.renderPass = m_GBuffer.renderPass;
+	renderPassBeginInfo.framebuffer = m_GBuffer.frameBuffer;
+	renderPassBeginInfo.renderArea.offset = { 0, 0 };
+	renderPassBeginInfo.renderArea.extent = extent;
+	renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassBeginInfo.pClearValues = clearValues.data();
+
+	CmdBeginRenderPass(frameInfo.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	VkViewport viewport{};
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(frameInfo.commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{ {0, 0}, extent };
+	vkCmdSetScissor(frameInfo.commandBuffer, 0, 1, &scissor);
+
+	// Attachments are still cleared and transitioned while the pipeline builds
+	if (m_GBufferPipeline->bind(frameInfo.commandBuffer))
+	{
+		std::array<VkDescriptorSet, 2> globSet = { frameInfo.globalDescriptorSet, frameInfo.materialDescriptorSet };
+		CmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GBufferPipelineLayout, 0, globSet.size(), globSet.data(), 1, &frameInfo.globalUBOOffset);
+
+		RenderGameObjects(frameInfo, m_GBufferPipelineLayout, PushConstantType::MAIN, true);
+	}
+
+	vkCmdEndRenderPass(frameInfo.commandBuffer);
+}
+
+void SimpleRenderSystem::RenderDeferredLightingPass(FrameInfo frameInfo)
+{
+	PROFILE_FUNCTION();
+	PROFILE_GPU_SCOPE(frameInfo.gpuProfiler, frameInfo.commandBuffer, "DeferredLightingPass");
+	PROFILE_RENDER_STATS("DeferredLightingPass");
+	assert(m_RenderPath == RenderPath::DEFERRED && "SimpleRenderSystem:RenderDeferredLightingPass needs the deferred render path");
+
+	if (!m_DeferredLightingPipeline->bind(frameInfo.commandBuffer))
+	{
+		return;
+	}
+
+	// Built once per set of attachments, a resize retires the cache with the attachments older frames may still read
+	VkDescriptorImageInfo albedoDescriptor{ m_GBuffer.sampler, m_GBuffer.albedo.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo normalDescriptor{ m_GBuffer.sampler, m_GBuffer.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo metallicRoughnessDescriptor{ m_GBuffer.sampler, m_GBuffer.metallicRoughness.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo depthDescriptor{ m_GBuffer.sampler, m_GBuffer.depth.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+
+	VkDescriptorSet gBufferDescriptorSet;
+	bool built = DescriptorWriter(*m_GBufferSetLayout, *m_GBuffer.lightingSets)
+		.writeImage(0, &albedoDescriptor)
+		.writeImage(1, &normalDescriptor)
+		.writeImage(2, &metallicRoughnessDescriptor)
+		.writeImage(3, &depthDescriptor)
+		.build(gBufferDescriptorSet);
+	if (!built)
+	{
+		throw std::runtime_error("Failed to allocate SimpleRenderSystem:GBufferDescriptorSet");
+	}
+
+	std::array<VkDescriptorSet, 6> globSet =
+	{
+		frameInfo.globalDescriptorSet,
+		m_CascadedShadowPassDescriptorSet, m_CascadedShadowMapDescriptorSet,
+		m_PointShadowMapDescriptorSet,
+		m_SpotShadowMapDescriptorSet,
+		gBufferDescriptorSet
+	};
+	std::array<uint32_t, 3> dynamicOffsets = { frameInfo.globalUBOOffset, m_CascadedShadowPassOffset, m_SpotShadowLightProjectionsOffset };
+	CmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_DeferredLightingPipelineLayout, 0, globSet.size(), globSet.data(), dynamicOffsets.size(), dynamicOffsets.data());
+
+	DeferredLightingPushConstantData data{};
+	data.inverseProjection = glm::inverse(frameInfo.cameraSystem.GetProjection());
+	CmdPushConstants(
+		frameInfo.commandBuffer,
+		m_DeferredLightingPipelineLayout,
+		VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+		sizeof(data),
+		&data);
+
+	// Once per pixel, independent of scene overdraw
+	CmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+}
+
+void SimpleRenderSystem::GatherRenderObjects(std::vector<RenderObject>& objects) const
+{
+	PROFILE_FUNCTION();
+	objects.clear();
 	for (auto& entity : m_Entities)
 	{
 		auto& transform = m_Coord.GetComponent<ECSTransformComponent>(entity);
 		auto& model = m_Coord.GetComponent<ModelComponent>(entity);
+		objects.push_back({ entity, transform, model.model.get(), model.occluder });
+	}
+}
+
+void SimpleRenderSystem::UpdateLodSelection(FrameInfo frameInfo)
+{
+	PROFILE_FUNCTION();
+	const glm::vec3 cameraPosition = glm::vec3(frameInfo.cameraSystem.GetInverseView()[3]);
+	const float projectionScale = glm::abs(frameInfo.cameraSystem.GetProjection()[1][1]);
+
+	for (auto& object : frameInfo.snapshot.objects)
+	{
+		const Entity entity = object.entity;
+		const ECSTransformComponent& transform = object.transform;
+
+		const glm::vec3& boundsMin = object.model->GetBoundsMin();
+		const glm::vec3& boundsMax = object.model->GetBoundsMax();
+
+		glm::vec3 center = glm::vec3(modelMatrix(transform.position, transform.rotation, transform.scale) * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+		float radius = glm::length(boundsMax - boundsMin) * 0.5f * glm::max(glm::abs(transform.scale.x), glm::max(glm::abs(transform.scale.y), glm::abs(transform.scale.z)));
+		float distance = glm::length(center - cameraPosition);
+
+		uint32_t lod = m_EntityLods[entity];
+
+		// Camera inside the bounds, always full detail
+		if (distance <= radius)
+		{
+			m_EntityLods[entity] = 0;
+			continue;
+		}
+
+		float screenSize = radius * projectionScale / distance;
+
+		// Hysteresis band around each threshold so entities near one don't flicker between levels
+		while (lod > 0 && screenSize > m_LodScreenSizes[lod - 1] * (1.0f + m_LodHysteresis))
+		{
+			lod--;
+		}
+		while (lod < m_LodScreenSizes.size() && screenSize < m_LodScreenSizes[lod] * (1.0f - m_LodHysteresis))
+		{
+			lod++;
+		}
+
+		m_EntityLods[entity] = static_cast<uint8_t>(lod);
+	}
+}
+
+void SimpleRenderSystem::UpdateOcclusionCulling(FrameInfo frameInfo)
+{
+	PROFILE_FUNCTION();
+	m_OccludedEntities.reset();
+	m_OccludedEntityCount = 0;
+
+	if (!m_OcclusionCullingEnabled)
+	{
+		return;
+	}
+
+	m_OcclusionCuller.BeginFrame(frameInfo.cameraSystem.GetProjection() * frameInfo.cameraSystem.GetView());
+
+	for (auto& object : frameInfo.snapshot.objects)
+	{
+		if (!object.occluder)
+		{
+			continue;
+		}
+
+		const ECSTransformComponent& transform = object.transform;
+		glm::mat4 entityModelMatrix = modelMatrix(transform.position, transform.rotation, transform.scale);
+
+		const auto& vertices = object.model->GetVertices();
+		const auto& indices = object.model->GetIndices();
+		for (auto& primitive : object.model->GetPrimitives())
+		{
+			if (primitive.indexCount == 0)
+			{
+				continue;
+			}
+
+			m_OcclusionCuller.AddOccluder(
+				entityModelMatrix,
+				&vertices[0].position,
+				sizeof(Model::Vertex),
+				&indices[primitive.firstIndex],
+				primitive.indexCount,
+				primitive.firstVertex);
+		}
+	}
+
+	m_OcclusionCuller.Rasterize();
+
+	for (auto& object : frameInfo.snapshot.objects)
+	{
+		// Occluders would test against their own depth
+		if (object.occluder)
+		{
+			continue;
+		}
+
+		const ECSTransformComponent& transform = object.transform;
+		glm::mat4 entityModelMatrix = modelMatrix(transform.position, transform.rotation, transform.scale);
+
+		if (!m_OcclusionCuller.IsVisible(entityModelMatrix, object.model->GetBoundsMin(), object.model->GetBoundsMax()))
+		{
+			m_OccludedEntities.set(object.entity);
+			m_OccludedEntityCount++;
+		}
+	}
+}
+
+void SimpleRenderSystem::RenderGameObjects(const FrameInfo& frameInfo, VkPipelineLayout pipelineLayout, PushConstantType type, bool occlusionCull)
+{
+	VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+	//auto rotateCube = glm::rotate(glm::mat4(1.0f), frameInfo.frameTime, { -1.0f, -1.0f, -1.0f });
+	for (auto& object : frameInfo.snapshot.objects)
+	{
+		const Entity entity = object.entity;
+		if (occlusionCull && m_OccludedEntities.test(entity))
+		{
+			continue;
+		}
+
+		const ECSTransformComponent& transform = object.transform;
 
 		//transform.position = glm::vec3(rotateCube * glm::vec4(transform.position, 1.0f));
 
@@ -257,7 +628,7 @@ void SimpleRenderSystem::RenderGameObjects(VkCommandBuffer commandBuffer, VkPipe
 			data.modelMatrix = modelMatrix(transform.position, transform.rotation, transform.scale);
 			data.normalMatrix = normalMatrix(transform.rotation, transform.scale);
 
-			vkCmdPushConstants(
+			CmdPushConstants(
 				commandBuffer,
 				pipelineLayout,
 				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
@@ -271,7 +642,7 @@ void SimpleRenderSystem::RenderGameObjects(VkCommandBuffer commandBuffer, VkPipe
 			data.lightCount = m_PointLightCount;
 			data.faceCount = m_FaceCount;
 
-			vkCmdPushConstants(
+			CmdPushConstants(
 				commandBuffer,
 				pipelineLayout,
 				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
@@ -284,7 +655,7 @@ void SimpleRenderSystem::RenderGameObjects(VkCommandBuffer commandBuffer, VkPipe
 			data.modelMatrix = modelMatrix(transform.position, transform.rotation, transform.scale);
 			data.lightCount = m_SpotLightIndex;
 
-			vkCmdPushConstants(
+			CmdPushConstants(
 				commandBuffer,
 				pipelineLayout,
 				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
@@ -297,19 +668,21 @@ void SimpleRenderSystem::RenderGameObjects(VkCommandBuffer commandBuffer, VkPipe
 			data.modelMatrix = modelMatrix(transform.position, transform.rotation, transform.scale);
 			data.cascadeIndex = m_CascadeIndex;
 
-			vkCmdPushConstants(
+			CmdPushConstants(
 				commandBuffer,
 				pipelineLayout,
 				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
 				sizeof(data),
 				&data);
 		}
-		model.model->Bind(commandBuffer);
-		model.model->Draw(commandBuffer, pipelineLayout, setCount, renderMaterial);
+		uint32_t lod = m_EntityLods[entity] + (type == SimpleRenderSystem::MAIN ? 0 : m_ShadowLodBias);
+
+		// Vertex streams come from the geometry arena, bound once per frame, materials from the bindless set bound per pass
+		object.model->Draw(commandBuffer, lod);
 	}
 }
 
-void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout> setLayouts, DescriptorPool& descriptorPool)
+void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout> setLayouts, DescriptorAllocator& descriptorAllocator, FrameUniformAllocator& frameUniforms)
 {
 	std::vector<VkDescriptorSetLayout> mainSetLayouts;
 	std::vector<VkDescriptorSetLayout> shadowPassSetLayouts;
@@ -354,10 +727,10 @@ void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout>
 
 	// ShadowPass Pipeline Layout
 	//auto shadowPassUBOLayout = DescriptorSetLayout::Builder(m_Device)
-	//	.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+	//	.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
 	//	.build();
-	//auto bufferInfo = m_ShadowPassBuffer->descriptorInfo();
-	//DescriptorWriter(*shadowPassUBOLayout, descriptorPool)
+	//auto bufferInfo = frameUniforms.DescriptorInfo(sizeof(ShadowPassUBO));
+	//DescriptorWriter(*shadowPassUBOLayout, descriptorAllocator)
 	//	.writeBuffer(0, &bufferInfo)
 	//	.build(m_ShadowPassDescriptorSet);
 	//shadowPassSetLayouts.push_back(shadowPassUBOLayout->getDescriptorSetLayout());
@@ -377,10 +750,10 @@ void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout>
 
 	// Cascaded Shadow Pass
 	auto cascadedShadowPassUBOLayout = DescriptorSetLayout::Builder(m_Device)
-		.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
 		.build();
-	auto bufferInfoCas = m_CascadedShadowPassBuffer->descriptorInfo();
-	DescriptorWriter(*cascadedShadowPassUBOLayout, descriptorPool)
+	auto bufferInfoCas = frameUniforms.DescriptorInfo(sizeof(CascadedShadowPassUBO));
+	DescriptorWriter(*cascadedShadowPassUBOLayout, descriptorAllocator)
 		.writeBuffer(0, &bufferInfoCas)
 		.build(m_CascadedShadowPassDescriptorSet);
 	cascadedShadowPassSetLayouts.push_back(cascadedShadowPassUBOLayout->getDescriptorSetLayout());
@@ -406,7 +779,7 @@ void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout>
 	//shadowMapDescriptor.sampler = m_ShadowPass.shadowMapSampler;
 	//shadowMapDescriptor.imageView = m_ShadowPass.shadowMapImage.view;
 	//shadowMapDescriptor.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-	//DescriptorWriter(*shadowMapDescriptorSetLayout, descriptorPool)
+	//DescriptorWriter(*shadowMapDescriptorSetLayout, descriptorAllocator)
 	//	.writeImage(0, &shadowMapDescriptor)
 	//	.build(m_ShadowMapDescriptorSet);
 	//mainSetLayouts.push_back(shadowPassUBOLayout->getDescriptorSetLayout());
@@ -420,7 +793,7 @@ void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout>
 	cascadedshadowMapDescriptor.sampler = m_CascadedDepthMapObject.sampler;
 	cascadedshadowMapDescriptor.imageView = m_CascadedDepthMapObject.view;
 	cascadedshadowMapDescriptor.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-	DescriptorWriter(*cascadedShadowMapDescriptorSetLayout, descriptorPool)
+	DescriptorWriter(*cascadedShadowMapDescriptorSetLayout, descriptorAllocator)
 		.writeImage(0, &cascadedshadowMapDescriptor)
 		.build(m_CascadedShadowMapDescriptorSet);
 	mainSetLayouts.push_back(cascadedShadowPassUBOLayout->getDescriptorSetLayout());
@@ -434,7 +807,7 @@ void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout>
 	pointShadowMapDescriptor.sampler = m_PointShadowCubeMaps.cubeMapSampler;
 	pointShadowMapDescriptor.imageView = m_PointShadowCubeMaps.cubeMapImage.view;
 	pointShadowMapDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	DescriptorWriter(*pointShadowMapDescriptorSetLayout, descriptorPool)
+	DescriptorWriter(*pointShadowMapDescriptorSetLayout, descriptorAllocator)
 		.writeImage(0, &pointShadowMapDescriptor)
 		.build(m_PointShadowMapDescriptorSet);
 	mainSetLayouts.push_back(pointShadowMapDescriptorSetLayout->getDescriptorSetLayout());
@@ -442,14 +815,14 @@ void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout>
 	// Spot Shadow Map descriptorSet
 	auto spotShadowMapDescriptorSetLayout = DescriptorSetLayout::Builder(m_Device)
 		.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-		.addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+		.addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
 		.build();
 	VkDescriptorImageInfo spotShadowMapDescriptor{};
 	spotShadowMapDescriptor.sampler = m_SpotShadowMaps.cubeMapSampler;
 	spotShadowMapDescriptor.imageView = m_SpotShadowMaps.cubeMapImage.view;
 	spotShadowMapDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	auto bufferInfoTwo = m_SpotShadowLightProjectionsBuffer->descriptorInfo();
-	DescriptorWriter(*spotShadowMapDescriptorSetLayout, descriptorPool)
+	auto bufferInfoTwo = frameUniforms.DescriptorInfo(sizeof(SpotShadowLightProjectionsUBO));
+	DescriptorWriter(*spotShadowMapDescriptorSetLayout, descriptorAllocator)
 		.writeImage(0, &spotShadowMapDescriptor)
 		.writeBuffer(1, &bufferInfoTwo)
 		.build(m_SpotShadowMapDescriptorSet);
@@ -468,13 +841,60 @@ void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout>
 		throw std::runtime_error("Failed to create SimpleRenderSystem:MainPipelineLayout");
 	}
 
+	// Deferred Pipeline Layouts
+	if (m_RenderPath == RenderPath::DEFERRED)
+	{
+		// G-Buffer : global and material sets, same push constants as the main pass
+		std::vector<VkDescriptorSetLayout> gBufferSetLayouts = { setLayouts[0], setLayouts[1] };
+
+		VkPipelineLayoutCreateInfo gBufferPipelineLayoutInfo{};
+		gBufferPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		gBufferPipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(gBufferSetLayouts.size());
+		gBufferPipelineLayoutInfo.pSetLayouts = gBufferSetLayouts.data();
+		gBufferPipelineLayoutInfo.pushConstantRangeCount = 1;
+		gBufferPipelineLayoutInfo.pPushConstantRanges = &mainPushConstantRange;
+
+		if (vkCreatePipelineLayout(m_Device.device(), &gBufferPipelineLayoutInfo, nullptr, &m_GBufferPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create SimpleRenderSystem:GBufferPipelineLayout");
+		}
+
+		// Lighting : same shadow sets as the main pass, G-buffer in place of the material set
+		m_GBufferSetLayout = DescriptorSetLayout::Builder(m_Device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+			.build();
+
+		std::vector<VkDescriptorSetLayout> deferredLightingSetLayouts(mainSetLayouts.begin(), mainSetLayouts.end() - 1);
+		deferredLightingSetLayouts.push_back(m_GBufferSetLayout->getDescriptorSetLayout());
+
+		VkPushConstantRange deferredLightingPushConstantRange{};
+		deferredLightingPushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		deferredLightingPushConstantRange.offset = 0;
+		deferredLightingPushConstantRange.size = sizeof(DeferredLightingPushConstantData);
+
+		VkPipelineLayoutCreateInfo deferredLightingPipelineLayoutInfo{};
+		deferredLightingPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		deferredLightingPipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(deferredLightingSetLayouts.size());
+		deferredLightingPipelineLayoutInfo.pSetLayouts = deferredLightingSetLayouts.data();
+		deferredLightingPipelineLayoutInfo.pushConstantRangeCount = 1;
+		deferredLightingPipelineLayoutInfo.pPushConstantRanges = &deferredLightingPushConstantRange;
+
+		if (vkCreatePipelineLayout(m_Device.device(), &deferredLightingPipelineLayoutInfo, nullptr, &m_DeferredLightingPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create SimpleRenderSystem:DeferredLightingPipelineLayout");
+		}
+	}
+
 
 	// Point Shadow Pass Pipeline Layout
 	auto pointShadowPassUBOLayout = DescriptorSetLayout::Builder(m_Device)
-		.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
 		.build();
-	auto pointBufferInfo = m_PointShadowPassBuffer->descriptorInfo();
-	DescriptorWriter(*pointShadowPassUBOLayout, descriptorPool)
+	auto pointBufferInfo = frameUniforms.DescriptorInfo(sizeof(PointShadowPassViewMatrixUBO));
+	DescriptorWriter(*pointShadowPassUBOLayout, descriptorAllocator)
 		.writeBuffer(0, &pointBufferInfo)
 		.build(m_PointShadowPassDescriptorSet);
 	pointShadowPassSetLayouts.push_back(pointShadowPassUBOLayout->getDescriptorSetLayout());
@@ -496,9 +916,8 @@ void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout>
 	auto spotShadowPassUBOLayout = DescriptorSetLayout::Builder(m_Device)
 		.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
 		.build();
-	auto spotBufferInfo = m_SpotShadowPassBuffer->descriptorInfoForIndex(0); //check
-	//auto spotBufferInfo = m_SpotShadowPassBuffer->descriptorInfo(sizeof(ShadowPassUBO)); //check
-	DescriptorWriter(*spotShadowPassUBOLayout, descriptorPool)
+	auto spotBufferInfo = frameUniforms.DescriptorInfo(sizeof(ShadowPassUBO));
+	DescriptorWriter(*spotShadowPassUBOLayout, descriptorAllocator)
 		.writeBuffer(0, &spotBufferInfo)
 		.build(m_SpotShadowPassDescriptorSet);
 	spotShadowPassSetLayouts.push_back(spotShadowPassUBOLayout->getDescriptorSetLayout());
@@ -519,6 +938,9 @@ void SimpleRenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout>
 
 void SimpleRenderSystem::createPipeline(VkRenderPass renderpass)
 {
+	// Every pipeline is built on the manager's workers, passes skip their draws until theirs is ready
+	PipelineManager& pipelines = m_Device.getPipelineManager();
+
 	// Main Pipeline
 	assert(m_MainPipelineLayout != nullptr && "Cannot create SimpleRenderSystem:MainPipeline before MainPipelineLayout");
 
@@ -528,7 +950,37 @@ void SimpleRenderSystem::createPipeline(VkRenderPass renderpass)
 	pipelineConfig.pipelineLayout = m_MainPipelineLayout;
 	pipelineConfig.multisampleInfo.rasterizationSamples = m_Device.msaaSampleCountFlagBits();
 
-	m_MainPipeline = std::make_unique<Pipeline>(m_Device, "Assets/Shaders/Basic.vert.spv", "Assets/Shaders/Basic.frag.spv", pipelineConfig);
+	m_FallbackShadowQuality = m_ShadowQuality;
+	m_ActiveShadowQuality = m_ShadowQuality;
+	m_ActiveCascadeCount = GetShadowSettings(m_ShadowQuality).cascadeCount;
+
+	SetLightingPassSource(LIGHTING_MAIN, "Assets/Shaders/Basic.vert.spv", "Assets/Shaders/Basic.frag.spv", pipelineConfig);
+	m_FallbackLightingPipelines[LIGHTING_MAIN] = GetLightingVariant({ LIGHTING_MAIN, m_ShadowQuality, true, true });
+	m_MainPipeline = m_FallbackLightingPipelines[LIGHTING_MAIN];
+
+	// Main Pipeline after depth prepass : depth is already resolved, only shade the visible surface
+	pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+
+	SetLightingPassSource(LIGHTING_MAIN_DEPTH_EQUAL, "Assets/Shaders/Basic.vert.spv", "Assets/Shaders/Basic.frag.spv", pipelineConfig);
+	m_FallbackLightingPipelines[LIGHTING_MAIN_DEPTH_EQUAL] = GetLightingVariant({ LIGHTING_MAIN_DEPTH_EQUAL, m_ShadowQuality, true, true });
+	m_MainDepthEqualPipeline = m_FallbackLightingPipelines[LIGHTING_MAIN_DEPTH_EQUAL];
+
+	// Depth Prepass Pipeline
+	PipelineConfigInfo depthPrepassConfig{};
+	Pipeline::DefaultPipelineConfigInfo(depthPrepassConfig);
+	Pipeline::EnableDepthOnly(depthPrepassConfig);
+	depthPrepassConfig.renderPass = renderpass;
+	depthPrepassConfig.pipelineLayout = m_MainPipelineLayout;
+	depthPrepassConfig.multisampleInfo.rasterizationSamples = m_Device.msaaSampleCountFlagBits();
+
+	m_DepthPrepassPipeline = pipelines.Request("Assets/Shaders/DepthPrepass.vert.spv", "Assets/Shaders/DepthPrepass.frag.spv", depthPrepassConfig);
+
+	pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	pipelineConfig.depthStencilInfo.depthWriteEnable = VK_TRUE;
+
+	// Shadow passes only need positions
+	Pipeline::EnablePositionOnly(pipelineConfig);
 
 	// Point Shadow Pass Pipeline
 	assert(m_PointShadowPassPipelineLayout != nullptr && "Cannot create SimpleRenderSystem:PointShadowPassPipeline before PointShadowPassPipelineLayout");
@@ -537,7 +989,7 @@ void SimpleRenderSystem::createPipeline(VkRenderPass renderpass)
 	pipelineConfig.pipelineLayout = m_PointShadowPassPipelineLayout;
 	pipelineConfig.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-	m_PointShadowPassPipeline = std::make_unique<Pipeline>(m_Device, "Assets/Shaders/PointShadowPass.vert.spv", "Assets/Shaders/PointShadowPass.frag.spv", pipelineConfig);
+	m_PointShadowPassPipeline = pipelines.Request("Assets/Shaders/PointShadowPass.vert.spv", "Assets/Shaders/PointShadowPass.frag.spv", pipelineConfig);
 
 	// Spot Shadow Pass Pipeline
 	assert(m_SpotShadowPassPipelineLayout != nullptr && "Cannot create SimpleRenderSystem:SpotShadowPassPipeline before SpotShadowPassPipelineLayout");
@@ -546,7 +998,7 @@ void SimpleRenderSystem::createPipeline(VkRenderPass renderpass)
 	pipelineConfig.pipelineLayout = m_SpotShadowPassPipelineLayout;
 	pipelineConfig.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-	m_SpotShadowPassPipeline = std::make_unique<Pipeline>(m_Device, "Assets/Shaders/SpotShadowPass.vert.spv", "Assets/Shaders/SpotShadowPass.frag.spv", pipelineConfig);
+	m_SpotShadowPassPipeline = pipelines.Request("Assets/Shaders/SpotShadowPass.vert.spv", "Assets/Shaders/SpotShadowPass.frag.spv", pipelineConfig);
 
 	// Shadow Pass Pipeline
 	//assert(m_ShadowPassPipelineLayout != nullptr && "Cannot create SimpleRenderSystem:ShadowPassPipeline before ShadowPassPipelineLayout");
@@ -564,7 +1016,7 @@ void SimpleRenderSystem::createPipeline(VkRenderPass renderpass)
 	//pipelineConfig.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 	//pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
 
-	//m_ShadowPassPipeline = std::make_unique<Pipeline>(m_Device, "Assets/Shaders/ShadowPass.vert.spv", "Assets/Shaders/ShadowPass.frag.spv", pipelineConfig);
+	//m_ShadowPassPipeline = pipelines.Request("Assets/Shaders/ShadowPass.vert.spv", "Assets/Shaders/ShadowPass.frag.spv", pipelineConfig);
 
 	// Cascaded Shadow Pass Pipeline
 	assert(m_CascadedShadowPassPipelineLayout != nullptr && "Cannot create SimpleRenderSystem:CascadedShadowPassPipeline before CascadedShadowPassPipelineLayout");
@@ -576,7 +1028,321 @@ void SimpleRenderSystem::createPipeline(VkRenderPass renderpass)
 	pipelineConfig.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 	pipelineConfig.rasterizationInfo.cullMode = VK_CULL_MODE_BACK_BIT;
 
-	m_CascadedShadowPassPipeline = std::make_unique<Pipeline>(m_Device, "Assets/Shaders/CascadedShadowPass.vert.spv", "Assets/Shaders/CascadedShadowPass.frag.spv", pipelineConfig);
+	m_CascadedShadowPassPipeline = pipelines.Request("Assets/Shaders/CascadedShadowPass.vert.spv", "Assets/Shaders/CascadedShadowPass.frag.spv", pipelineConfig);
+
+	if (m_RenderPath != RenderPath::DEFERRED)
+	{
+		return;
+	}
+
+	// G-Buffer Pipeline
+	assert(m_GBufferPipelineLayout != nullptr && "Cannot create SimpleRenderSystem:GBufferPipeline before GBufferPipelineLayout");
+
+	PipelineConfigInfo gBufferConfig{};
+	Pipeline::DefaultPipelineConfigInfo(gBufferConfig);
+	std::array<VkPipelineColorBlendAttachmentState, 3> gBufferBlendAttachments;
+	gBufferBlendAttachments.fill(gBufferConfig.colorBlendAttachment);
+	gBufferConfig.colorBlendInfo.attachmentCount = static_cast<uint32_t>(gBufferBlendAttachments.size());
+	gBufferConfig.colorBlendInfo.pAttachments = gBufferBlendAttachments.data();
+	gBufferConfig.renderPass = m_GBuffer.renderPass;
+	gBufferConfig.pipelineLayout = m_GBufferPipelineLayout;
+	gBufferConfig.multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	m_GBufferPipeline = pipelines.Request("Assets/Shaders/GBuffer.vert.spv", "Assets/Shaders/GBuffer.frag.spv", gBufferConfig);
+
+	// Deferred Lighting Pipeline : full screen triangle, depth comes from the G-buffer through gl_FragDepth
+	assert(m_DeferredLightingPipelineLayout != nullptr && "Cannot create SimpleRenderSystem:DeferredLightingPipeline before DeferredLightingPipelineLayout");
+
+	PipelineConfigInfo lightingConfig{};
+	Pipeline::DefaultPipelineConfigInfo(lightingConfig);
+	lightingConfig.bindingDescription.clear();
+	lightingConfig.attributeDescription.clear();
+	lightingConfig.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+	lightingConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+	lightingConfig.renderPass = renderpass;
+	lightingConfig.pipelineLayout = m_DeferredLightingPipelineLayout;
+	lightingConfig.multisampleInfo.rasterizationSamples = m_Device.msaaSampleCountFlagBits();
+
+	SetLightingPassSource(LIGHTING_DEFERRED, "Assets/Shaders/DeferredLighting.vert.spv", "Assets/Shaders/DeferredLighting.frag.spv", lightingConfig);
+	m_FallbackLightingPipelines[LIGHTING_DEFERRED] = GetLightingVariant({ LIGHTING_DEFERRED, m_ShadowQuality, true, true });
+	m_DeferredLightingPipeline = m_FallbackLightingPipelines[LIGHTING_DEFERRED];
+}
+
+void SimpleRenderSystem::SetLightingPassSource(LightingPass pass, const std::string& vertexPath, const std::string& fragPath, const PipelineConfigInfo& configInfo)
+{
+	LightingPassSource& source = m_LightingPassSources[pass];
+	source.vertexPath = vertexPath;
+	source.fragPath = fragPath;
+	Pipeline::CopyPipelineConfigInfo(configInfo, source.configInfo);
+}
+
+std::shared_ptr<AsyncPipeline> SimpleRenderSystem::GetLightingVariant(const LightingVariant& variant)
+{
+	uint32_t key = static_cast<uint32_t>(variant.quality)
+		| (variant.pointLights ? 1u << 2 : 0u)
+		| (variant.spotLights ? 1u << 3 : 0u)
+		| (static_cast<uint32_t>(variant.pass) << 4);
+
+	auto it = m_LightingVariants.find(key);
+	if (it != m_LightingVariants.end())
+	{
+		return it->second;
+	}
+
+	const LightingPassSource& source = m_LightingPassSources[variant.pass];
+	assert(!source.vertexPath.empty() && "SimpleRenderSystem : lighting variant requested for a pass that was never created");
+
+	// Shadow paths without a light to cast them are stripped too
+	ShadowSettings settings = GetShadowSettings(variant.quality);
+	assert(settings.pointShadowSamples <= 20 && "SimpleRenderSystem : point shadows sample at most the 20 taps of gridSamplingDisk");
+	PipelineConfigInfo configInfo{};
+	Pipeline::CopyPipelineConfigInfo(source.configInfo, configInfo);
+	configInfo.fragmentSpecialization
+		.Set(ACTIVE_CASCADE_COUNT_ID, static_cast<int32_t>(settings.cascadeCount))
+		.Set(CASCADE_PCF_RADIUS_ID, settings.cascadePcfRadius)
+		.Set(SPOT_PCF_RADIUS_ID, settings.spotPcfRadius)
+		.Set(POINT_SHADOW_SAMPLES_ID, settings.pointShadowSamples)
+		.Set(DIRECTIONAL_SHADOWS_ID, settings.directionalShadows)
+		.Set(POINT_SHADOWS_ID, settings.pointShadows && variant.pointLights)
+		.Set(SPOT_SHADOWS_ID, settings.spotShadows && variant.spotLights)
+		.Set(POINT_LIGHTS_ID, variant.pointLights)
+		.Set(SPOT_LIGHTS_ID, variant.spotLights);
+
+	auto pipeline = m_Device.getPipelineManager().Request(source.vertexPath, source.fragPath, configInfo);
+	m_LightingVariants[key] = pipeline;
+	return pipeline;
+}
+
+SimpleRenderSystem::ShadowSettings SimpleRenderSystem::GetShadowSettings(ShadowQuality quality)
+{
+	switch (quality)
+	{
+	case ShadowQuality::LOW:
+		return { 2, 1, 3, 8, true, false, false };
+	case ShadowQuality::MEDIUM:
+		return { 3, 2, 8, 12, true, true, true };
+	case ShadowQuality::HIGH:
+	default:
+		return { CASCADE_SHADOW_MAP_COUNT, 3, 20, 20, true, true, true };
+	}
+}
+
+void SimpleRenderSystem::SelectLightingVariants(const GlobalUBO& ubo)
+{
+	PROFILE_FUNCTION();
+
+	bool pointLights = ubo.numOfActivePointLights > 0;
+	bool spotLights = ubo.numOfActiveSpotLights > 0;
+
+	FrameVector<LightingPass> passes;
+	if (m_RenderPath == RenderPath::DEFERRED)
+		passes = { LIGHTING_DEFERRED };
+	else
+		passes = { LIGHTING_MAIN, LIGHTING_MAIN_DEPTH_EQUAL };
+
+	std::array<std::shared_ptr<AsyncPipeline>, LIGHTING_PASS_COUNT> variants = m_FallbackLightingPipelines;
+	bool variantsReady = true;
+	for (LightingPass pass : passes)
+	{
+		variants[pass] = GetLightingVariant({ pass, m_ShadowQuality, pointLights, spotLights });
+		variantsReady = variantsReady && variants[pass]->IsReady();
+	}
+
+	// Every pass of a frame has to agree on the cascade count, so the variants are switched together
+	if (!variantsReady)
+	{
+		variants = m_FallbackLightingPipelines;
+	}
+	m_ActiveShadowQuality = variantsReady ? m_ShadowQuality : m_FallbackShadowQuality;
+	m_ActiveCascadeCount = GetShadowSettings(m_ActiveShadowQuality).cascadeCount;
+
+	m_MainPipeline = variants[LIGHTING_MAIN];
+	m_MainDepthEqualPipeline = variants[LIGHTING_MAIN_DEPTH_EQUAL];
+	if (m_RenderPath == RenderPath::DEFERRED)
+	{
+		m_DeferredLightingPipeline = variants[LIGHTING_DEFERRED];
+	}
+}
+
+void SimpleRenderSystem::PrepareDepthPrepass()
+{
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+	queryPoolInfo.queryCount = SwapChain::MAX_FRAMES_IN_FLIGHT;
+
+	if (vkCreateQueryPool(m_Device.device(), &queryPoolInfo, nullptr, &m_OverdrawQueryPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create SimpleRenderSystem:OverdrawQueryPool");
+	}
+}
+
+void SimpleRenderSystem::PrepareGBufferRenderPass()
+{
+	std::array<VkAttachmentDescription, 4> attachments{};
+	std::array<VkFormat, 4> formats = { m_GBufferAlbedoFormat, m_GBufferNormalFormat, m_GBufferMetallicRoughnessFormat, m_Device.DepthFormat() };
+	for (uint32_t i = 0; i < attachments.size(); i++)
+	{
+		attachments[i].format = formats[i];
+		attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;							// Read by the lighting pass
+		attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+	attachments[3].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	std::array<VkAttachmentReference, 3> colorReferences{};
+	for (uint32_t i = 0; i < colorReferences.size(); i++)
+	{
+		colorReferences[i].attachment = i;
+		colorReferences[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
+	VkAttachmentReference depthReference = {};
+	depthReference.attachment = 3;
+	depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+	subpass.pColorAttachments = colorReferences.data();
+	subpass.pDepthStencilAttachment = &depthReference;
+
+	// Use subpass dependencies for layout transitions
+	std::array<VkSubpassDependency, 2> dependencies;
+
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	VkRenderPassCreateInfo renderPassCreateInfo{};
+	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderPassCreateInfo.pAttachments = attachments.data();
+	renderPassCreateInfo.subpassCount = 1;
+	renderPassCreateInfo.pSubpasses = &subpass;
+	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassCreateInfo.pDependencies = dependencies.data();
+
+	if (vkCreateRenderPass(m_Device.device(), &renderPassCreateInfo, nullptr, &m_GBuffer.renderPass) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create G-buffer render pass!");
+	}
+
+	// Lighting reads with texelFetch, filtering never applies
+	VkSamplerCreateInfo sampler{};
+	sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler.magFilter = VK_FILTER_NEAREST;
+	sampler.minFilter = VK_FILTER_NEAREST;
+	sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler.addressModeV = sampler.addressModeU;
+	sampler.addressModeW = sampler.addressModeU;
+	sampler.maxAnisotropy = 1.0f;
+	sampler.minLod = 0.0f;
+	sampler.maxLod = 1.0f;
+	sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	if (vkCreateSampler(m_Device.device(), &sampler, nullptr, &m_GBuffer.sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create G-buffer sampler!");
+	}
+}
+
+void SimpleRenderSystem::CreateGBufferAttachment(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask, ShadowFrameBufferAttachment& attachment)
+{
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = m_GBuffer.width;
+	imageInfo.extent.height = m_GBuffer.height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.format = format;
+	imageInfo.usage = usage | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (vkCreateImage(m_Device.device(), &imageInfo, nullptr, &attachment.image) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create G-buffer image!");
+	}
+
+	attachment.mem = m_Device.getMemoryAllocator().AllocateForImage(attachment.image, imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange = {};
+	viewInfo.subresourceRange.aspectMask = aspectMask;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+	viewInfo.image = attachment.image;
+	if (vkCreateImageView(m_Device.device(), &viewInfo, nullptr, &attachment.view) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create G-buffer image view!");
+	}
+}
+
+void SimpleRenderSystem::PrepareGBufferAttachments(VkExtent2D extent)
+{
+	if (m_GBuffer.frameBuffer != VK_NULL_HANDLE)
+	{
+		// Window was resized, frames still in flight may be reading the old attachments
+		Device& device = m_Device;
+		GBuffer retired = m_GBuffer;
+		m_Device.getGraphicsTimeline().DeferDestroy([&device, retired]() mutable { DestroyGBufferAttachments(device, retired); });
+	}
+
+	m_GBuffer.width = extent.width;
+	m_GBuffer.height = extent.height;
+	m_GBuffer.lightingSets = std::make_shared<DescriptorSetCache>(m_Device);
+
+	CreateGBufferAttachment(m_GBufferAlbedoFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, m_GBuffer.albedo);
+	CreateGBufferAttachment(m_GBufferNormalFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, m_GBuffer.normal);
+	CreateGBufferAttachment(m_GBufferMetallicRoughnessFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, m_GBuffer.metallicRoughness);
+	CreateGBufferAttachment(m_Device.DepthFormat(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, m_GBuffer.depth);
+
+	std::array<VkImageView, 4> attachmentViews = { m_GBuffer.albedo.view, m_GBuffer.normal.view, m_GBuffer.metallicRoughness.view, m_GBuffer.depth.view };
+
+	VkFramebufferCreateInfo framebufferInfo{};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = m_GBuffer.renderPass;
+	framebufferInfo.attachmentCount = static_cast<uint32_t>(attachmentViews.size());
+	framebufferInfo.pAttachments = attachmentViews.data();
+	framebufferInfo.width = m_GBuffer.width;
+	framebufferInfo.height = m_GBuffer.height;
+	framebufferInfo.layers = 1;
+	if (vkCreateFramebuffer(m_Device.device(), &framebufferInfo, nullptr, &m_GBuffer.frameBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create G-buffer framebuffer!");
+	}
+}
+
+void SimpleRenderSystem::DestroyGBufferAttachments(Device& device, GBuffer& gBuffer)
+{
+	vkDestroyFramebuffer(device.device(), gBuffer.frameBuffer, nullptr);
+	gBuffer.frameBuffer = VK_NULL_HANDLE;
+
+	for (ShadowFrameBufferAttachment* attachment : { &gBuffer.albedo, &gBuffer.normal, &gBuffer.metallicRoughness, &gBuffer.depth })
+	{
+		vkDestroyImageView(device.device(), attachment->view, nullptr);
+		device.destroyImage(attachment->image, attachment->mem);
+		*attachment = {};
+	}
+	gBuffer.lightingSets.reset();
 }
 
 void SimpleRenderSystem::PrepareShadowPassRenderpass()
@@ -656,21 +1422,7 @@ void SimpleRenderSystem::PrepareShadowPassFramebuffer()
 		throw std::runtime_error("failed to create offscreen depth Image!");
 	}
 
-	VkMemoryAllocateInfo memAlloc{};
-	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	VkMemoryRequirements memReqs;
-
-	vkGetImageMemoryRequirements(m_Device.device(), m_ShadowPass.shadowMapImage.image, &memReqs);
-	memAlloc.allocationSize = memReqs.size;
-	memAlloc.memoryTypeIndex = m_Device.findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (vkAllocateMemory(m_Device.device(), &memAlloc, nullptr, &m_ShadowPass.shadowMapImage.mem) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate offscreen depth Image memory!");
-	}
-
-	if (vkBindImageMemory(m_Device.device(), m_ShadowPass.shadowMapImage.image, m_ShadowPass.shadowMapImage.mem, 0) != VK_SUCCESS) {
-		throw std::runtime_error("failed to bind offscreen depth Image memory!");
-	}
+	m_ShadowPass.shadowMapImage.mem = m_Device.getMemoryAllocator().AllocateForImage(m_ShadowPass.shadowMapImage.image, image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 	VkImageViewCreateInfo depthStencilView{};
 	depthStencilView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -729,33 +1481,8 @@ void SimpleRenderSystem::PrepareShadowPassFramebuffer()
 
 void SimpleRenderSystem::PrepareShadowPassUBO()
 {
-	//Direction Light Shadow Pass
-	//m_ShadowPassBuffer = std::make_unique<Buffer>(
-	//	m_Device,
-	//	sizeof(ShadowPassUBO),
-	//	1,
-	//	VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-	//	VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	//m_ShadowPassBuffer->map();
-
-	// Cascaded Shadow Map
-	m_CascadedShadowPassBuffer = std::make_unique<Buffer>(
-		m_Device,
-		sizeof(CascadedShadowPassUBO),
-		1,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	m_CascadedShadowPassBuffer->map();
-
-	//Point Light Shadow Pass
-	m_PointShadowPassBuffer = std::make_unique<Buffer>(
-		m_Device,
-		sizeof(PointShadowPassViewMatrixUBO),
-		1,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	m_PointShadowPassBuffer->map();
-
+	// Every shadow pass UBO is pushed to the frame uniform allocator while recording,
+	// only the point light face matrices are constant
 	float aspect = (float)m_PointShadowMapSize / (float)m_PointShadowMapSize;
 	glm::mat4 proj = glm::perspective(glm::radians(90.0f), aspect, 0.1f, 25.0f);
 	for (int i = 0; i < 6; i++)
@@ -785,36 +1512,15 @@ void SimpleRenderSystem::PrepareShadowPassUBO()
 		}
 		m_PointShadowPassUBO.faceViewMatrix[i] = proj * view;
 	}
-	m_PointShadowPassBuffer->writeToBuffer(&m_PointShadowPassUBO);
-	m_PointShadowPassBuffer->flush();
-
-	//Spot Shadow Pass
-	m_SpotShadowPassBuffer = std::make_unique<Buffer>(
-		m_Device,
-		sizeof(ShadowPassUBO),
-		MAX_SPOT_LIGHTS,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-		m_Device.properties.limits.minMemoryMapAlignment);
-	m_SpotShadowPassBuffer->map();
-
-	m_SpotShadowLightProjectionsBuffer = std::make_unique<Buffer>(
-		m_Device,
-		sizeof(SpotShadowLightProjectionsUBO),
-		1,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-	m_SpotShadowLightProjectionsBuffer->map();
 }
 
-void SimpleRenderSystem::UpdateShadowPassBuffer(GlobalUBO& globalUBO)
+void SimpleRenderSystem::UpdateShadowPassBuffer(FrameInfo& frameInfo, GlobalUBO& globalUBO)
 {
 	glm::mat4 orthgonalProjection = glm::ortho(-30.0f, 30.0f, -30.0f, 30.0f, 0.1f, 100.0f);
 	glm::mat4 lightView = glm::lookAt(glm::vec3(-globalUBO.directionalLightData.direction), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 	m_ShadowPassUBO.lightProjection = orthgonalProjection * lightView;
 
-	m_ShadowPassBuffer->writeToBuffer(&m_ShadowPassUBO);
-	m_ShadowPassBuffer->flush();
+	m_ShadowPassOffset = frameInfo.frameUniforms.Push(m_ShadowPassUBO);
 }
 
 void SimpleRenderSystem::PrepareCascadeShadowPass()
@@ -884,14 +1590,7 @@ void SimpleRenderSystem::PrepareCascadeShadowPass()
 	imageInfo.format = depthFormat;
 	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	vkCreateImage(m_Device.device(), &imageInfo, nullptr, &m_CascadedDepthMapObject.image);
-	VkMemoryAllocateInfo memAlloc{};
-	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	VkMemoryRequirements memReqs;
-	vkGetImageMemoryRequirements(m_Device.device(), m_CascadedDepthMapObject.image, &memReqs);
-	memAlloc.allocationSize = memReqs.size;
-	memAlloc.memoryTypeIndex = m_Device.findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	vkAllocateMemory(m_Device.device(), &memAlloc, nullptr, &m_CascadedDepthMapObject.mem);
-	vkBindImageMemory(m_Device.device(), m_CascadedDepthMapObject.image, m_CascadedDepthMapObject.mem, 0);
+	m_CascadedDepthMapObject.mem = m_Device.getMemoryAllocator().AllocateForImage(m_CascadedDepthMapObject.image, imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -954,7 +1653,8 @@ void SimpleRenderSystem::PrepareCascadeShadowPass()
 
 void SimpleRenderSystem::UpdateCascades(GlobalUBO& ubo)
 {
-	float cascadeSplits[CASCADE_SHADOW_MAP_COUNT];
+	float cascadeSplits[CASCADE_SHADOW_MAP_COUNT]{};
+	const uint32_t cascadeCount = m_ActiveCascadeCount;
 
 	float nearClip = 0.1f;
 	float farClip = 100.0f;
@@ -970,8 +1670,8 @@ void SimpleRenderSystem::UpdateCascades(GlobalUBO& ubo)
 
 	// Calculate split depths based on view camera frustum
 	// Based on method presented in https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch10.html
-	for (uint32_t i = 0; i < CASCADE_SHADOW_MAP_COUNT; i++) {
-		float p = (i + 1) / static_cast<float>(CASCADE_SHADOW_MAP_COUNT);
+	for (uint32_t i = 0; i < cascadeCount; i++) {
+		float p = (i + 1) / static_cast<float>(cascadeCount);
 		float log = minZ * std::pow(ratio, p);
 		float uniform = minZ + range * p;
 		float d = cascadeSplitLambda * (log - uniform) + uniform;
@@ -980,7 +1680,7 @@ void SimpleRenderSystem::UpdateCascades(GlobalUBO& ubo)
 
 	// Calculate orthographic projection matrix for each cascade
 	float lastSplitDist = 0.0;
-	for (uint32_t i = 0; i < CASCADE_SHADOW_MAP_COUNT; i++) {
+	for (uint32_t i = 0; i < cascadeCount; i++) {
 		float splitDist = cascadeSplits[i];
 
 		glm::vec3 frustumCorners[8] = {
@@ -1056,10 +1756,6 @@ void SimpleRenderSystem::PreparePointShadowCubeMaps()
 	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 
-	VkMemoryAllocateInfo memAllocInfo{};
-	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	VkMemoryRequirements memReqs;
-
 	VkCommandBuffer layoutCmd = m_Device.beginSingleTimeCommands();
 
 	// Create cube map image
@@ -1068,20 +1764,7 @@ void SimpleRenderSystem::PreparePointShadowCubeMaps()
 		throw std::runtime_error("failed to create Point Shadow cube map image!");
 	}
 
-	vkGetImageMemoryRequirements(m_Device.device(), m_PointShadowCubeMaps.cubeMapImage.image, &memReqs);
-
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = m_Device.findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (vkAllocateMemory(m_Device.device(), &memAllocInfo, nullptr, &m_PointShadowCubeMaps.cubeMapImage.mem))
-	{
-		throw std::runtime_error("failed to create Point Shadow mem alloc for cube map image");
-	}
-
-	if (vkBindImageMemory(m_Device.device(), m_PointShadowCubeMaps.cubeMapImage.image, m_PointShadowCubeMaps.cubeMapImage.mem, 0))
-	{
-		throw std::runtime_error("failed to create Point Shadow bind cube map memory");
-	}
+	m_PointShadowCubeMaps.cubeMapImage.mem = m_Device.getMemoryAllocator().AllocateForImage(m_PointShadowCubeMaps.cubeMapImage.image, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 	// Image barrier for optimal image (target)
 	VkImageSubresourceRange subresourceRange = {};
@@ -1256,23 +1939,7 @@ void SimpleRenderSystem::PreparePointShadowPassFramebuffers()
 		throw std::runtime_error("failed to create Point Shadow depth stencil attachment!");
 	}
 
-	VkMemoryRequirements memReqs;
-	vkGetImageMemoryRequirements(m_Device.device(), m_PointShadowPass.pointShadowMapImage.image, &memReqs);
-
-	VkMemoryAllocateInfo memAlloc{};
-	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAlloc.allocationSize = memReqs.size;
-	memAlloc.memoryTypeIndex = m_Device.findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (vkAllocateMemory(m_Device.device(), &memAlloc, nullptr, &m_PointShadowPass.pointShadowMapImage.mem))
-	{
-		throw std::runtime_error("failed to create Point Shadow mem alloc for Map Image");
-	}
-
-	if (vkBindImageMemory(m_Device.device(), m_PointShadowPass.pointShadowMapImage.image, m_PointShadowPass.pointShadowMapImage.mem, 0))
-	{
-		throw std::runtime_error("failed to create Point Shadow bind image memory");
-	}
+	m_PointShadowPass.pointShadowMapImage.mem = m_Device.getMemoryAllocator().AllocateForImage(m_PointShadowPass.pointShadowMapImage.image, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 	VkImageAspectFlags temp = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
 	m_Device.TransitionImageLayout(
@@ -1334,14 +2001,16 @@ void SimpleRenderSystem::updateCubeFace(uint32_t faceIndex, FrameInfo frameInfo,
 
 
 	// Render scene from cube face's point of view
-	vkCmdBeginRenderPass(frameInfo.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	CmdBeginRenderPass(frameInfo.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-	m_PointShadowPassPipeline->bind(frameInfo.commandBuffer);
-
-	std::vector<VkDescriptorSet> globSet = { frameInfo.globalDescriptorSet, m_PointShadowPassDescriptorSet };
-	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PointShadowPassPipelineLayout, 0, globSet.size(), globSet.data(), 0, nullptr);
+	if (m_PointShadowPassPipeline->bind(frameInfo.commandBuffer))
+	{
+		std::array<VkDescriptorSet, 2> globSet = { frameInfo.globalDescriptorSet, m_PointShadowPassDescriptorSet };
+		std::array<uint32_t, 2> dynamicOffsets = { frameInfo.globalUBOOffset, m_PointShadowPassOffset };
+		CmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PointShadowPassPipelineLayout, 0, globSet.size(), globSet.data(), dynamicOffsets.size(), dynamicOffsets.data());
 
-	RenderGameObjects(frameInfo.commandBuffer, m_PointShadowPassPipelineLayout, PushConstantType::POINTSHADOW, globSet.size(), false);
+		RenderGameObjects(frameInfo, m_PointShadowPassPipelineLayout, PushConstantType::POINTSHADOW);
+	}
 
 	vkCmdEndRenderPass(frameInfo.commandBuffer);
 }
@@ -1366,10 +2035,6 @@ void SimpleRenderSystem::PrepareSpotShadowMaps()
 	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	//imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 
-	VkMemoryAllocateInfo memAllocInfo{};
-	memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	VkMemoryRequirements memReqs;
-
 	VkCommandBuffer layoutCmd = m_Device.beginSingleTimeCommands();
 
 	// Create cube map image
@@ -1378,20 +2043,7 @@ void SimpleRenderSystem::PrepareSpotShadowMaps()
 		throw std::runtime_error("failed to create Spot Shadow map image!");
 	}
 
-	vkGetImageMemoryRequirements(m_Device.device(), m_SpotShadowMaps.cubeMapImage.image, &memReqs);
-
-	memAllocInfo.allocationSize = memReqs.size;
-	memAllocInfo.memoryTypeIndex = m_Device.findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (vkAllocateMemory(m_Device.device(), &memAllocInfo, nullptr, &m_SpotShadowMaps.cubeMapImage.mem))
-	{
-		throw std::runtime_error("failed to create Point Shadow mem alloc for cube map image");
-	}
-
-	if (vkBindImageMemory(m_Device.device(), m_SpotShadowMaps.cubeMapImage.image, m_SpotShadowMaps.cubeMapImage.mem, 0))
-	{
-		throw std::runtime_error("failed to create Spot Shadow bind map memory");
-	}
+	m_SpotShadowMaps.cubeMapImage.mem = m_Device.getMemoryAllocator().AllocateForImage(m_SpotShadowMaps.cubeMapImage.image, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 	// Image barrier for optimal image (target)
 	VkImageSubresourceRange subresourceRange = {};
@@ -1574,23 +2226,7 @@ void SimpleRenderSystem::PrepareSpotShadowPassFramebuffers()
 		throw std::runtime_error("failed to create Point Shadow depth stencil attachment!");
 	}
 
-	VkMemoryRequirements memReqs;
-	vkGetImageMemoryRequirements(m_Device.device(), m_SpotShadowPass.spotShadowMapImage.image, &memReqs);
-
-	VkMemoryAllocateInfo memAlloc{};
-	memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memAlloc.allocationSize = memReqs.size;
-	memAlloc.memoryTypeIndex = m_Device.findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (vkAllocateMemory(m_Device.device(), &memAlloc, nullptr, &m_SpotShadowPass.spotShadowMapImage.mem))
-	{
-		throw std::runtime_error("failed to create Point Shadow mem alloc for Map Image");
-	}
-
-	if (vkBindImageMemory(m_Device.device(), m_SpotShadowPass.spotShadowMapImage.image, m_SpotShadowPass.spotShadowMapImage.mem, 0))
-	{
-		throw std::runtime_error("failed to create Point Shadow bind image memory");
-	}
+	m_SpotShadowPass.spotShadowMapImage.mem = m_Device.getMemoryAllocator().AllocateForImage(m_SpotShadowPass.spotShadowMapImage.image, imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 	VkImageAspectFlags temp = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
 	m_Device.TransitionImageLayout(
@@ -1644,8 +2280,7 @@ void SimpleRenderSystem::UpdateSpotShadowMaps(uint32_t lightIndex, FrameInfo fra
 	sUbo.lightProjection = proj * view;
 	m_SpotShadowLightProjectionsUBO.lightProjections[lightIndex] = sUbo.lightProjection;
 
-	m_SpotShadowPassBuffer->writeToIndex(&sUbo, lightIndex);
-	m_SpotShadowPassBuffer->flushIndex(lightIndex);
+	uint32_t spotShadowPassOffset = frameInfo.frameUniforms.Push(sUbo);
 
 	VkClearValue clearValues[2];
 	clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
@@ -1662,16 +2297,16 @@ void SimpleRenderSystem::UpdateSpotShadowMaps(uint32_t lightIndex, FrameInfo fra
 
 
 	// Render scene from cube face's point of view
-	vkCmdBeginRenderPass(frameInfo.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-	m_SpotShadowPassPipeline->bind(frameInfo.commandBuffer);
-
-	std::vector<VkDescriptorSet> globSet = { frameInfo.globalDescriptorSet, m_SpotShadowPassDescriptorSet };
-	std::vector<uint32_t> dynamicOffset = { static_cast<uint32_t>(lightIndex * m_SpotShadowPassBuffer->getAlignmentSize()) };
-	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_SpotShadowPassPipelineLayout, 0, globSet.size(), globSet.data(), dynamicOffset.size(), dynamicOffset.data());
+	CmdBeginRenderPass(frameInfo.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
+	if (m_SpotShadowPassPipeline->bind(frameInfo.commandBuffer))
+	{
+		std::array<VkDescriptorSet, 2> globSet = { frameInfo.globalDescriptorSet, m_SpotShadowPassDescriptorSet };
+		std::array<uint32_t, 2> dynamicOffsets = { frameInfo.globalUBOOffset, spotShadowPassOffset };
+		CmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_SpotShadowPassPipelineLayout, 0, globSet.size(), globSet.data(), dynamicOffsets.size(), dynamicOffsets.data());
 
-	RenderGameObjects(frameInfo.commandBuffer, m_SpotShadowPassPipelineLayout, PushConstantType::SPOTSHADOW, globSet.size(), false);
+		RenderGameObjects(frameInfo, m_SpotShadowPassPipelineLayout, PushConstantType::SPOTSHADOW);
+	}
 
 	vkCmdEndRenderPass(frameInfo.commandBuffer);
 }
@@ -1679,6 +2314,8 @@ void SimpleRenderSystem::UpdateSpotShadowMaps(uint32_t lightIndex, FrameInfo fra
 void SimpleRenderSystem::RenderSpotShadowPass(FrameInfo frameInfo, GlobalUBO& ubo)
 {
 	PROFILE_FUNCTION();
+	PROFILE_GPU_SCOPE(frameInfo.gpuProfiler, frameInfo.commandBuffer, "SpotShadowPass");
+	PROFILE_RENDER_STATS("SpotShadowPass");
 	VkViewport viewport{};
 	viewport.width = (float)m_SpotShadowPass.width;
 	viewport.height = (float)m_SpotShadowPass.height;
@@ -1698,4 +2335,7 @@ void SimpleRenderSystem::RenderSpotShadowPass(FrameInfo frameInfo, GlobalUBO& ub
 		m_SpotLightIndex = i;
 		UpdateSpotShadowMaps(i, frameInfo, ubo);
 	}
+
+	// Projections of every light, read by the lighting pass of this frame
+	m_SpotShadowLightProjectionsOffset = frameInfo.frameUniforms.Push(m_SpotShadowLightProjectionsUBO);
 }
\ No newline at end of file
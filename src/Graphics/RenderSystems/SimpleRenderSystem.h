@@ -2,14 +2,19 @@
 
 #include "../Device.h"
 #include "../FrameInfo.h"
-#include "../Pipeline.h"
+#include "../PipelineManager.h"
 #include "../Camera.h"
 #include "../../Components.h"
 #include "../Descriptor.h"
+#include "../FrameUniformAllocator.h"
 #include "../SwapChain.h"
+#include "../OcclusionCuller.h"
 
 #include <memory>
 #include <vector>
+#include <bitset>
+#include <string>
+#include <unordered_map>
 
 #define CASCADE_SHADOW_MAP_COUNT 4
 
@@ -25,9 +30,52 @@ public:
 		CASCADEDSHADOW = 3
 	};
 
+	enum class DepthPrepassMode
+	{
+		OFF = 0,
+		ON = 1,
+		AUTO = 2	// Enabled while measured overdraw is high
+	};
+
+	enum class ShadowQuality
+	{
+		LOW = 0,
+		MEDIUM = 1,
+		HIGH = 2
+	};
+
+	// Baked into the lighting shaders as specialization constants, see GetShadowSettings
+	struct ShadowSettings
+	{
+		uint32_t cascadeCount;			// Cascades rendered and sampled, at most CASCADE_SHADOW_MAP_COUNT
+		int32_t cascadePcfRadius;		// (2r + 1)^2 taps
+		int32_t spotPcfRadius;
+		int32_t pointShadowSamples;		// Taps of the point shadow sampling disk, at most 20
+		bool directionalShadows;
+		bool pointShadows;
+		bool spotShadows;
+	};
+
+	// Pipelines running Basic.frag / DeferredLighting.frag, each one has a variant per shadow quality and light types present
+	enum LightingPass : uint32_t
+	{
+		LIGHTING_MAIN = 0,
+		LIGHTING_MAIN_DEPTH_EQUAL = 1,
+		LIGHTING_DEFERRED = 2,
+		LIGHTING_PASS_COUNT
+	};
+
+	struct LightingVariant
+	{
+		LightingPass pass;
+		ShadowQuality quality;
+		bool pointLights;
+		bool spotLights;
+	};
+
 	struct ShadowFrameBufferAttachment {
 		VkImage image;
-		VkDeviceMemory mem;
+		MemoryAllocation mem;
 		VkImageView view;
 	};
 	struct ShadowPass {
@@ -61,7 +109,7 @@ public:
 	struct CascadedDepthMap
 	{
 		VkImage image;
-		VkDeviceMemory mem;
+		MemoryAllocation mem;
 		VkImageView view;
 		VkSampler sampler;
 	};
@@ -108,11 +156,26 @@ public:
 		std::array<glm::mat4, MAX_SPOT_LIGHTS> lightProjections;
 	};
 
+	struct GBuffer
+	{
+		uint32_t width, height;
+		ShadowFrameBufferAttachment albedo;
+		ShadowFrameBufferAttachment normal;
+		ShadowFrameBufferAttachment metallicRoughness;
+		ShadowFrameBufferAttachment depth;
+		VkFramebuffer frameBuffer;
+		VkRenderPass renderPass;
+		VkSampler sampler;
+		std::shared_ptr<DescriptorSetCache> lightingSets;	// Sets reading these attachments, retired with them
+	};
+
 	SimpleRenderSystem(
 		Device& device,
 		VkRenderPass renderPass, 
 		std::vector<VkDescriptorSetLayout> setLayouts,
-		DescriptorPool& descriptorPool);
+		DescriptorAllocator& descriptorAllocator,
+		FrameUniformAllocator& frameUniforms,
+		RenderPath renderPath = RenderPath::FORWARD);
 	~SimpleRenderSystem();
 
 	SimpleRenderSystem(const SimpleRenderSystem&) = delete;
@@ -124,17 +187,64 @@ public:
 	void RenderSpotShadowPass(FrameInfo frameInfo, GlobalUBO& globalUBO);
 	void RenderMainPass(FrameInfo frameInfo);
 
-	void RenderGameObjects(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, PushConstantType type, int setCount, bool renderMaterial = true);
+	// Must be recorded outside of a render pass, before RenderMainPass
+	void UpdateDepthPrepass(FrameInfo frameInfo, VkExtent2D extent);
+	void SetDepthPrepassMode(DepthPrepassMode mode) { m_DepthPrepassMode = mode; }
+	DepthPrepassMode GetDepthPrepassMode() const { return m_DepthPrepassMode; }
+	bool IsDepthPrepassActive() const { return m_DepthPrepassActive; }
+	float GetMeasuredOverdraw() const { return m_MeasuredOverdraw; }
+
+	// Deferred path : G-buffer pass is recorded outside of a render pass, lighting inside the swapchain render pass
+	void RenderGBufferPass(FrameInfo frameInfo, VkExtent2D extent);
+	void RenderDeferredLightingPass(FrameInfo frameInfo);
+	RenderPath GetRenderPath() const { return m_RenderPath; }
+
+	// Picks the lighting pipeline variants for the shadow quality and the light types in the ubo,
+	// falls back to the variant with every light type until they are built. Call before recording any pass
+	void SelectLightingVariants(const GlobalUBO& ubo);
+	void SetShadowQuality(ShadowQuality quality) { m_ShadowQuality = quality; }
+	ShadowQuality GetShadowQuality() const { return m_ShadowQuality; }
+	static ShadowSettings GetShadowSettings(ShadowQuality quality);
+
+	// Simulation thread : copies the entities to draw out of the ECS, every other call reads the copy in FrameInfo::snapshot
+	void GatherRenderObjects(std::vector<RenderObject>& objects) const;
+
+	// Picks a level of detail per entity from its projected size, call before recording any pass
+	void UpdateLodSelection(FrameInfo frameInfo);
+	void SetShadowLodBias(uint32_t bias) { m_ShadowLodBias = bias; }
+	uint32_t GetEntityLod(Entity entity) const { return m_EntityLods[entity]; }
+
+	// Rasterizes occluder entities on the CPU and tests everything else against them, call before recording camera passes
+	void UpdateOcclusionCulling(FrameInfo frameInfo);
+	void SetOcclusionCullingEnabled(bool enabled) { m_OcclusionCullingEnabled = enabled; }
+	bool IsOcclusionCullingEnabled() const { return m_OcclusionCullingEnabled; }
+	uint32_t GetOccludedEntityCount() const { return m_OccludedEntityCount; }
+
+	// occlusionCull skips entities hidden from the camera, shadow passes leave it off
+	void RenderGameObjects(const FrameInfo& frameInfo, VkPipelineLayout pipelineLayout, PushConstantType type, bool occlusionCull = false);
 
 private:
-	void createPipelineLayout(std::vector<VkDescriptorSetLayout> setLayouts, DescriptorPool& descriptorPool);
+	void createPipelineLayout(std::vector<VkDescriptorSetLayout> setLayouts, DescriptorAllocator& descriptorAllocator, FrameUniformAllocator& frameUniforms);
 	void createPipeline(VkRenderPass renderpass);
 
+	void SetLightingPassSource(LightingPass pass, const std::string& vertexPath, const std::string& fragPath, const PipelineConfigInfo& configInfo);
+	// Requested on first use, later calls return the same pipeline
+	std::shared_ptr<AsyncPipeline> GetLightingVariant(const LightingVariant& variant);
+
+	void PrepareDepthPrepass();
+	void RenderDepthPrepass(FrameInfo frameInfo);
+
+	void PrepareGBufferRenderPass();
+	void PrepareGBufferAttachments(VkExtent2D extent);
+	void CreateGBufferAttachment(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask, ShadowFrameBufferAttachment& attachment);
+	// Static so a deferred destroy can outlive the render system
+	static void DestroyGBufferAttachments(Device& device, GBuffer& gBuffer);
+
 	void PrepareShadowPassUBO();
 
 	void PrepareShadowPassRenderpass();
 	void PrepareShadowPassFramebuffer();
-	void UpdateShadowPassBuffer(GlobalUBO& globalUBO);
+	void UpdateShadowPassBuffer(FrameInfo& frameInfo, GlobalUBO& globalUBO);
 
 	void PrepareCascadeShadowPass();
 	void UpdateCascades(GlobalUBO& ubo);
@@ -152,12 +262,79 @@ private:
 	void UpdateSpotShadowMaps(uint32_t lightIndex, FrameInfo frameInfo, GlobalUBO& ubo);
 
 	Device& m_Device;
-	// Main Pipeline variables
-	std::unique_ptr<Pipeline> m_MainPipeline;
+	DescriptorAllocator& m_DescriptorAllocator;
+	RenderPath m_RenderPath;
+
+	// Lighting variants
+	struct LightingPassSource
+	{
+		std::string vertexPath;
+		std::string fragPath;
+		PipelineConfigInfo configInfo;
+	};
+	std::array<LightingPassSource, LIGHTING_PASS_COUNT> m_LightingPassSources;
+	std::unordered_map<uint32_t, std::shared_ptr<AsyncPipeline>> m_LightingVariants;
+
+	// Every light type present, valid for any scene while a narrower variant builds
+	std::array<std::shared_ptr<AsyncPipeline>, LIGHTING_PASS_COUNT> m_FallbackLightingPipelines;
+	ShadowQuality m_FallbackShadowQuality = ShadowQuality::HIGH;
+
+	ShadowQuality m_ShadowQuality = ShadowQuality::HIGH;
+	ShadowQuality m_ActiveShadowQuality = ShadowQuality::HIGH;		// Of the variants selected for this frame
+	uint32_t m_ActiveCascadeCount = CASCADE_SHADOW_MAP_COUNT;
+
+	// Main Pipeline variables, the selected lighting variants
+	std::shared_ptr<AsyncPipeline> m_MainPipeline;
 	VkPipelineLayout m_MainPipelineLayout;
 
 	VkDescriptorSet m_ShadowMapDescriptorSet;
 
+	// Depth Prepass variables
+	std::shared_ptr<AsyncPipeline> m_DepthPrepassPipeline;
+	std::shared_ptr<AsyncPipeline> m_MainDepthEqualPipeline;
+
+	DepthPrepassMode m_DepthPrepassMode = DepthPrepassMode::AUTO;
+	bool m_DepthPrepassActive = false;
+
+	// One occlusion query per frame in flight, counts samples passing the first depth writing pass
+	VkQueryPool m_OverdrawQueryPool = VK_NULL_HANDLE;
+	std::array<bool, SwapChain::MAX_FRAMES_IN_FLIGHT> m_OverdrawQueryIssued{};
+	float m_MeasuredOverdraw = 0.0f;
+
+	// Hysteresis so AUTO doesn't flip every frame
+	const float m_DepthPrepassEnableOverdraw{ 1.5f };
+	const float m_DepthPrepassDisableOverdraw{ 1.2f };
+
+	// Deferred variables
+	std::shared_ptr<AsyncPipeline> m_GBufferPipeline;
+	VkPipelineLayout m_GBufferPipelineLayout = VK_NULL_HANDLE;
+
+	std::shared_ptr<AsyncPipeline> m_DeferredLightingPipeline;
+	VkPipelineLayout m_DeferredLightingPipelineLayout = VK_NULL_HANDLE;
+
+	std::unique_ptr<DescriptorSetLayout> m_GBufferSetLayout;
+
+	GBuffer m_GBuffer{};
+	const VkFormat m_GBufferAlbedoFormat{ VK_FORMAT_R8G8B8A8_UNORM };
+	const VkFormat m_GBufferNormalFormat{ VK_FORMAT_R16G16_SNORM };				// Octahedral encoded
+	const VkFormat m_GBufferMetallicRoughnessFormat{ VK_FORMAT_R8G8_UNORM };
+
+	// LOD variables
+	std::array<uint8_t, MAX_ENTITIES> m_EntityLods{};
+
+	// Projected bounding sphere radius (1 = half the screen height) under which LOD i + 1 is used
+	const std::array<float, Model::MAX_LOD_COUNT - 1> m_LodScreenSizes{ 0.5f, 0.25f, 0.125f };
+	const float m_LodHysteresis{ 0.1f };
+
+	// Shadow passes add this to the camera LOD
+	uint32_t m_ShadowLodBias = 1;
+
+	// CPU occlusion culling variables
+	OcclusionCuller m_OcclusionCuller;
+	std::bitset<MAX_ENTITIES> m_OccludedEntities;
+	bool m_OcclusionCullingEnabled = true;
+	uint32_t m_OccludedEntityCount = 0;
+
 	CascadedDepthMap m_CascadedDepthMapObject;
 	VkDescriptorSet m_CascadedShadowMapDescriptorSet;
 
@@ -168,29 +345,29 @@ private:
 	VkDescriptorSet m_SpotShadowMapDescriptorSet;
 
 	SpotShadowLightProjectionsUBO m_SpotShadowLightProjectionsUBO{};
-	std::unique_ptr<Buffer> m_SpotShadowLightProjectionsBuffer;
+	uint32_t m_SpotShadowLightProjectionsOffset = 0;	// Dynamic offsets into this frame's uniforms
 	VkDescriptorSet m_SpotShadowLightProjectionsDescriptorSet;
 
 	// Directional Shadow variables
-	std::unique_ptr<Pipeline> m_ShadowPassPipeline;
+	std::shared_ptr<AsyncPipeline> m_ShadowPassPipeline;
 	VkPipelineLayout m_ShadowPassPipelineLayout;
 
 	const VkFormat m_ShadowPassImageFormat{ VK_FORMAT_D16_UNORM };
 	const uint32_t m_ShadowMapSize{ 4096 };
 
 	ShadowPassUBO m_ShadowPassUBO;
-	std::unique_ptr<Buffer> m_ShadowPassBuffer;
+	uint32_t m_ShadowPassOffset = 0;
 	VkDescriptorSet m_ShadowPassDescriptorSet;
 
 	ShadowPass m_ShadowPass{};
 
 	// Cascaded Shadow Map
-	std::unique_ptr<Pipeline> m_CascadedShadowPassPipeline;
+	std::shared_ptr<AsyncPipeline> m_CascadedShadowPassPipeline;
 	VkPipelineLayout m_CascadedShadowPassPipelineLayout;
 
 	const uint32_t m_CascadedShadowMapSize{4096};
 
-	std::unique_ptr<Buffer> m_CascadedShadowPassBuffer;
+	uint32_t m_CascadedShadowPassOffset = 0;
 	VkDescriptorSet m_CascadedShadowPassDescriptorSet;
 
 	CascadedShadowPass m_CascadedShadowPass{};
@@ -198,7 +375,7 @@ private:
 	int m_CascadeIndex = 0;
 
 	//Point Shadow variables
-	std::unique_ptr<Pipeline> m_PointShadowPassPipeline;
+	std::shared_ptr<AsyncPipeline> m_PointShadowPassPipeline;
 	VkPipelineLayout m_PointShadowPassPipelineLayout;
 
 	const uint32_t m_PointShadowMapSize{ 1024 };
@@ -206,7 +383,7 @@ private:
 	VkFormat m_PointShadowPassDepthFormat{ VK_FORMAT_UNDEFINED };
 
 	PointShadowPassViewMatrixUBO m_PointShadowPassUBO {};
-	std::unique_ptr<Buffer> m_PointShadowPassBuffer;
+	uint32_t m_PointShadowPassOffset = 0;
 	VkDescriptorSet m_PointShadowPassDescriptorSet;
 
 	PointShadowPass m_PointShadowPass{};
@@ -215,7 +392,7 @@ private:
 	int m_FaceCount = 0;
 
 	//Spot Shadow variables
-	std::unique_ptr<Pipeline> m_SpotShadowPassPipeline;
+	std::shared_ptr<AsyncPipeline> m_SpotShadowPassPipeline;
 	VkPipelineLayout m_SpotShadowPassPipelineLayout;
 
 	const uint32_t m_SpotShadowMapSize{ 1024 };
@@ -223,7 +400,6 @@ private:
 	VkFormat m_SpotShadowPassDepthFormat{ VK_FORMAT_UNDEFINED };
 
 	ShadowPassUBO m_SpotShadowPassUBO;
-	std::unique_ptr<Buffer> m_SpotShadowPassBuffer;
 	VkDescriptorSet m_SpotShadowPassDescriptorSet;
 
 	SpotShadowPass m_SpotShadowPass{};
@@ -1,14 +1,24 @@
 #include "Renderer.h"
+#include "RenderStats.h"
 #include "../Instrumentation.h"
 
 #include <array>
 #include <cassert>
 #include <stdexcept>
+#include <thread>
 
-Renderer::Renderer(Window& window, Device& device) :m_Window(window), m_Device(device)
+Renderer::Renderer(Window& window, Device& device, const PresentSettings& presentSettings) 
+	:m_Window(window), m_Device(device), m_PresentSettings(presentSettings)
 {
-	recreateSwapChain();
+	// Still on the main thread here, events can be waited on until the window has a size
+	while (!recreateSwapChain())
+	{
+		glfwWaitEvents();
+	}
 	createCommandBuffers();
+
+	m_FrameUniforms = std::make_unique<FrameUniformAllocator>(m_Device, SwapChain::MAX_FRAMES_IN_FLIGHT);
+	m_GpuProfiler = std::make_unique<GpuProfiler>(m_Device);
 }
 
 Renderer::~Renderer()
@@ -16,10 +26,59 @@ Renderer::~Renderer()
 	freeCommandBuffers();
 }
 
+void Renderer::SetPresentMode(PresentMode presentMode)
+{
+	m_PresentSettings.presentMode = presentMode;
+	m_SwapChainSettingsChanged = true;
+}
+
+void Renderer::SetFramesInFlight(int framesInFlight)
+{
+	assert(framesInFlight >= 1 && framesInFlight <= SwapChain::MAX_FRAMES_IN_FLIGHT && "Frames in flight must be between 1 and SwapChain::MAX_FRAMES_IN_FLIGHT");
+	m_PresentSettings.framesInFlight = framesInFlight;
+	m_SwapChainSettingsChanged = true;
+}
+
+void Renderer::LimitFrameRate()
+{
+	PROFILE_FUNCTION();
+	using Clock = std::chrono::high_resolution_clock;
+
+	if (m_PresentSettings.frameRateLimit <= 0.0f)
+	{
+		m_NextFrameTime = Clock::time_point{};
+		return;
+	}
+
+	auto frameDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_PresentSettings.frameRateLimit));
+	auto now = Clock::now();
+	// First limited frame, or more than a frame behind : start over instead of rushing to catch up
+	if (m_NextFrameTime == Clock::time_point{} || now > m_NextFrameTime + frameDuration)
+	{
+		m_NextFrameTime = now;
+	}
+
+	// sleep_for can overshoot by a scheduler tick, so sleep coarsely and yield through the rest
+	while (Clock::now() + std::chrono::milliseconds(2) < m_NextFrameTime)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	while (Clock::now() < m_NextFrameTime)
+	{
+		std::this_thread::yield();
+	}
+	m_NextFrameTime += frameDuration;
+}
+
 VkCommandBuffer Renderer::BeginFrame()
 {
 	assert(!isFrameStarted && "Cannot call Begin Frame while already in progress");
 
+	if ((m_SwapChainSettingsChanged || m_SwapChainRecreatePending) && !recreateSwapChain())
+	{
+		return nullptr;
+	}
+
 	auto result = m_SwapChain->acquireNextImage(&currentImageIndex);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR)
@@ -32,6 +91,12 @@ VkCommandBuffer Renderer::BeginFrame()
 		throw std::runtime_error("Failed to acquire swap chain image");
 	}
 	isFrameStarted = true;
+	currentFrameIndex = m_SwapChain->getCurrentFrame();
+	updateInputLatency();
+	m_Device.getGraphicsTimeline().CollectGarbage();
+
+	// acquireNextImage waited for this frame slot's timeline value, nothing in flight reads its uniforms anymore
+	m_FrameUniforms->BeginFrame(currentFrameIndex);
 
 	auto commandBuffer = GetCurrentCommandBuffer();
 	VkCommandBufferBeginInfo beginInfo{};
@@ -41,6 +106,8 @@ VkCommandBuffer Renderer::BeginFrame()
 	{
 		throw std::runtime_error("Failed to begin recording command buffer");
 	}
+	m_GpuProfiler->BeginFrame(commandBuffer, currentFrameIndex);
+	m_FrameGpuScope = m_GpuProfiler->BeginScope(commandBuffer, "Frame");
 	return commandBuffer;
 }
 
@@ -49,13 +116,20 @@ void Renderer::EndFrame()
 	PROFILE_FUNCTION();
 	assert(isFrameStarted && "Cannot call End Frame while frame is not in progress");
 
+	// One flush for every uniform written while recording
+	m_FrameUniforms->Flush();
+
 	auto commandBuffer = GetCurrentCommandBuffer();
+	m_GpuProfiler->EndScope(commandBuffer, m_FrameGpuScope);
 	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to recording command buffer");
 	}
 
 	auto result = m_SwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+	m_GpuProfiler->EndFrame(m_Device.getGraphicsTimeline().GetSubmittedValue());
+	m_FrameInputTimes[currentFrameIndex] = m_InputSampleTime;
+	m_FrameLatencyPending[currentFrameIndex] = true;
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_Window.WasWindowResized())
 	{
@@ -68,7 +142,6 @@ void Renderer::EndFrame()
 
 	}
 	isFrameStarted = false;
-	currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
 }
 
 void Renderer::BeginSwapChainRenderPass(VkCommandBuffer commandBuffer)
@@ -83,13 +156,13 @@ void Renderer::BeginSwapChainRenderPass(VkCommandBuffer commandBuffer)
 	renderPassInfo.renderArea.offset = { 0, 0 };
 	renderPassInfo.renderArea.extent = m_SwapChain->getSwapChainExtent();
 
-	std::vector<VkClearValue> clearValues(2);
+	std::array<VkClearValue, 2> clearValues{};
 	clearValues[0].color = { 0.1f, 0.1f, 0.1f, 1.0f };
 	clearValues[1].depthStencil = { 1.0f, 0 };
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	CmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 	VkViewport viewport{};
 	viewport.x = 0.0f;
@@ -135,29 +208,56 @@ void Renderer::freeCommandBuffers()
 	m_CommandBuffers.clear();
 }
 
-void Renderer::recreateSwapChain()
+bool Renderer::recreateSwapChain()
 {
+	// Minimized : never wait here, the render thread holds a snapshot the simulation needs back to keep polling events
 	auto extent = m_Window.GetExtent();
-	while (extent.width == 0 || extent.height == 0)
+	if (extent.width == 0 || extent.height == 0)
 	{
-		extent = m_Window.GetExtent();
-		glfwWaitEvents();
+		m_SwapChainRecreatePending = true;
+		return false;
 	}
 
-	vkDeviceWaitIdle(m_Device.device());
+	m_SwapChainRecreatePending = false;
+	m_SwapChainSettingsChanged = false;
 	if (m_SwapChain == nullptr)
 	{
-		m_SwapChain = std::make_unique<SwapChain>(m_Device, extent);
+		m_SwapChain = std::make_unique<SwapChain>(m_Device, extent, m_PresentSettings);
 	}
 	else
 	{
+		// No device wait : the new swap chain retires the old one through oldSwapchain and inherits its frame slots
 		std::shared_ptr<SwapChain> oldSwapChain = std::move(m_SwapChain);
-		m_SwapChain = std::make_unique<SwapChain>(m_Device, extent, oldSwapChain);
+		m_SwapChain = std::make_unique<SwapChain>(m_Device, extent, m_PresentSettings, oldSwapChain);
 
 		if (!oldSwapChain->compareSwapFormats(*m_SwapChain.get()))
 		{
 			throw std::runtime_error("Swap chain image(or depth) format has changed!");
 		}
+
+		// Slots were collapsed onto the newest frame, the pending ones can't be told apart anymore
+		if (oldSwapChain->getFramesInFlight() != m_SwapChain->getFramesInFlight())
+		{
+			m_FrameLatencyPending.fill(false);
+		}
+
+		// Frames in flight still render to its attachments and present its images
+		m_Device.getGraphicsTimeline().DeferDestroy([oldSwapChain]() mutable { oldSwapChain.reset(); });
+	}
+	return true;
+}
+
+void Renderer::updateInputLatency()
+{
+	// Completion is only observed here, once per frame, so a frame that finished early reads up to a frame late
+	auto now = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < m_SwapChain->getFramesInFlight(); i++)
+	{
+		if (m_FrameLatencyPending[i] && m_SwapChain->isFrameComplete(i))
+		{
+			m_FrameLatencyPending[i] = false;
+			m_InputLatency = std::chrono::duration<float, std::chrono::seconds::period>(now - m_FrameInputTimes[i]).count();
+			PROFILE_COUNTER("InputLatency(ms)", m_InputLatency * 1000.0f);
+		}
 	}
-	// we'll come back to this
 }
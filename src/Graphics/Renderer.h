@@ -2,16 +2,21 @@
 
 #include "Device.h"
 #include "SwapChain.h"
+#include "Descriptor.h"
+#include "FrameUniformAllocator.h"
+#include "GpuProfiler.h"
 #include "../Window.h"
 
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <memory>
 #include <vector>
 
 class Renderer
 {
 public:
-	Renderer(Window& window, Device& device);
+	Renderer(Window& window, Device& device, const PresentSettings& presentSettings = PresentSettings{});
 	~Renderer();
 
 	Renderer(const Renderer&) = delete;
@@ -19,6 +24,7 @@ public:
 
 	VkRenderPass GetSwapChainRenderPass() const { return m_SwapChain->getRenderPass(); }
 	float GetAspectRatio() const { return m_SwapChain->extentAspectRatio(); }
+	VkExtent2D GetSwapChainExtent() const { return m_SwapChain->getSwapChainExtent(); }
 	bool IsFrameInProgress() const { return isFrameStarted; }
 	VkCommandBuffer GetCurrentCommandBuffer() const 
 	{
@@ -32,6 +38,27 @@ public:
 		return currentFrameIndex;
 	}
 
+	// Reset by BeginFrame and flushed by EndFrame, the descriptor info is valid outside a frame
+	FrameUniformAllocator& GetFrameUniformAllocator() const { return *m_FrameUniforms; }
+	// Passes wrap themselves in PROFILE_GPU_SCOPE, the whole frame is timed as "Frame"
+	GpuProfiler& GetGpuProfiler() const { return *m_GpuProfiler; }
+
+	// Present mode and frames in flight take effect on the next BeginFrame, which recreates the swap chain
+	void SetPresentMode(PresentMode presentMode);
+	void SetFramesInFlight(int framesInFlight);
+	void SetFrameRateLimit(float framesPerSecond) { m_PresentSettings.frameRateLimit = framesPerSecond; }
+	// Mode actually in use, after fallback
+	PresentMode GetPresentMode() const { return m_SwapChain->getPresentMode(); }
+	int GetFramesInFlight() const { return m_SwapChain->getFramesInFlight(); }
+
+	// Simulation thread, call before polling input, sleeps until the frame rate limit allows the next frame
+	void LimitFrameRate();
+	// Call before BeginFrame with the time the frame's input was polled, its latency is measured from there
+	void MarkInputSampled(std::chrono::high_resolution_clock::time_point sampleTime) { m_InputSampleTime = sampleTime; }
+	// Seconds from input sampling to the GPU finishing the frame that used it, latest measured frame
+	float GetInputLatency() const { return m_InputLatency; }
+
+	// Null when no frame can be recorded, out of date or minimized swap chain : skip the frame
 	VkCommandBuffer BeginFrame();
 	void EndFrame();
 
@@ -41,12 +68,27 @@ public:
 private:
 	void createCommandBuffers();
 	void freeCommandBuffers();
-	void recreateSwapChain();
+	// False while the window is minimized, BeginFrame retries on a later frame
+	bool recreateSwapChain();
+	void updateInputLatency();
 
 	Window& m_Window;
 	Device& m_Device;
 	std::unique_ptr<SwapChain> m_SwapChain;
 	std::vector<VkCommandBuffer> m_CommandBuffers;
+	std::unique_ptr<FrameUniformAllocator> m_FrameUniforms;
+	std::unique_ptr<GpuProfiler> m_GpuProfiler;
+	uint32_t m_FrameGpuScope = 0;
+
+	PresentSettings m_PresentSettings;
+	bool m_SwapChainSettingsChanged = false;
+	bool m_SwapChainRecreatePending = false;
+
+	std::chrono::high_resolution_clock::time_point m_NextFrameTime{};
+	std::chrono::high_resolution_clock::time_point m_InputSampleTime{};
+	std::array<std::chrono::high_resolution_clock::time_point, SwapChain::MAX_FRAMES_IN_FLIGHT> m_FrameInputTimes{};
+	std::array<bool, SwapChain::MAX_FRAMES_IN_FLIGHT> m_FrameLatencyPending{};
+	float m_InputLatency = 0.0f;
 
 	uint32_t currentImageIndex;
 	int currentFrameIndex{0};
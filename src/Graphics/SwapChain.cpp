@@ -1,6 +1,7 @@
 #include "SwapChain.h"
 
 // std
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
@@ -10,13 +11,15 @@
 #include <stdexcept>
 
 
-SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent)
-    : device{ deviceRef}, windowExtent{ extent } {
+SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, const PresentSettings& settings)
+    : device{ deviceRef}, windowExtent{ extent }, presentMode{ settings.presentMode },
+    framesInFlight{ std::clamp(settings.framesInFlight, 1, MAX_FRAMES_IN_FLIGHT) } {
     init();
 }
 
-SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, std::shared_ptr<SwapChain> previous)
-    : device{ deviceRef }, windowExtent{ extent }, m_OldSwapChain{previous} {
+SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, const PresentSettings& settings, std::shared_ptr<SwapChain> previous)
+    : device{ deviceRef }, windowExtent{ extent }, presentMode{ settings.presentMode },
+    framesInFlight{ std::clamp(settings.framesInFlight, 1, MAX_FRAMES_IN_FLIGHT) }, m_OldSwapChain{previous} {
     init();
 
     m_OldSwapChain = nullptr;
@@ -35,14 +38,12 @@ SwapChain::~SwapChain() {
 
     for (int i = 0; i < depthImages.size(); i++) {
         vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-        vkDestroyImage(device.device(), depthImages[i], nullptr);
-        vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+        device.destroyImage(depthImages[i], depthImageMemorys[i]);
     }
 
     for (int i = 0; i < m_ColorImage.size(); i++) {
         vkDestroyImageView(device.device(), m_ColorImageView[i], nullptr);
-        vkDestroyImage(device.device(), m_ColorImage[i], nullptr);
-        vkFreeMemory(device.device(), m_ColorImageMemory[i], nullptr);
+        device.destroyImage(m_ColorImage[i], m_ColorImageMemory[i]);
     }
 
     for (auto framebuffer : swapChainFramebuffers) {
@@ -52,20 +53,19 @@ SwapChain::~SwapChain() {
     vkDestroyRenderPass(device.device(), renderPass, nullptr);
 
     // cleanup synchronization objects
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < imageAvailableSemaphores.size(); i++) {
         vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device.device(), inFlightFences[i], nullptr);
     }
 }
 
+bool SwapChain::isFrameComplete(int frameIndex) {
+    return device.getGraphicsTimeline().IsComplete(frameTimelineValues[frameIndex]);
+}
+
 VkResult SwapChain::acquireNextImage(uint32_t* imageIndex) {
-    vkWaitForFences(
-        device.device(),
-        1,
-        &inFlightFences[currentFrame],
-        VK_TRUE,
-        std::numeric_limits<uint64_t>::max());
+    // Only blocks when the CPU is framesInFlight frames ahead of the GPU
+    device.getGraphicsTimeline().Wait(frameTimelineValues[currentFrame]);
 
     VkResult result = vkAcquireNextImageKHR(
         device.device(),
@@ -79,13 +79,27 @@ VkResult SwapChain::acquireNextImage(uint32_t* imageIndex) {
 }
 
 VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex) {
-    if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
-        vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-    }
-    imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+    Timeline& timeline = device.getGraphicsTimeline();
+    // Usually already reached, the image came back from the presentation engine
+    timeline.Wait(imageTimelineValues[*imageIndex]);
+
+    uint64_t signalValue = timeline.AdvanceFrame();
+    frameTimelineValues[currentFrame] = signalValue;
+    imageTimelineValues[*imageIndex] = signalValue;
+
+    // Binary semaphores ignore their entry in the value arrays
+    uint64_t waitValues[] = { 0 };
+    uint64_t signalValues[] = { 0, signalValue };
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = 2;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
 
     VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
     VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
@@ -96,13 +110,11 @@ VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = buffers;
 
-    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
+    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame], timeline.GetSemaphore() };
+    submitInfo.signalSemaphoreCount = 2;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-        VK_SUCCESS) {
+    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
 
@@ -120,7 +132,7 @@ VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_
 
     auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % framesInFlight;
 
     return result;
 }
@@ -140,10 +152,11 @@ void SwapChain::createSwapChain() {
     SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+    VkPresentModeKHR vkPresentMode = chooseSwapPresentMode(swapChainSupport.presentModes, presentMode);
     VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    // Mailbox needs a spare image to replace, frames in flight beyond that only queue up
+    uint32_t imageCount = std::max<uint32_t>(swapChainSupport.capabilities.minImageCount + 1, framesInFlight + 1);
     if (swapChainSupport.capabilities.maxImageCount > 0 &&
         imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -177,7 +190,7 @@ void SwapChain::createSwapChain() {
     createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 
-    createInfo.presentMode = presentMode;
+    createInfo.presentMode = vkPresentMode;
     createInfo.clipped = VK_TRUE;
 
     createInfo.oldSwapchain = m_OldSwapChain == nullptr ? VK_NULL_HANDLE : m_OldSwapChain->swapChain;
@@ -418,24 +431,35 @@ void SwapChain::createColorResources()
 }
 
 void SwapChain::createSyncObjects() {
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+    imageAvailableSemaphores.resize(framesInFlight);
+    renderFinishedSemaphores.resize(framesInFlight);
+    // Nothing submitted yet, value 0 is always reached
+    frameTimelineValues.resize(framesInFlight, 0);
+    imageTimelineValues.resize(imageCount(), 0);
+
+    // Frames of the previous swap chain may still be in flight and per-frame resources outside the
+    // swap chain are indexed by frame slot, carry the slots over so acquire keeps waiting on them
+    if (m_OldSwapChain != nullptr) {
+        if (m_OldSwapChain->framesInFlight == framesInFlight) {
+            frameTimelineValues = m_OldSwapChain->frameTimelineValues;
+            currentFrame = m_OldSwapChain->currentFrame;
+        }
+        else {
+            // Slots no longer line up, every slot waits for the newest frame instead
+            uint64_t lastValue = *std::max_element(
+                m_OldSwapChain->frameTimelineValues.begin(), m_OldSwapChain->frameTimelineValues.end());
+            std::fill(frameTimelineValues.begin(), frameTimelineValues.end(), lastValue);
+        }
+    }
 
     VkSemaphoreCreateInfo semaphoreInfo = {};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (int i = 0; i < framesInFlight; i++) {
         if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
             VK_SUCCESS ||
             vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-            VK_SUCCESS ||
-            vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+            VK_SUCCESS) {
             throw std::runtime_error("failed to create synchronization objects for a frame!");
         }
     }
@@ -454,22 +478,29 @@ VkSurfaceFormatKHR SwapChain::chooseSwapSurfaceFormat(
 }
 
 VkPresentModeKHR SwapChain::chooseSwapPresentMode(
-    const std::vector<VkPresentModeKHR>& availablePresentModes) {
-    //for (const auto& availablePresentMode : availablePresentModes) {
-    //    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-    //        std::cout << "Present mode: Mailbox" << std::endl;
-    //        return availablePresentMode;
-    //    }
-    //}
-
-    // for (const auto &availablePresentMode : availablePresentModes) {
-    //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-    //     std::cout << "Present mode: Immediate" << std::endl;
-    //     return availablePresentMode;
-    //   }
-    // }
+    const std::vector<VkPresentModeKHR>& availablePresentModes, PresentMode requested) {
+    auto isAvailable = [&](VkPresentModeKHR mode) {
+        return std::find(availablePresentModes.begin(), availablePresentModes.end(), mode) != availablePresentModes.end();
+    };
+
+    if (requested == PresentMode::IMMEDIATE) {
+        if (isAvailable(VK_PRESENT_MODE_IMMEDIATE_KHR)) {
+            std::cout << "Present mode: Immediate" << std::endl;
+            return VK_PRESENT_MODE_IMMEDIATE_KHR;
+        }
+        requested = PresentMode::MAILBOX;
+    }
+
+    if (requested == PresentMode::MAILBOX) {
+        if (isAvailable(VK_PRESENT_MODE_MAILBOX_KHR)) {
+            std::cout << "Present mode: Mailbox" << std::endl;
+            presentMode = PresentMode::MAILBOX;
+            return VK_PRESENT_MODE_MAILBOX_KHR;
+        }
+    }
 
     std::cout << "Present mode: V-Sync" << std::endl;
+    presentMode = PresentMode::FIFO;
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -11,13 +11,28 @@
 #include <vector>
 
 
+enum class PresentMode
+{
+    FIFO = 0,       // V-Sync, always supported
+    MAILBOX = 1,    // No tearing, newest frame replaces the queued one. Falls back to FIFO
+    IMMEDIATE = 2   // Unlocked, may tear. Falls back to MAILBOX, then FIFO
+};
+
+struct PresentSettings
+{
+    PresentMode presentMode = PresentMode::FIFO;
+    int framesInFlight = 2;         // 1 to SwapChain::MAX_FRAMES_IN_FLIGHT
+    float frameRateLimit = 0.0f;    // CPU side limiter in frames per second, 0 is unlimited
+};
+
 class SwapChain 
 {
 public:
-    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    // Upper bound of PresentSettings::framesInFlight, per-frame resources are sized for it
+    static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
 
-    SwapChain(Device& deviceRef, VkExtent2D windowExtent);
-    SwapChain(Device& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous);
+    SwapChain(Device& deviceRef, VkExtent2D windowExtent, const PresentSettings& settings);
+    SwapChain(Device& deviceRef, VkExtent2D windowExtent, const PresentSettings& settings, std::shared_ptr<SwapChain> previous);
     ~SwapChain();
 
     SwapChain(const SwapChain&) = delete;
@@ -37,6 +52,14 @@ public:
         return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
     }
 
+    // Present mode actually in use after fallback
+    PresentMode getPresentMode() { return presentMode; }
+    int getFramesInFlight() { return framesInFlight; }
+    // Frame slot the next acquireNextImage / submitCommandBuffers pair uses
+    int getCurrentFrame() { return static_cast<int>(currentFrame); }
+    // True once the last submission of this frame slot has finished on the GPU, does not wait
+    bool isFrameComplete(int frameIndex);
+
     VkResult acquireNextImage(uint32_t* imageIndex);
     VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
 
@@ -60,7 +83,7 @@ private:
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(
         const std::vector<VkSurfaceFormatKHR>& availableFormats);
     VkPresentModeKHR chooseSwapPresentMode(
-        const std::vector<VkPresentModeKHR>& availablePresentModes);
+        const std::vector<VkPresentModeKHR>& availablePresentModes, PresentMode requested);
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
     VkFormat swapChainImageFormat;
@@ -71,25 +94,29 @@ private:
     VkRenderPass renderPass;
 
     std::vector<VkImage> depthImages;
-    std::vector<VkDeviceMemory> depthImageMemorys;
+    std::vector<MemoryAllocation> depthImageMemorys;
     std::vector<VkImageView> depthImageViews;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
 
     std::vector<VkImage> m_ColorImage;
-    std::vector<VkDeviceMemory> m_ColorImageMemory;
+    std::vector<MemoryAllocation> m_ColorImageMemory;
     std::vector<VkImageView> m_ColorImageView;
 
     Device& device;
     VkExtent2D windowExtent;
+    PresentMode presentMode;
+    int framesInFlight;
 
     VkSwapchainKHR swapChain;
     std::shared_ptr<SwapChain> m_OldSwapChain;
 
+    // Binary, the swap chain can't use timeline semaphores
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
-    std::vector<VkFence> imagesInFlight;
+    // Graphics timeline values of the last submission per frame slot and per swap chain image
+    std::vector<uint64_t> frameTimelineValues;
+    std::vector<uint64_t> imageTimelineValues;
     size_t currentFrame = 0;
 };
 
@@ -13,8 +13,6 @@ public:
 	VkDescriptorImageInfo getImageInfo() const { return m_DescriptorImageInfo; }
 
 private:
-	void TransitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout);
-	void GenerateMipmaps();
 	void UpdateDescriptor();
 
 	Device& m_Device;
@@ -22,7 +20,7 @@ private:
 	int m_Width, m_Height, m_MipLevels, m_LayerCount;
 
 	VkImage m_Image;
-	VkDeviceMemory m_ImageMemory;
+	MemoryAllocation m_ImageMemory;
 
 	VkSampler m_Sampler;
 	VkImageView m_ImageView;
@@ -0,0 +1,109 @@
+#include "Timeline.h"
+#include "../Instrumentation.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+Timeline::Timeline(VkDevice device) : m_Device(device)
+{
+	// Core only from Vulkan 1.2, the instance targets 1.1
+	m_GetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(m_Device, "vkGetSemaphoreCounterValueKHR");
+	m_WaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(m_Device, "vkWaitSemaphoresKHR");
+	if (m_GetSemaphoreCounterValue == nullptr || m_WaitSemaphores == nullptr)
+	{
+		throw std::runtime_error("failed to load timeline semaphore functions!");
+	}
+
+	VkSemaphoreTypeCreateInfoKHR typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	if (vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_Semaphore) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create timeline semaphore!");
+	}
+}
+
+Timeline::~Timeline()
+{
+	WaitIdle();
+
+	for (auto& pending : m_PendingDestroys)
+	{
+		pending();
+	}
+	for (auto& deferred : m_DeferredDestroys)
+	{
+		deferred.destroy();
+	}
+
+	vkDestroySemaphore(m_Device, m_Semaphore, nullptr);
+}
+
+uint64_t Timeline::AdvanceFrame()
+{
+	uint64_t value = Advance();
+	for (auto& pending : m_PendingDestroys)
+	{
+		m_DeferredDestroys.push_back({ value, std::move(pending) });
+	}
+	m_PendingDestroys.clear();
+	return value;
+}
+
+uint64_t Timeline::GetCompletedValue()
+{
+	if (m_CompletedValue < m_SubmittedValue)
+	{
+		m_GetSemaphoreCounterValue(m_Device, m_Semaphore, &m_CompletedValue);
+	}
+	return m_CompletedValue;
+}
+
+bool Timeline::IsComplete(uint64_t value)
+{
+	return value <= m_CompletedValue || value <= GetCompletedValue();
+}
+
+void Timeline::Wait(uint64_t value)
+{
+	if (IsComplete(value))
+	{
+		return;
+	}
+
+	PROFILE_FUNCTION();
+
+	VkSemaphoreWaitInfoKHR waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_Semaphore;
+	waitInfo.pValues = &value;
+	if (m_WaitSemaphores(m_Device, &waitInfo, std::numeric_limits<uint64_t>::max()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to wait for timeline semaphore!");
+	}
+	m_CompletedValue = std::max(m_CompletedValue, value);
+}
+
+void Timeline::DeferDestroy(std::function<void()> destroy)
+{
+	m_PendingDestroys.push_back(std::move(destroy));
+}
+
+void Timeline::CollectGarbage()
+{
+	size_t released = 0;
+	while (released < m_DeferredDestroys.size() && IsComplete(m_DeferredDestroys[released].value))
+	{
+		m_DeferredDestroys[released].destroy();
+		released++;
+	}
+	m_DeferredDestroys.erase(m_DeferredDestroys.begin(), m_DeferredDestroys.begin() + released);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Timeline semaphore (VK_KHR_timeline_semaphore) counting the submissions of one queue. Every
+// submission signals the next value, so reaching a value means that submission and every earlier
+// one on the queue has finished : one fence-free clock the CPU and other queues can wait on.
+// Render thread only.
+class Timeline
+{
+public:
+	Timeline(VkDevice device);
+	~Timeline();
+
+	Timeline(const Timeline&) = delete;
+	Timeline& operator=(const Timeline&) = delete;
+
+	VkSemaphore GetSemaphore() const { return m_Semaphore; }
+
+	// Value the next submission has to signal, call once per submission in submission order
+	uint64_t Advance() { return ++m_SubmittedValue; }
+	// Same, for the submission of a rendered frame : destroys deferred while it was recorded wait for it
+	uint64_t AdvanceFrame();
+
+	uint64_t GetSubmittedValue() const { return m_SubmittedValue; }
+	uint64_t GetCompletedValue();
+	bool IsComplete(uint64_t value);
+	// Blocks the CPU until value is reached
+	void Wait(uint64_t value);
+	void WaitIdle() { Wait(m_SubmittedValue); }
+
+	// Runs destroy once the GPU is done with everything submitted so far and with the frame being recorded
+	void DeferDestroy(std::function<void()> destroy);
+	// Runs the deferred destroys whose frame finished, call once per frame
+	void CollectGarbage();
+
+private:
+	struct DeferredDestroy
+	{
+		uint64_t value;
+		std::function<void()> destroy;
+	};
+
+	VkDevice m_Device;
+	VkSemaphore m_Semaphore = VK_NULL_HANDLE;
+
+	uint64_t m_SubmittedValue = 0;
+	uint64_t m_CompletedValue = 0;	// Last value read back, only grows
+
+	std::vector<std::function<void()>> m_PendingDestroys;	// Waiting for the next frame submission
+	std::vector<DeferredDestroy> m_DeferredDestroys;			// Oldest first
+
+	PFN_vkGetSemaphoreCounterValueKHR m_GetSemaphoreCounterValue = nullptr;
+	PFN_vkWaitSemaphoresKHR m_WaitSemaphores = nullptr;
+};
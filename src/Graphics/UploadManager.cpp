@@ -0,0 +1,478 @@
+#include "UploadManager.h"
+#include "../Instrumentation.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+UploadManager::UploadManager(Device& device, VkDeviceSize stagingSize) : m_Device(device), m_StagingSize(stagingSize)
+{
+	QueueFamilyIndices indices = m_Device.findPhysicalQueueFamilies();
+	m_GraphicsFamily = indices.graphicsFamily;
+	m_TransferFamily = indices.transferFamilyHasValue ? indices.transferFamily : indices.graphicsFamily;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = m_GraphicsFamily;
+	if (vkCreateCommandPool(m_Device.device(), &poolInfo, nullptr, &m_GraphicsCommandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+
+	if (HasDedicatedTransferQueue())
+	{
+		poolInfo.queueFamilyIndex = m_TransferFamily;
+		if (vkCreateCommandPool(m_Device.device(), &poolInfo, nullptr, &m_TransferCommandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create transfer command pool!");
+		}
+	}
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	for (auto& batch : m_Batches)
+	{
+		allocInfo.commandPool = m_GraphicsCommandPool;
+		if (vkAllocateCommandBuffers(m_Device.device(), &allocInfo, &batch.graphicsCommands) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upload batch!");
+		}
+
+		if (HasDedicatedTransferQueue())
+		{
+			allocInfo.commandPool = m_TransferCommandPool;
+			if (vkAllocateCommandBuffers(m_Device.device(), &allocInfo, &batch.transferCommands) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create upload batch!");
+			}
+		}
+	}
+
+	// Copies into optimal images want their source offset aligned, 16 also covers every texel size
+	m_CopyAlignment = std::max<VkDeviceSize>(m_Device.properties.limits.optimalBufferCopyOffsetAlignment, 16);
+
+	m_StagingRing = std::make_unique<Buffer>(
+		m_Device,
+		m_StagingSize,
+		1,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	m_StagingRing->map();
+}
+
+UploadManager::~UploadManager()
+{
+	WaitIdle();
+
+	vkDestroyCommandPool(m_Device.device(), m_GraphicsCommandPool, nullptr);
+	if (m_TransferCommandPool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(m_Device.device(), m_TransferCommandPool, nullptr);
+	}
+}
+
+void UploadManager::UploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset,
+	VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	StagingRange staging = AllocateStaging(size);
+	memcpy(staging.mapped, data, static_cast<size_t>(size));
+
+	Batch& batch = GetRecordingBatch();
+	VkCommandBuffer commandBuffer = GetCopyCommands(batch);
+
+	// Copies in a batch are unordered, a second write to the same buffer waits for the earlier ones
+	if (!batch.writtenBuffers.insert(dstBuffer).second)
+	{
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	VkBufferCopy region{};
+	region.srcOffset = staging.offset;
+	region.dstOffset = dstOffset;
+	region.size = size;
+	vkCmdCopyBuffer(commandBuffer, staging.buffer, dstBuffer, 1, &region);
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.buffer = dstBuffer;
+	barrier.offset = dstOffset;
+	barrier.size = size;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	if (HasDedicatedTransferQueue())
+	{
+		// Ownership transfer : released on the transfer queue, acquired on the graphics queue
+		barrier.srcQueueFamilyIndex = m_TransferFamily;
+		barrier.dstQueueFamilyIndex = m_GraphicsFamily;
+		barrier.dstAccessMask = 0;
+		batch.bufferReleases.push_back(barrier);
+		barrier.srcAccessMask = 0;
+	}
+
+	barrier.dstAccessMask = dstAccessMask;
+	batch.bufferAcquires.push_back(barrier);
+	batch.acquireStages |= dstStageMask;
+}
+
+void UploadManager::UploadImage(VkImage image, const void* data, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	StagingRange staging = AllocateStaging(size);
+	memcpy(staging.mapped, data, static_cast<size_t>(size));
+
+	Batch& batch = GetRecordingBatch();
+	VkCommandBuffer commandBuffer = GetCopyCommands(batch);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = staging.offset;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+	vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	if (HasDedicatedTransferQueue())
+	{
+		// Layout stays TRANSFER_DST across the ownership transfer, the blits need the graphics queue
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = m_TransferFamily;
+		barrier.dstQueueFamilyIndex = m_GraphicsFamily;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		batch.imageReleases.push_back(barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		batch.imageAcquires.push_back(barrier);
+		batch.acquireStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
+
+	batch.images.push_back({ image, width, height, mipLevels });
+}
+
+void UploadManager::Flush()
+{
+	if (m_RecordingBatch == BATCH_COUNT)
+	{
+		return;
+	}
+
+	PROFILE_FUNCTION();
+
+	Batch& batch = m_Batches[m_RecordingBatch];
+	bool dedicated = HasDedicatedTransferQueue();
+
+	if (dedicated)
+	{
+		if (!batch.bufferReleases.empty() || !batch.imageReleases.empty())
+		{
+			vkCmdPipelineBarrier(batch.transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr,
+				static_cast<uint32_t>(batch.bufferReleases.size()), batch.bufferReleases.data(),
+				static_cast<uint32_t>(batch.imageReleases.size()), batch.imageReleases.data());
+		}
+		vkEndCommandBuffer(batch.transferCommands);
+	}
+
+	if (!batch.bufferAcquires.empty() || !batch.imageAcquires.empty())
+	{
+		vkCmdPipelineBarrier(batch.graphicsCommands, dedicated ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT, batch.acquireStages, 0,
+			0, nullptr,
+			static_cast<uint32_t>(batch.bufferAcquires.size()), batch.bufferAcquires.data(),
+			static_cast<uint32_t>(batch.imageAcquires.size()), batch.imageAcquires.data());
+	}
+
+	for (const auto& image : batch.images)
+	{
+		RecordMipmaps(batch.graphicsCommands, image);
+	}
+	vkEndCommandBuffer(batch.graphicsCommands);
+
+	Timeline& graphicsTimeline = m_Device.getGraphicsTimeline();
+	VkSemaphore graphicsSemaphore = graphicsTimeline.GetSemaphore();
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.signalSemaphoreCount = 1;
+	timelineInfo.signalSemaphoreValueCount = 1;
+
+	VkPipelineStageFlags waitStage = batch.acquireStages ? batch.acquireStages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	uint64_t transferValue = 0;
+	VkSemaphore transferSemaphore = VK_NULL_HANDLE;
+	if (dedicated)
+	{
+		Timeline& transferTimeline = m_Device.getTransferTimeline();
+		transferValue = transferTimeline.Advance();
+		transferSemaphore = transferTimeline.GetSemaphore();
+
+		submitInfo.pCommandBuffers = &batch.transferCommands;
+		submitInfo.pSignalSemaphores = &transferSemaphore;
+		timelineInfo.pSignalSemaphoreValues = &transferValue;
+		if (vkQueueSubmit(m_Device.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit transfer batch!");
+		}
+
+		// The graphics half waits for the copies on the transfer timeline
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &transferSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		timelineInfo.waitSemaphoreValueCount = 1;
+		timelineInfo.pWaitSemaphoreValues = &transferValue;
+	}
+
+	// The graphics submit finishes last, its timeline value covers the whole batch
+	batch.graphicsValue = graphicsTimeline.Advance();
+	submitInfo.pCommandBuffers = &batch.graphicsCommands;
+	submitInfo.pSignalSemaphores = &graphicsSemaphore;
+	timelineInfo.pSignalSemaphoreValues = &batch.graphicsValue;
+	if (vkQueueSubmit(m_Device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to submit upload batch!");
+	}
+
+	batch.ringEnd = m_RingHead;
+	m_InFlight.push_back(m_RecordingBatch);
+	m_RecordingBatch = BATCH_COUNT;
+}
+
+void UploadManager::Update()
+{
+	PROFILE_FUNCTION();
+
+	while (RetireOldest(false))
+	{
+	}
+
+	Flush();
+}
+
+void UploadManager::WaitIdle()
+{
+	Flush();
+
+	while (RetireOldest(true))
+	{
+	}
+}
+
+UploadManager::StagingRange UploadManager::AllocateStaging(VkDeviceSize size)
+{
+	// Too large for the ring, gets its own staging buffer that lives as long as the batch
+	if (size > m_StagingSize / 2)
+	{
+		auto buffer = std::make_unique<Buffer>(
+			m_Device,
+			size,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		buffer->map();
+
+		StagingRange range{ buffer->getBuffer(), 0, buffer->getMappedMemory() };
+		GetRecordingBatch().oversizedStaging.push_back(std::move(buffer));
+		return range;
+	}
+
+	while (true)
+	{
+		VkDeviceSize position = AlignUp(m_RingHead, m_CopyAlignment);
+		VkDeviceSize offset = position % m_StagingSize;
+		if (offset + size > m_StagingSize)
+		{
+			// Ranges never wrap, skip the end of the ring
+			position += m_StagingSize - offset;
+			offset = 0;
+		}
+
+		if (position + size - m_RingTail <= m_StagingSize)
+		{
+			m_RingHead = position + size;
+			return { m_StagingRing->getBuffer(), offset, static_cast<char*>(m_StagingRing->getMappedMemory()) + offset };
+		}
+
+		// Ring full : submit what is recorded and wait for the oldest batch to hand its range back
+		Flush();
+		if (!RetireOldest(true))
+		{
+			m_RingTail = m_RingHead;
+		}
+	}
+}
+
+UploadManager::Batch& UploadManager::GetRecordingBatch()
+{
+	if (m_RecordingBatch != BATCH_COUNT)
+	{
+		return m_Batches[m_RecordingBatch];
+	}
+
+	if (m_InFlight.size() == BATCH_COUNT)
+	{
+		RetireOldest(true);
+	}
+
+	uint32_t index = 0;
+	while (std::find(m_InFlight.begin(), m_InFlight.end(), index) != m_InFlight.end())
+	{
+		index++;
+	}
+
+	Batch& batch = m_Batches[index];
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(batch.graphicsCommands, &beginInfo);
+	if (HasDedicatedTransferQueue())
+	{
+		vkBeginCommandBuffer(batch.transferCommands, &beginInfo);
+	}
+
+	m_RecordingBatch = index;
+	return batch;
+}
+
+VkCommandBuffer UploadManager::GetCopyCommands(Batch& batch)
+{
+	return HasDedicatedTransferQueue() ? batch.transferCommands : batch.graphicsCommands;
+}
+
+bool UploadManager::RetireOldest(bool wait)
+{
+	if (m_InFlight.empty())
+	{
+		return false;
+	}
+
+	Batch& batch = m_Batches[m_InFlight.front()];
+	Timeline& timeline = m_Device.getGraphicsTimeline();
+	if (wait)
+	{
+		timeline.Wait(batch.graphicsValue);
+	}
+	else if (!timeline.IsComplete(batch.graphicsValue))
+	{
+		return false;
+	}
+
+	m_RingTail = batch.ringEnd;
+
+	batch.oversizedStaging.clear();
+	batch.bufferReleases.clear();
+	batch.imageReleases.clear();
+	batch.bufferAcquires.clear();
+	batch.imageAcquires.clear();
+	batch.acquireStages = 0;
+	batch.images.clear();
+	batch.writtenBuffers.clear();
+
+	m_InFlight.pop_front();
+	return true;
+}
+
+void UploadManager::RecordMipmaps(VkCommandBuffer commandBuffer, const PendingImage& image)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image.image;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	int32_t mipWidth = static_cast<int32_t>(image.width);
+	int32_t mipHeight = static_cast<int32_t>(image.height);
+
+	for (uint32_t i = 1; i < image.mipLevels; i++)
+	{
+		barrier.subresourceRange.baseMipLevel = i - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkImageBlit blit{};
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = i - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = i;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+
+		vkCmdBlitImage(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		if (mipWidth > 1) mipWidth /= 2;
+		if (mipHeight > 1) mipHeight /= 2;
+	}
+
+	barrier.subresourceRange.baseMipLevel = image.mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
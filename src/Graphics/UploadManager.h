@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Device.h"
+#include "Buffer.h"
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+// Batched uploads through a persistently mapped staging ring. Data is copied into the ring
+// right away, the GPU copies are recorded into one batch and submitted together : on the
+// dedicated transfer queue when the device has one (ownership is then released to the graphics
+// queue), else on the graphics queue. Batches are tracked on the device timelines, nothing waits on a queue.
+// Render thread only, models loaded before it starts upload from the main thread.
+class UploadManager
+{
+public:
+	UploadManager(Device& device, VkDeviceSize stagingSize = 64 * 1024 * 1024);
+	~UploadManager();
+
+	UploadManager(const UploadManager&) = delete;
+	UploadManager& operator=(const UploadManager&) = delete;
+
+	// dstStageMask / dstAccessMask describe how the graphics queue reads the data afterwards
+	void UploadBuffer(VkBuffer dstBuffer, const void* data, VkDeviceSize size, VkDeviceSize dstOffset,
+		VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+	// Fills mip 0 of a color image, generates the other mips with blits on the graphics queue
+	// and leaves every level in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	void UploadImage(VkImage image, const void* data, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	// Submits the recorded batch without waiting. Graphics submissions made after this see the data.
+	void Flush();
+	// Call once per frame before the frame is submitted : retires finished batches and flushes
+	void Update();
+	// Flushes and blocks until every batch completed, for code about to read or move uploaded resources
+	void WaitIdle();
+
+	bool HasDedicatedTransferQueue() const { return m_TransferFamily != m_GraphicsFamily; }
+	uint32_t GetBatchesInFlight() const { return static_cast<uint32_t>(m_InFlight.size()); }
+
+private:
+	static constexpr uint32_t BATCH_COUNT = 3;
+
+	struct PendingImage
+	{
+		VkImage image;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+	};
+
+	struct Batch
+	{
+		VkCommandBuffer transferCommands = VK_NULL_HANDLE;	// Copies and release barriers, only with a dedicated transfer queue
+		VkCommandBuffer graphicsCommands = VK_NULL_HANDLE;	// Acquire barriers and mip generation
+		uint64_t graphicsValue = 0;							// Graphics timeline value of the batch, submitted last
+
+		VkDeviceSize ringEnd = 0;							// Ring head when submitted, the ring is free up to here once the fence signals
+		std::vector<std::unique_ptr<Buffer>> oversizedStaging;
+
+		std::vector<VkBufferMemoryBarrier> bufferReleases;
+		std::vector<VkImageMemoryBarrier> imageReleases;
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+		VkPipelineStageFlags acquireStages = 0;
+		std::vector<PendingImage> images;
+		std::unordered_set<VkBuffer> writtenBuffers;
+	};
+
+	struct StagingRange
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		void* mapped;
+	};
+
+	// May flush and wait for older batches when the ring is full
+	StagingRange AllocateStaging(VkDeviceSize size);
+	Batch& GetRecordingBatch();
+	VkCommandBuffer GetCopyCommands(Batch& batch);
+	// Returns false when the oldest batch is still running and wait is false
+	bool RetireOldest(bool wait);
+	void RecordMipmaps(VkCommandBuffer commandBuffer, const PendingImage& image);
+
+	Device& m_Device;
+	uint32_t m_GraphicsFamily;
+	uint32_t m_TransferFamily;
+
+	VkCommandPool m_GraphicsCommandPool = VK_NULL_HANDLE;
+	VkCommandPool m_TransferCommandPool = VK_NULL_HANDLE;
+
+	std::array<Batch, BATCH_COUNT> m_Batches;
+	std::deque<uint32_t> m_InFlight;			// Oldest first
+	uint32_t m_RecordingBatch = BATCH_COUNT;	// BATCH_COUNT when nothing is being recorded
+
+	std::unique_ptr<Buffer> m_StagingRing;
+	VkDeviceSize m_StagingSize;
+	VkDeviceSize m_CopyAlignment;
+	// Monotonic positions, the physical offset is position % m_StagingSize
+	VkDeviceSize m_RingHead = 0;
+	VkDeviceSize m_RingTail = 0;
+};
@@ -0,0 +1,229 @@
+#include "Instrumentation.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    // Microseconds with nanosecond digits, printf's %f is several times slower on timestamps this large
+    int FormatMicroseconds(char* text, size_t size, double microseconds)
+    {
+        long long nanoseconds = std::llround(microseconds * 1000.0);
+        if (nanoseconds < 0)
+            nanoseconds = 0;
+        return snprintf(text, size, "%lld.%03lld", nanoseconds / 1000, nanoseconds % 1000);
+    }
+}
+
+Instrumentor::~Instrumentor()
+{
+    if (IsSessionActive())
+        EndSession();
+}
+
+void Instrumentor::BeginSession(const std::string& name, const std::string& filepath)
+{
+    assert(!IsSessionActive() && "Instrumentor : a session is already active");
+
+    m_OutputStream.open(filepath);
+    m_OutputStream << "{\"otherData\": {\"session\":\"" << name << "\"},\"traceEvents\":[";
+    m_FirstEvent = true;
+    m_DroppedEvents = 0;
+
+    // Whatever was pushed after the previous session ended belongs to neither
+    {
+        std::lock_guard<std::mutex> lock(m_BuffersMutex);
+        for (auto& buffer : m_ThreadBuffers)
+            buffer->tail.store(buffer->head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    m_TicksBase = ReadTicks();
+    m_MicrosecondsBase = NowMicroseconds();
+#if PROFILE_USE_RDTSC
+    // Rough first estimate of the TSC rate, every drain refines it over a longer span
+    while (NowMicroseconds() - m_MicrosecondsBase < 1000.0)
+        std::this_thread::yield();
+    Calibrate();
+#else
+    m_TicksPerMicrosecond = static_cast<double>(Clock::period::den) / (Clock::period::num * 1000000.0);
+#endif
+
+    m_WriterRunning = true;
+    m_Writer = std::thread(&Instrumentor::WriterLoop, this);
+
+    m_SessionActive = true;
+    UpdateCapturing();
+}
+
+void Instrumentor::EndSession()
+{
+    m_SessionActive = false;
+    UpdateCapturing();
+
+    m_WriterRunning = false;
+    m_Writer.join();
+    Drain();
+
+    m_OutputStream << "],\"droppedEvents\":" << m_DroppedEvents.load() << "}";
+    m_OutputStream.close();
+}
+
+void Instrumentor::SetCaptureEnabled(bool enabled)
+{
+    m_CaptureEnabled = enabled;
+    UpdateCapturing();
+}
+
+void Instrumentor::UpdateCapturing()
+{
+    m_Capturing = m_SessionActive && m_CaptureEnabled;
+}
+
+uint32_t Instrumentor::InternName(const char* name)
+{
+    std::lock_guard<std::mutex> lock(m_NamesMutex);
+
+    auto it = m_NameIDs.find(name);
+    if (it != m_NameIDs.end())
+        return it->second;
+
+    assert(m_NameCount < MAX_NAMES && "Instrumentor : too many profile names");
+    if (m_NameCount == MAX_NAMES)
+        return 0;
+
+    uint32_t nameID = m_NameCount++;
+    m_Names[nameID].store(name, std::memory_order_release);
+    m_NameIDs.emplace(name, nameID);
+    return nameID;
+}
+
+void Instrumentor::WriteProfile(const ProfileResult& result)
+{
+    if (IsCapturing())
+        Push({ result.Start, result.End, 0.0, InternName(result.Name), EventType::TrackScope, result.ThreadID });
+}
+
+void Instrumentor::WriteTrackName(uint32_t threadID, const char* name)
+{
+    if (IsSessionActive())
+        Push({ 0, 0, 0.0, InternName(name), EventType::TrackName, threadID });
+}
+
+void Instrumentor::SetThreadName(const char* name)
+{
+    if (IsSessionActive())
+        Push({ 0, 0, 0.0, InternName(name), EventType::ThreadName, 0 });
+}
+
+Instrumentor::ThreadBuffer* Instrumentor::RegisterThread()
+{
+    // Once per thread, small sequential ids instead of hashing std::thread::id for every event
+    std::lock_guard<std::mutex> lock(m_BuffersMutex);
+    m_ThreadBuffers.push_back(std::make_unique<ThreadBuffer>());
+    ThreadBuffer* buffer = m_ThreadBuffers.back().get();
+    buffer->threadID = static_cast<uint32_t>(m_ThreadBuffers.size());
+    assert(buffer->threadID < FIRST_RESERVED_TRACK_ID && "Instrumentor : thread ids ran into the reserved track ids");
+    return buffer;
+}
+
+void Instrumentor::WriterLoop()
+{
+    while (m_WriterRunning)
+    {
+        Drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void Instrumentor::Calibrate()
+{
+#if PROFILE_USE_RDTSC
+    long long ticks = ReadTicks();
+    double microseconds = NowMicroseconds();
+    if (microseconds > m_MicrosecondsBase)
+        m_TicksPerMicrosecond = (ticks - m_TicksBase) / (microseconds - m_MicrosecondsBase);
+#endif
+}
+
+double Instrumentor::TicksToMicroseconds(long long ticks) const
+{
+    return m_MicrosecondsBase + (ticks - m_TicksBase) / m_TicksPerMicrosecond;
+}
+
+void Instrumentor::Drain()
+{
+    Calibrate();
+
+    std::lock_guard<std::mutex> lock(m_BuffersMutex);
+    for (auto& buffer : m_ThreadBuffers)
+    {
+        uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+        uint32_t head = buffer->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++)
+            WriteEvent(buffer->events[tail & (ThreadBuffer::CAPACITY - 1)], buffer->threadID);
+        buffer->tail.store(tail, std::memory_order_release);
+    }
+    m_OutputStream.flush();
+}
+
+void Instrumentor::WriteEvent(const ProfileEvent& event, uint32_t threadID)
+{
+    char text[256];
+    char startText[32];
+    char durationText[32];
+    int length = 0;
+
+    if (!m_FirstEvent)
+        m_OutputStream.put(',');
+    m_FirstEvent = false;
+
+    switch (event.type)
+    {
+    case EventType::Scope:
+    case EventType::TrackScope:
+    {
+        bool ticks = event.type == EventType::Scope;
+        double start = ticks ? TicksToMicroseconds(event.start) : static_cast<double>(event.start);
+        double end = ticks ? TicksToMicroseconds(event.end) : static_cast<double>(event.end);
+        FormatMicroseconds(startText, sizeof(startText), start);
+        FormatMicroseconds(durationText, sizeof(durationText), end - start);
+        length = snprintf(text, sizeof(text), "{\"cat\":\"function\",\"dur\":%s,", durationText);
+        m_OutputStream.write(text, length);
+        WriteName(event.nameID);
+        length = snprintf(text, sizeof(text), ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%s}", ticks ? threadID : event.track, startText);
+        break;
+    }
+    case EventType::Counter:
+        m_OutputStream << "{\"cat\":\"counter\",";
+        WriteName(event.nameID);
+        FormatMicroseconds(startText, sizeof(startText), TicksToMicroseconds(event.start));
+        length = snprintf(text, sizeof(text), ",\"ph\":\"C\",\"pid\":0,\"ts\":%s,\"args\":{\"value\":%g}}", startText, event.value);
+        break;
+    case EventType::TrackName:
+    case EventType::ThreadName:
+        length = snprintf(text, sizeof(text), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{",
+            event.type == EventType::ThreadName ? threadID : event.track);
+        m_OutputStream.write(text, length);
+        WriteName(event.nameID);
+        length = snprintf(text, sizeof(text), "}}");
+        break;
+    }
+    m_OutputStream.write(text, length);
+}
+
+void Instrumentor::WriteName(uint32_t nameID)
+{
+    if (nameID >= m_EscapedNames.size())
+        m_EscapedNames.resize(nameID + 1);
+
+    std::string& escaped = m_EscapedNames[nameID];
+    if (escaped.empty())
+    {
+        escaped = "\"name\":\"";
+        for (const char* c = m_Names[nameID].load(std::memory_order_acquire); *c; c++)
+            escaped.push_back(*c == '"' ? '\'' : *c);
+        escaped.push_back('"');
+    }
+    m_OutputStream.write(escaped.data(), escaped.size());
+}
@@ -1,113 +1,213 @@
 //
-// Basic instrumentation profiler by Cherno
-
-// Usage: include this header file somewhere in your code (eg. precompiled header), and then use like:
+// Instrumentation profiler, started from the basic one by Cherno
+//
+// Usage:
 //
-// Instrumentor::Get().BeginSession("Session Name");        // Begin session 
+// PROFILE_BEGIN("Session Name", "results.json");   // Begin session, starts the writer thread
 // {
-//     InstrumentationTimer timer("Profiled Scope Name");   // Place code like this in scopes you'd like to include in profiling
+//     PROFILE_SCOPE("Profiled Scope Name");        // Place code like this in scopes you'd like to include in profiling
 //     // Code
 // }
-// Instrumentor::Get().EndSession();                        // End Session
+// PROFILE_END();                                   // End session, writes what is left and closes the file
 //
-// You will probably want to macro-fy this, to switch on/off easily and use things like __FUNCSIG__ for the profile name.
+// A scope costs two clock reads (rdtsc on x64, steady_clock elsewhere) and one fixed size event pushed
+// into a ring owned by the calling thread :
+// nothing is locked, allocated or formatted on the profiled thread. Names are interned once per call
+// site, so they must be string literals (or __FUNCSIG__). A writer thread drains every ring into Chrome
+// trace JSON (chrome://tracing, ui.perfetto.dev). A ring the writer could not keep up with drops its
+// new events, the count ends up in the file. Capture can be paused at runtime with SetCaptureEnabled.
 //
 #pragma once
 
-#include <string>
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <algorithm>
+#include <cstdint>
 #include <fstream>
-
+#include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+    #define PROFILE_USE_RDTSC 1
+#else
+    #define PROFILE_USE_RDTSC 0
+#endif
 
 struct ProfileResult
 {
-    std::string Name;
-    long long Start, End;
+    const char* Name;   // String literal, not copied
+    long long Start, End;   // Microseconds of Instrumentor::Clock
     uint32_t ThreadID;
 };
 
-struct InstrumentationSession
-{
-    std::string Name;
-};
-
 class Instrumentor
 {
-private:
-    InstrumentationSession* m_CurrentSession;
-    std::ofstream m_OutputStream;
-    int m_ProfileCount;
 public:
-    Instrumentor()
-        : m_CurrentSession(nullptr), m_ProfileCount(0)
+    // Time axis of the trace, ticks are converted to microseconds of it by the writer
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t MAX_NAMES = 4096;
+    // Threads get sequential track ids from 1, ids from here up are left to tracks that are not threads
+    static constexpr uint32_t FIRST_RESERVED_TRACK_ID = 0x40000000;
+
+    static Instrumentor& Get()
     {
+        static Instrumentor instance;
+        return instance;
     }
 
-    void BeginSession(const std::string& name, const std::string& filepath = "results.json")
+    void BeginSession(const std::string& name, const std::string& filepath = "results.json");
+    void EndSession();
+    bool IsSessionActive() const { return m_SessionActive.load(std::memory_order_relaxed); }
+
+    // Runtime toggle, events are recorded while a session is active and capture is enabled
+    void SetCaptureEnabled(bool enabled);
+    bool IsCaptureEnabled() const { return m_CaptureEnabled.load(std::memory_order_relaxed); }
+    bool IsCapturing() const { return m_Capturing.load(std::memory_order_relaxed); }
+
+    // Once per call site, events carry the id
+    uint32_t InternName(const char* name);
+
+    // Invariant TSC on x64 : a fraction of the cost of steady_clock, calibrated against it while capturing
+    static long long ReadTicks()
     {
-        m_OutputStream.open(filepath);
-        WriteHeader();
-        m_CurrentSession = new InstrumentationSession{ name };
+#if PROFILE_USE_RDTSC
+        return static_cast<long long>(__rdtsc());
+#else
+        return Clock::now().time_since_epoch().count();
+#endif
     }
 
-    void EndSession()
+    void RecordScope(uint32_t nameID, long long start, long long end)
     {
-        WriteFooter();
-        m_OutputStream.close();
-        delete m_CurrentSession;
-        m_CurrentSession = nullptr;
-        m_ProfileCount = 0;
+        Push({ start, end, 0.0, nameID, EventType::Scope, 0 });
     }
 
-    void WriteProfile(const ProfileResult& result)
+    void RecordCounter(uint32_t nameID, double value)
     {
-        if (m_ProfileCount++ > 0)
-            m_OutputStream << ",";
-
-        std::string name = result.Name;
-        std::replace(name.begin(), name.end(), '"', '\'');
-
-        m_OutputStream << "{";
-        m_OutputStream << "\"cat\":\"function\",";
-        m_OutputStream << "\"dur\":" << (result.End - result.Start) << ',';
-        m_OutputStream << "\"name\":\"" << name << "\",";
-        m_OutputStream << "\"ph\":\"X\",";
-        m_OutputStream << "\"pid\":0,";
-        m_OutputStream << "\"tid\":" << result.ThreadID << ",";
-        m_OutputStream << "\"ts\":" << result.Start;
-        m_OutputStream << "}";
-
-        m_OutputStream.flush();
+        if (IsCapturing())
+            Push({ ReadTicks(), 0, value, nameID, EventType::Counter, 0 });
     }
 
-    void WriteHeader()
+    // Slower, interns the name on every call : for events that are not timed by a scope of the calling
+    // thread, like the GPU track. Goes through the calling thread's ring all the same.
+    void WriteProfile(const ProfileResult& result);
+    // Names the track of a ThreadID that is not a real thread (eg. the GPU timeline)
+    void WriteTrackName(uint32_t threadID, const char* name);
+    // Names the calling thread's track
+    void SetThreadName(const char* name);
+
+    static double NowMicroseconds()
     {
-        m_OutputStream << "{\"otherData\": {},\"traceEvents\":[";
-        m_OutputStream.flush();
+        return std::chrono::duration<double, std::micro>(Clock::now().time_since_epoch()).count();
     }
 
-    void WriteFooter()
+private:
+    enum class EventType : uint32_t
+    {
+        Scope,          // start / end in ReadTicks ticks
+        Counter,        // start in ReadTicks ticks
+        TrackScope,     // start / end in microseconds, on track
+        TrackName,
+        ThreadName
+    };
+
+    struct ProfileEvent
+    {
+        long long start;
+        long long end;
+        double value;
+        uint32_t nameID;
+        EventType type;
+        uint32_t track;
+    };
+
+    // Single producer (the owning thread), single consumer (the writer thread)
+    struct ThreadBuffer
     {
-        m_OutputStream << "]}";
-        m_OutputStream.flush();
+        static constexpr uint32_t CAPACITY = 1 << 13;   // Power of two
+
+        alignas(64) std::atomic<uint32_t> head{ 0 };    // Written by the owning thread
+        alignas(64) std::atomic<uint32_t> tail{ 0 };    // Written by the writer thread
+        uint32_t threadID = 0;
+        std::array<ProfileEvent, CAPACITY> events;
+    };
+
+    Instrumentor() = default;
+    ~Instrumentor();
+
+    void Push(const ProfileEvent& event)
+    {
+        ThreadBuffer& buffer = GetThreadBuffer();
+        uint32_t head = buffer.head.load(std::memory_order_relaxed);
+        if (head - buffer.tail.load(std::memory_order_acquire) >= ThreadBuffer::CAPACITY)
+        {
+            m_DroppedEvents.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        buffer.events[head & (ThreadBuffer::CAPACITY - 1)] = event;
+        buffer.head.store(head + 1, std::memory_order_release);
     }
 
-    static Instrumentor& Get()
+    ThreadBuffer& GetThreadBuffer()
     {
-        static Instrumentor instance;
-        return instance;
+        static thread_local ThreadBuffer* buffer = nullptr;
+        if (buffer == nullptr)
+            buffer = RegisterThread();
+        return *buffer;
     }
+
+    ThreadBuffer* RegisterThread();
+    void UpdateCapturing();
+    void WriterLoop();
+    void Calibrate();
+    double TicksToMicroseconds(long long ticks) const;
+    void Drain();
+    void WriteEvent(const ProfileEvent& event, uint32_t threadID);
+    void WriteName(uint32_t nameID);
+
+    // Writer thread only (and EndSession once it is joined)
+    std::ofstream m_OutputStream;
+    bool m_FirstEvent = true;
+    std::vector<std::string> m_EscapedNames;    // By name id, filled on first use
+    long long m_TicksBase = 0;
+    double m_MicrosecondsBase = 0.0;
+    double m_TicksPerMicrosecond = 1.0;
+
+    std::atomic<bool> m_SessionActive{ false };
+    std::atomic<bool> m_CaptureEnabled{ true };
+    std::atomic<bool> m_Capturing{ false };
+    std::atomic<uint64_t> m_DroppedEvents{ 0 };
+
+    std::mutex m_BuffersMutex;      // Guards m_ThreadBuffers, taken on thread registration and by the writer
+    std::vector<std::unique_ptr<ThreadBuffer>> m_ThreadBuffers;     // Never freed, a thread may exit with events left
+
+    std::mutex m_NamesMutex;        // Interning only, the writer reads m_Names without it
+    std::unordered_map<const char*, uint32_t> m_NameIDs;
+    std::array<std::atomic<const char*>, MAX_NAMES> m_Names{};
+    uint32_t m_NameCount = 0;
+
+    std::thread m_Writer;
+    std::atomic<bool> m_WriterRunning{ false };
 };
 
 class InstrumentationTimer
 {
 public:
-    InstrumentationTimer(const char* name)
-        : m_Name(name), m_Stopped(false)
+    InstrumentationTimer(uint32_t nameID)
+        : m_NameID(nameID), m_Start(0), m_Stopped(!Instrumentor::Get().IsCapturing())
     {
-        m_StartTimepoint = std::chrono::high_resolution_clock::now();
+        if (!m_Stopped)
+            m_Start = Instrumentor::ReadTicks();
     }
 
     ~InstrumentationTimer()
@@ -118,23 +218,21 @@ public:
 
     void Stop()
     {
-        auto endTimepoint = std::chrono::high_resolution_clock::now();
-
-        long long start = std::chrono::time_point_cast<std::chrono::microseconds>(m_StartTimepoint).time_since_epoch().count();
-        long long end = std::chrono::time_point_cast<std::chrono::microseconds>(endTimepoint).time_since_epoch().count();
-
-        uint32_t threadID = std::hash<std::thread::id>{}(std::this_thread::get_id());
-        Instrumentor::Get().WriteProfile({ m_Name, start, end, threadID });
-
+        Instrumentor::Get().RecordScope(m_NameID, m_Start, Instrumentor::ReadTicks());
         m_Stopped = true;
     }
 private:
-    const char* m_Name;
-    std::chrono::time_point<std::chrono::high_resolution_clock> m_StartTimepoint;
+    uint32_t m_NameID;
+    long long m_Start;
     bool m_Stopped;
 };
 
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
 #define PROFILE_BEGIN(name, filepath) ::Instrumentor::Get().BeginSession(name, filepath)
 #define PROFILE_END() ::Instrumentor::Get().EndSession()
-#define PROFILE_SCOPE(name) ::InstrumentationTimer timer##__LINE__(name);
-#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCSIG__)
\ No newline at end of file
+#define PROFILE_SCOPE(name) static const uint32_t PROFILE_CONCAT(profileName, __LINE__) = ::Instrumentor::Get().InternName(name); \
+    ::InstrumentationTimer PROFILE_CONCAT(profileTimer, __LINE__)(PROFILE_CONCAT(profileName, __LINE__));
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCSIG__)
+#define PROFILE_COUNTER(name, value) { static const uint32_t profileCounterName = ::Instrumentor::Get().InternName(name); ::Instrumentor::Get().RecordCounter(profileCounterName, value); }
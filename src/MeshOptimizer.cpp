@@ -0,0 +1,352 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	// Forsyth's scoring constants, the cache here is the model the scores are tuned for, not the hardware one
+	const uint32_t FORSYTH_CACHE_SIZE = 32;
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	const uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+	float VertexScore(int cachePosition, uint32_t remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			return -1.0f;
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			// The three vertices of the last triangle get a fixed score so the next triangle doesn't just reuse the same edge
+			if (cachePosition < 3)
+			{
+				score = LAST_TRIANGLE_SCORE;
+			}
+			else
+			{
+				float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+				score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+			}
+		}
+
+		// Low valence vertices are finished first so they don't get stranded
+		score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+		return score;
+	}
+}
+
+MeshOptimizer::VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+	VertexCacheStatistics statistics{};
+	statistics.triangleCount = indexCount / 3;
+
+	// A vertex is cached while fewer than VERTEX_CACHE_SIZE misses happened since its own, hits don't refresh a FIFO
+	std::vector<uint32_t> missTimestamps(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t timestamp = VERTEX_CACHE_SIZE + 1;
+
+	for (uint32_t i = 0; i < statistics.triangleCount * 3; i++)
+	{
+		uint32_t index = indices[i];
+
+		if (timestamp - missTimestamps[index] > VERTEX_CACHE_SIZE)
+		{
+			missTimestamps[index] = timestamp++;
+			statistics.vertexTransforms++;
+		}
+
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			statistics.uniqueVertexCount++;
+		}
+	}
+
+	statistics.acmr = statistics.triangleCount ? static_cast<float>(statistics.vertexTransforms) / statistics.triangleCount : 0.0f;
+	statistics.atvr = statistics.uniqueVertexCount ? static_cast<float>(statistics.vertexTransforms) / statistics.uniqueVertexCount : 0.0f;
+	return statistics;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Vertex to triangle adjacency, the live part of each list shrinks as triangles are emitted
+	std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+	{
+		remainingTriangles[indices[i]]++;
+	}
+
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		triangleOffsets[v + 1] = triangleOffsets[v] + remainingTriangles[v];
+	}
+
+	std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+		{
+			vertexTriangles[fill[indices[i]]++] = i / 3;
+		}
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		vertexScores[v] = VertexScore(-1, remainingTriangles[v]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+
+	uint32_t bestTriangle = 0;
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > triangleScores[bestTriangle])
+		{
+			bestTriangle = t;
+		}
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	uint32_t searchCursor = 0;
+
+	for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		// Nothing in the cache has triangles left, restart from the next unused triangle
+		if (bestTriangle == INVALID_INDEX)
+		{
+			while (emitted[searchCursor])
+			{
+				searchCursor++;
+			}
+			bestTriangle = searchCursor;
+		}
+
+		const uint32_t* triangle = &indices[bestTriangle * 3];
+		emitted[bestTriangle] = true;
+		output.insert(output.end(), triangle, triangle + 3);
+
+		nextCache.clear();
+		for (int v = 0; v < 3; v++)
+		{
+			uint32_t vertex = triangle[v];
+			nextCache.push_back(vertex);
+
+			uint32_t* begin = &vertexTriangles[triangleOffsets[vertex]];
+			uint32_t* end = begin + remainingTriangles[vertex];
+			std::swap(*std::find(begin, end, bestTriangle), *(end - 1));
+			remainingTriangles[vertex]--;
+		}
+
+		for (uint32_t vertex : cache)
+		{
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+			{
+				nextCache.push_back(vertex);
+			}
+		}
+
+		// Vertices pushed out of the cache lose their cache score
+		for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); i++)
+		{
+			cachePositions[nextCache[i]] = -1;
+			vertexScores[nextCache[i]] = VertexScore(-1, remainingTriangles[nextCache[i]]);
+		}
+		nextCache.resize(std::min<size_t>(nextCache.size(), FORSYTH_CACHE_SIZE));
+		std::swap(cache, nextCache);
+
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			cachePositions[cache[i]] = static_cast<int>(i);
+			vertexScores[cache[i]] = VertexScore(static_cast<int>(i), remainingTriangles[cache[i]]);
+		}
+
+		// Only triangles touching the cache can have changed enough to matter
+		bestTriangle = INVALID_INDEX;
+		float bestScore = -1.0f;
+		for (uint32_t vertex : cache)
+		{
+			for (uint32_t i = 0; i < remainingTriangles[vertex]; i++)
+			{
+				uint32_t t = vertexTriangles[triangleOffsets[vertex] + i];
+				triangleScores[t] = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint32_t* indices, uint32_t indexCount, const void* positions, size_t positionStride, uint32_t vertexCount, float threshold)
+{
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	const uint8_t* positionBytes = static_cast<const uint8_t*>(positions);
+	auto position = [&](uint32_t index) -> const glm::vec3&
+	{
+		return *reinterpret_cast<const glm::vec3*>(positionBytes + index * positionStride);
+	};
+
+	VertexCacheStatistics before = AnalyzeVertexCache(indices, indexCount, vertexCount);
+
+	// A triangle that misses on all three vertices starts over anyway, cutting there costs no extra transforms
+	std::vector<uint32_t> clusterStarts;
+	{
+		std::vector<uint32_t> missTimestamps(vertexCount, 0);
+		uint32_t timestamp = VERTEX_CACHE_SIZE + 1;
+
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t misses = 0;
+			for (int v = 0; v < 3; v++)
+			{
+				uint32_t index = indices[t * 3 + v];
+				if (timestamp - missTimestamps[index] > VERTEX_CACHE_SIZE)
+				{
+					missTimestamps[index] = timestamp++;
+					misses++;
+				}
+			}
+
+			if (t == 0 || misses == 3)
+			{
+				clusterStarts.push_back(t);
+			}
+		}
+	}
+
+	if (clusterStarts.size() < 2)
+	{
+		return;
+	}
+
+	struct Cluster
+	{
+		uint32_t firstTriangle;
+		uint32_t triangleCount;
+		float sortKey;
+	};
+
+	std::vector<Cluster> clusters(clusterStarts.size());
+	std::vector<glm::vec3> clusterCentroids(clusterStarts.size());
+	std::vector<glm::vec3> clusterNormals(clusterStarts.size());
+
+	glm::vec3 meshCentroid{ 0.0f };
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		clusters[c].firstTriangle = clusterStarts[c];
+		clusters[c].triangleCount = (c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount) - clusterStarts[c];
+
+		glm::vec3 centroid{ 0.0f };
+		glm::vec3 normal{ 0.0f };
+		float area = 0.0f;
+
+		for (uint32_t t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; t++)
+		{
+			const glm::vec3& p0 = position(indices[t * 3 + 0]);
+			const glm::vec3& p1 = position(indices[t * 3 + 1]);
+			const glm::vec3& p2 = position(indices[t * 3 + 2]);
+
+			glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(triangleNormal) * 0.5f;
+
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += triangleNormal;
+			area += triangleArea;
+		}
+
+		clusterCentroids[c] = area > 0.0f ? centroid / area : glm::vec3(0.0f);
+		clusterNormals[c] = normal;
+
+		meshCentroid += centroid;
+		meshArea += area;
+	}
+
+	if (meshArea > 0.0f)
+	{
+		meshCentroid /= meshArea;
+	}
+
+	// Clusters far out along their own normal are likely to cover the rest of the mesh
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		float normalLength = glm::length(clusterNormals[c]);
+		clusters[c].sortKey = normalLength > 0.0f ? glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / normalLength) : 0.0f;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(triangleCount * 3);
+	for (const Cluster& cluster : clusters)
+	{
+		sorted.insert(sorted.end(), indices + cluster.firstTriangle * 3, indices + (cluster.firstTriangle + cluster.triangleCount) * 3);
+	}
+
+	VertexCacheStatistics after = AnalyzeVertexCache(sorted.data(), static_cast<uint32_t>(sorted.size()), vertexCount);
+	if (after.acmr <= before.acmr * threshold)
+	{
+		std::copy(sorted.begin(), sorted.end(), indices);
+	}
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexFetch(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount)
+{
+	std::vector<uint32_t> remap(vertexCount, INVALID_INDEX);
+	uint32_t nextVertex = 0;
+
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		if (remap[indices[i]] == INVALID_INDEX)
+		{
+			remap[indices[i]] = nextVertex++;
+		}
+	}
+
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == INVALID_INDEX)
+		{
+			remap[v] = nextVertex++;
+		}
+	}
+
+	return remap;
+}
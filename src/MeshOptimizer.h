@@ -0,0 +1,46 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Import time index and vertex reordering for indexed triangle lists.
+// Run order : OptimizeVertexCache, OptimizeOverdraw, then OptimizeVertexFetch once the final index lists exist.
+class MeshOptimizer
+{
+public:
+	struct VertexCacheStatistics
+	{
+		uint32_t vertexTransforms = 0;		// FIFO cache misses
+		uint32_t triangleCount = 0;
+		uint32_t uniqueVertexCount = 0;
+
+		float acmr = 0.0f;	// Transforms per triangle, 0.5 is the ideal for large regular meshes
+		float atvr = 0.0f;	// Transforms per referenced vertex, 1.0 is the ideal
+	};
+
+	// Simulated post-transform cache, a FIFO of this size is a fair middle ground for current hardware
+	static constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+	static VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount);
+
+	// Tom Forsyth's linear-speed vertex cache optimization, reorders triangles in place
+	static void OptimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount);
+
+	// Splits the cache optimized order into clusters at cache restarts and sorts them so outward facing clusters
+	// on the outside of the mesh draw first (Sander et al.). Kept only if ACMR stays within threshold times the input.
+	static void OptimizeOverdraw(
+		uint32_t* indices,
+		uint32_t indexCount,
+		const void* positions,
+		size_t positionStride,
+		uint32_t vertexCount,
+		float threshold = 1.05f);
+
+	// Returns remap[oldVertex] = newVertex, vertices are numbered in order of first use.
+	// Unreferenced vertices are moved to the end.
+	static std::vector<uint32_t> OptimizeVertexFetch(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount);
+};
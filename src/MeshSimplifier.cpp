@@ -0,0 +1,303 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+
+namespace
+{
+	// Symmetric 4x4 plane quadric, weight is the accumulated triangle area
+	struct Quadric
+	{
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+		double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+		double a22 = 0.0, a23 = 0.0;
+		double a33 = 0.0;
+		double weight = 0.0;
+
+		void AddPlane(const glm::dvec3& n, double d, double w)
+		{
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+			a22 += w * n.z * n.z; a23 += w * n.z * d;
+			a33 += w * d * d;
+			weight += w;
+		}
+
+		Quadric& operator+=(const Quadric& other)
+		{
+			a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+			a11 += other.a11; a12 += other.a12; a13 += other.a13;
+			a22 += other.a22; a23 += other.a23;
+			a33 += other.a33;
+			weight += other.weight;
+			return *this;
+		}
+
+		// Area weighted mean squared distance of p to the accumulated planes
+		double Evaluate(const glm::dvec3& p) const
+		{
+			double error =
+				a00 * p.x * p.x + 2.0 * a01 * p.x * p.y + 2.0 * a02 * p.x * p.z + 2.0 * a03 * p.x +
+				a11 * p.y * p.y + 2.0 * a12 * p.y * p.z + 2.0 * a13 * p.y +
+				a22 * p.z * p.z + 2.0 * a23 * p.z +
+				a33;
+
+			return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	uint64_t EdgeKey(uint32_t a, uint32_t b)
+	{
+		return (static_cast<uint64_t>(a) << 32) | b;
+	}
+}
+
+std::vector<uint32_t> MeshSimplifier::Simplify(
+	const void* positions,
+	size_t positionStride,
+	uint32_t vertexCount,
+	const uint32_t* indices,
+	uint32_t indexCount,
+	uint32_t targetIndexCount,
+	float maxError,
+	float* resultError)
+{
+	std::vector<uint32_t> result(indices, indices + (indexCount / 3) * 3);
+
+	if (resultError)
+	{
+		*resultError = 0.0f;
+	}
+
+	if (vertexCount == 0 || result.size() <= targetIndexCount)
+	{
+		return result;
+	}
+
+	const uint8_t* positionBytes = static_cast<const uint8_t*>(positions);
+	std::vector<glm::dvec3> vertexPositions(vertexCount);
+
+	glm::dvec3 boundsMin{ std::numeric_limits<double>::max() };
+	glm::dvec3 boundsMax{ std::numeric_limits<double>::lowest() };
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		vertexPositions[v] = glm::dvec3(*reinterpret_cast<const glm::vec3*>(positionBytes + v * positionStride));
+		boundsMin = glm::min(boundsMin, vertexPositions[v]);
+		boundsMax = glm::max(boundsMax, vertexPositions[v]);
+	}
+
+	const double extent = glm::length(boundsMax - boundsMin);
+	if (extent <= 0.0)
+	{
+		return result;
+	}
+
+	const double maxCost = (maxError * extent) * (maxError * extent);
+
+	// Plane quadrics from the source triangles
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const glm::dvec3& p0 = vertexPositions[result[i + 0]];
+		const glm::dvec3& p1 = vertexPositions[result[i + 1]];
+		const glm::dvec3& p2 = vertexPositions[result[i + 2]];
+
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(normal);
+		if (length <= 0.0)
+		{
+			continue;
+		}
+
+		normal /= length;
+		double area = length * 0.5;
+		double distance = -glm::dot(normal, p0);
+
+		quadrics[result[i + 0]].AddPlane(normal, distance, area);
+		quadrics[result[i + 1]].AddPlane(normal, distance, area);
+		quadrics[result[i + 2]].AddPlane(normal, distance, area);
+	}
+
+	// An edge without its reverse is an open border or a seam where the vertex was split
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_set<uint64_t> directedEdges;
+		directedEdges.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				directedEdges.insert(EdgeKey(result[i + e], result[i + (e + 1) % 3]));
+			}
+		}
+
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				uint32_t a = result[i + e];
+				uint32_t b = result[i + (e + 1) % 3];
+				if (directedEdges.find(EdgeKey(b, a)) == directedEdges.end())
+				{
+					locked[a] = true;
+					locked[b] = true;
+				}
+			}
+		}
+	}
+
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+	std::vector<uint32_t> vertexTriangles;
+	std::vector<Collapse> collapses;
+	double largestCost = 0.0;
+
+	while (result.size() > targetIndexCount)
+	{
+		// Vertex to triangle adjacency for this pass
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (uint32_t index : result)
+		{
+			triangleOffsets[index + 1]++;
+		}
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			triangleOffsets[v + 1] += triangleOffsets[v];
+		}
+
+		vertexTriangles.resize(result.size());
+		{
+			std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (size_t i = 0; i < result.size(); i++)
+			{
+				vertexTriangles[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				uint32_t from = result[i + e];
+				uint32_t to = result[i + (e + 1) % 3];
+
+				for (int direction = 0; direction < 2; direction++)
+				{
+					if (!locked[from])
+					{
+						Quadric quadric = quadrics[from];
+						quadric += quadrics[to];
+						collapses.push_back({ from, to, quadric.Evaluate(vertexPositions[to]) });
+					}
+					std::swap(from, to);
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			remap[v] = v;
+		}
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t remainingIndices = result.size();
+		uint32_t collapseCount = 0;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.cost > maxCost || remainingIndices <= targetIndexCount)
+			{
+				break;
+			}
+
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+
+			// Reject collapses that flip or squash a surviving triangle
+			bool valid = true;
+			uint32_t removedTriangles = 0;
+			for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && valid; t++)
+			{
+				const uint32_t* triangle = &result[vertexTriangles[t] * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					removedTriangles++;
+					continue;
+				}
+
+				int corner = triangle[0] == collapse.from ? 0 : (triangle[1] == collapse.from ? 1 : 2);
+				const glm::dvec3& p1 = vertexPositions[triangle[(corner + 1) % 3]];
+				const glm::dvec3& p2 = vertexPositions[triangle[(corner + 2) % 3]];
+
+				glm::dvec3 before = glm::cross(p1 - vertexPositions[collapse.from], p2 - vertexPositions[collapse.from]);
+				glm::dvec3 after = glm::cross(p1 - vertexPositions[collapse.to], p2 - vertexPositions[collapse.to]);
+
+				valid = glm::dot(before, after) > 0.25 * glm::length(before) * glm::length(after);
+			}
+
+			if (!valid || removedTriangles == 0)
+			{
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to] += quadrics[collapse.from];
+			largestCost = std::max(largestCost, collapse.cost);
+
+			// The whole one-ring changes shape, keep it out of the rest of this pass
+			for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; t++)
+			{
+				const uint32_t* triangle = &result[vertexTriangles[t] * 3];
+				touched[triangle[0]] = true;
+				touched[triangle[1]] = true;
+				touched[triangle[2]] = true;
+			}
+
+			remainingIndices -= removedTriangles * 3;
+			collapseCount++;
+		}
+
+		if (collapseCount == 0)
+		{
+			break;
+		}
+
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = remap[result[i + 0]];
+			uint32_t b = remap[result[i + 1]];
+			uint32_t c = remap[result[i + 2]];
+
+			if (a != b && b != c && a != c)
+			{
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+
+	if (resultError)
+	{
+		*resultError = static_cast<float>(std::sqrt(largestCost) / extent);
+	}
+
+	return result;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Quadric error metric edge collapse (Garland & Heckbert) over an indexed triangle list.
+// Collapses are half-edge : a vertex is merged onto one of its neighbours, so the result still
+// indexes the original vertex buffer and every LOD can share it.
+// Open borders and attribute seams (split vertices) are locked so silhouettes and UVs hold.
+class MeshSimplifier
+{
+public:
+	// Collapses edges cheapest first until the index count reaches targetIndexCount or the next collapse
+	// would move the surface further than maxError (relative to the bounding box diagonal).
+	// resultError receives the largest relative error introduced, can be nullptr.
+	static std::vector<uint32_t> Simplify(
+		const void* positions,
+		size_t positionStride,
+		uint32_t vertexCount,
+		const uint32_t* indices,
+		uint32_t indexCount,
+		uint32_t targetIndexCount,
+		float maxError,
+		float* resultError = nullptr);
+};
@@ -1,8 +1,12 @@
 #include "Model.h"
+#include "Graphics/RenderStats.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm/gtx/hash.hpp>
 #include <glm/glm/gtc/type_ptr.hpp>
+#include <glm/glm/gtc/packing.hpp>
 
 #define TINYGLTF_IMPLEMENTATION
 //#define STB_IMAGE_IMPLEMENTATION
@@ -11,8 +15,10 @@
 #include <tiny_gltf/tiny_gltf.h>
 
 #include <iostream>
+#include <algorithm>
 
-Model::Model(Device& device, const std::string& filePath, DescriptorSetLayout& materialSetLayout, DescriptorPool& descriptorPool) : m_Device{device}
+Model::Model(Device& device, const std::string& filePath, MaterialLibrary& materialLibrary, std::shared_ptr<GeometryArena> geometryArena)
+	: m_Device{device}, m_GeometryArena{geometryArena}
 {
 	std::string warn, err;
 	tinygltf::TinyGLTF gltfLoader;
@@ -30,16 +36,25 @@ Model::Model(Device& device, const std::string& filePath, DescriptorSetLayout& m
 		m_Textures.push_back(std::make_shared<Texture>(m_Device, path.parent_path().append(texture.uri).generic_string()));
 	}
 
+	// One bindless material per glTF material, primitives only carry its ID
+	Material defaultMaterial = CreateMaterial(materialLibrary, nullptr, gltfModel);
+	std::vector<Material> materials;
+	for (auto& gltfMaterial : gltfModel.materials)
+	{
+		materials.push_back(CreateMaterial(materialLibrary, &gltfMaterial, gltfModel));
+	}
+
 	for (auto& scene : gltfModel.scenes)
 	{
 		for (size_t i = 0; i < scene.nodes.size(); i++)
 		{
 			auto& node = gltfModel.nodes[i];
-			uint32_t vertexOffset = 0;
-			uint32_t indexOffset = 0;
 
 			for (auto& gltfPrimitive : gltfModel.meshes[node.mesh].primitives)
 			{
+				// Offsets into the model wide arrays, primitives of every node share them
+				uint32_t vertexOffset = static_cast<uint32_t>(m_Vertices.size());
+				uint32_t indexOffset = static_cast<uint32_t>(m_Indices.size());
 				uint32_t vertexCount = 0;
 				uint32_t indexCount = 0;
 
@@ -81,11 +96,13 @@ Model::Model(Device& device, const std::string& filePath, DescriptorSetLayout& m
 				{
 					Vertex vertex{};
 					vertex.position = glm::make_vec3(&positionsBuffer[v * 3]);
-					vertex.color = glm::vec3(1.0f);
 					vertex.normal = glm::normalize(glm::vec3(normalsBuffer ? glm::make_vec3(&normalsBuffer[v * 3]) : glm::vec3(0.0f)));
 					vertex.tangent = glm::vec4(tangentsBuffer ? glm::make_vec4(&tangentsBuffer[v * 4]) : glm::vec4(0.0f));
 					vertex.uv = texCoordsBuffer ? glm::make_vec2(&texCoordsBuffer[v * 2]) : glm::vec2(0.0f);
 
+					m_BoundsMin = glm::min(m_BoundsMin, vertex.position);
+					m_BoundsMax = glm::max(m_BoundsMax, vertex.position);
+
 					m_Vertices.push_back(vertex);
 				}
 
@@ -125,127 +142,253 @@ Model::Model(Device& device, const std::string& filePath, DescriptorSetLayout& m
 					}
 				}
 
-				std::shared_ptr<Texture> defaultTexture = std::make_shared<Texture>(m_Device, "Assets/Textures/white.png");
-
-				Material material{};
-				if (gltfPrimitive.material != -1)
-				{
-					tinygltf::Material& gltfPrimitiveMaterial = gltfModel.materials[gltfPrimitive.material];
-
-					if (gltfPrimitiveMaterial.pbrMetallicRoughness.baseColorTexture.index != -1)
-					{
-						uint32_t textureIndex = gltfPrimitiveMaterial.pbrMetallicRoughness.baseColorTexture.index;
-						uint32_t imageIndex = gltfModel.textures[textureIndex].source;
-						material.albedoTexture = m_Textures[imageIndex];
-					}
-					else
-					{
-						material.albedoTexture = defaultTexture;
-					}
-
-					if (gltfPrimitiveMaterial.pbrMetallicRoughness.metallicRoughnessTexture.index != -1)
-					{
-						uint32_t textureIndex = gltfPrimitiveMaterial.pbrMetallicRoughness.metallicRoughnessTexture.index;
-						uint32_t imageIndex = gltfModel.textures[textureIndex].source;
-						material.metallicRoughnessTexture = m_Textures[imageIndex];
-					}
-					else
-					{
-						material.metallicRoughnessTexture = defaultTexture;
-					}
-
-					if (gltfPrimitiveMaterial.normalTexture.index != -1)
-					{
-						uint32_t textureIndex = gltfPrimitiveMaterial.normalTexture.index;
-						uint32_t imageIndex = gltfModel.textures[textureIndex].source;
-						material.normalTexture = m_Textures[imageIndex];
-					}
-					else
-					{
-						material.normalTexture = defaultTexture;
-					}
-				}
-				else
-				{
-					material.albedoTexture = defaultTexture;
-					material.normalTexture = defaultTexture;
-					material.metallicRoughnessTexture = defaultTexture;
-				}
-
-				VkDescriptorImageInfo albedoInfo = {};
-				albedoInfo.sampler = material.albedoTexture->GetSampler();
-				albedoInfo.imageView = material.albedoTexture->GetImageView();
-				albedoInfo.imageLayout = material.albedoTexture->GetImageLayout();
-
-				VkDescriptorImageInfo normalInfo = {};
-				normalInfo.sampler = material.normalTexture->GetSampler();
-				normalInfo.imageView = material.normalTexture->GetImageView();
-				normalInfo.imageLayout = material.normalTexture->GetImageLayout();
-
-				VkDescriptorImageInfo metallicRoughnessInfo = {};
-				metallicRoughnessInfo.sampler = material.metallicRoughnessTexture->GetSampler();
-				metallicRoughnessInfo.imageView = material.metallicRoughnessTexture->GetImageView();
-				metallicRoughnessInfo.imageLayout = material.metallicRoughnessTexture->GetImageLayout();
-
-				DescriptorWriter(materialSetLayout, descriptorPool)
-					.writeImage(0, &albedoInfo)
-					.writeImage(1, &normalInfo)
-					.writeImage(2, &metallicRoughnessInfo)
-					.build(material.descriptorSet);
-
 				Primitive primitive{};
 				primitive.firstIndex = indexOffset;
 				primitive.firstVertex = vertexOffset;
 				primitive.indexCount = indexCount;
 				primitive.vertexCount = vertexCount;
-				primitive.material = material;
+				primitive.material = gltfPrimitive.material != -1 ? materials[gltfPrimitive.material] : defaultMaterial;
 				
 				m_Primitives.push_back(primitive);
-
-				vertexOffset += vertexCount;
-				indexOffset += indexCount;
 			}
 		}
-		CreateVertexBuffers(m_Vertices);
-		CreateIndexBuffer(m_Indices);
 	}
+
+	OptimizeIndices(path.filename().string());
+	GenerateLods();
+	OptimizeVertexFetch();
+	CreateVertexBuffers(m_Vertices);
+	CreateIndexBuffer(m_Indices);
 }
 
 
 Model::~Model()
 {
+	m_GeometryArena->FreeVertices(m_VertexHandle);
+	m_GeometryArena->FreeIndices(m_IndexHandle, m_IndexType);
 }
 
-void Model::Bind(VkCommandBuffer commandBuffer)
+Model::Material Model::CreateMaterial(MaterialLibrary& materialLibrary, const tinygltf::Material* gltfMaterial, const tinygltf::Model& gltfModel)
 {
-	VkBuffer buffers[] = { m_VertexBuffer->getBuffer() };
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	auto getTexture = [&](int textureIndex) -> std::shared_ptr<Texture>
+	{
+		if (textureIndex == -1)
+		{
+			return materialLibrary.GetDefaultTexture();
+		}
+		return m_Textures[gltfModel.textures[textureIndex].source];
+	};
 
-	if (m_HasIndexBuffer)
+	Material material{};
+	if (gltfMaterial)
+	{
+		const auto& pbr = gltfMaterial->pbrMetallicRoughness;
+
+		material.albedoTexture = getTexture(pbr.baseColorTexture.index);
+		material.metallicRoughnessTexture = getTexture(pbr.metallicRoughnessTexture.index);
+		material.normalTexture = getTexture(gltfMaterial->normalTexture.index);
+		material.emissiveTexture = getTexture(gltfMaterial->emissiveTexture.index);
+		material.occlusionTexture = getTexture(gltfMaterial->occlusionTexture.index);
+
+		material.albedoFactor = glm::vec4(glm::make_vec4(pbr.baseColorFactor.data()));
+		material.emissiveFactor = glm::vec4(glm::make_vec3(gltfMaterial->emissiveFactor.data()), 1.0f);
+		material.metallicFactor = static_cast<float>(pbr.metallicFactor);
+		material.roughnessFactor = static_cast<float>(pbr.roughnessFactor);
+	}
+	else
 	{
-		vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+		material.albedoTexture = materialLibrary.GetDefaultTexture();
+		material.metallicRoughnessTexture = materialLibrary.GetDefaultTexture();
+		material.normalTexture = materialLibrary.GetDefaultTexture();
+		material.emissiveTexture = materialLibrary.GetDefaultTexture();
+		material.occlusionTexture = materialLibrary.GetDefaultTexture();
+		material.emissiveFactor = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
 	}
+
+	MaterialLibrary::GPUMaterial gpuMaterial{};
+	gpuMaterial.albedoFactor = material.albedoFactor;
+	gpuMaterial.emissiveFactor = glm::vec4(glm::vec3(material.emissiveFactor), material.emissiveStrength);
+	gpuMaterial.metallicFactor = material.metallicFactor;
+	gpuMaterial.roughnessFactor = material.roughnessFactor;
+	gpuMaterial.albedoTexture = materialLibrary.RegisterTexture(material.albedoTexture);
+	gpuMaterial.normalTexture = materialLibrary.RegisterTexture(material.normalTexture);
+	gpuMaterial.metallicRoughnessTexture = materialLibrary.RegisterTexture(material.metallicRoughnessTexture);
+	gpuMaterial.emissiveTexture = materialLibrary.RegisterTexture(material.emissiveTexture);
+	gpuMaterial.occlusionTexture = materialLibrary.RegisterTexture(material.occlusionTexture);
+
+	// glTF samplers are per texture, the base color one decides for the whole material
+	gpuMaterial.sampler = MaterialLibrary::LINEAR_REPEAT;
+	if (gltfMaterial && gltfMaterial->pbrMetallicRoughness.baseColorTexture.index != -1)
+	{
+		int samplerIndex = gltfModel.textures[gltfMaterial->pbrMetallicRoughness.baseColorTexture.index].sampler;
+		if (samplerIndex != -1 && gltfModel.samplers[samplerIndex].wrapS == TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE)
+		{
+			gpuMaterial.sampler = MaterialLibrary::LINEAR_CLAMP;
+		}
+	}
+
+	material.materialIndex = materialLibrary.AddMaterial(gpuMaterial);
+	return material;
 }
 
-void Model::Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, int setCount, bool renderMaterial)
+void Model::Draw(VkCommandBuffer commandBuffer, uint32_t lod)
 {
+	// Offsets of this model inside the shared arena buffers, they can move on defragmentation
+	uint32_t arenaFirstVertex = m_GeometryArena->GetFirstVertex(m_VertexHandle);
+	uint32_t arenaFirstIndex = 0;
+
+	if (m_HasIndexBuffer)
+	{
+		m_GeometryArena->BindIndexBuffer(commandBuffer, m_IndexType);
+		arenaFirstIndex = m_GeometryArena->GetFirstIndex(m_IndexHandle, m_IndexType);
+	}
+
 	for (auto& primitive : m_Primitives)
 	{
+		// The material ID rides in firstInstance, shaders read it back from gl_InstanceIndex
+		uint32_t materialIndex = primitive.material.materialIndex;
+
 		if (m_HasIndexBuffer)
 		{
-			//sets.push_back(primitive.material.descriptorSet);
-			// my god
-			if (renderMaterial)
+			if (primitive.lods.empty())
+			{
+				CmdDrawIndexed(commandBuffer, primitive.indexCount, 1, arenaFirstIndex + primitive.firstIndex, arenaFirstVertex + primitive.firstVertex, materialIndex);
+			}
+			else
 			{
-				std::vector<VkDescriptorSet> sets = { primitive.material.descriptorSet };
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, setCount, sets.size(), sets.data(), 0, nullptr);
+				const Lod& selected = primitive.lods[std::min<size_t>(lod, primitive.lods.size() - 1)];
+				CmdDrawIndexed(commandBuffer, selected.indexCount, 1, arenaFirstIndex + selected.firstIndex, arenaFirstVertex + primitive.firstVertex, materialIndex);
 			}
-			vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, primitive.firstVertex, 0);
 		}
 		else
 		{
-			vkCmdDraw(commandBuffer, primitive.vertexCount, 1, 0, 0);
+			CmdDraw(commandBuffer, primitive.vertexCount, 1, arenaFirstVertex + primitive.firstVertex, materialIndex);
+		}
+	}
+}
+
+void Model::OptimizeIndices(const std::string& name)
+{
+	MeshOptimizer::VertexCacheStatistics before{};
+	MeshOptimizer::VertexCacheStatistics after{};
+
+	for (auto& primitive : m_Primitives)
+	{
+		if (!primitive.lods.empty() || primitive.indexCount == 0)
+		{
+			continue;
+		}
+
+		uint32_t* indices = &m_Indices[primitive.firstIndex];
+		const void* positions = &m_Vertices[primitive.firstVertex].position;
+
+		MeshOptimizer::VertexCacheStatistics primitiveBefore = MeshOptimizer::AnalyzeVertexCache(indices, primitive.indexCount, primitive.vertexCount);
+
+		MeshOptimizer::OptimizeVertexCache(indices, primitive.indexCount, primitive.vertexCount);
+		MeshOptimizer::OptimizeOverdraw(indices, primitive.indexCount, positions, sizeof(Vertex), primitive.vertexCount);
+
+		MeshOptimizer::VertexCacheStatistics primitiveAfter = MeshOptimizer::AnalyzeVertexCache(indices, primitive.indexCount, primitive.vertexCount);
+
+		before.vertexTransforms += primitiveBefore.vertexTransforms;
+		before.triangleCount += primitiveBefore.triangleCount;
+		before.uniqueVertexCount += primitiveBefore.uniqueVertexCount;
+
+		after.vertexTransforms += primitiveAfter.vertexTransforms;
+		after.triangleCount += primitiveAfter.triangleCount;
+		after.uniqueVertexCount += primitiveAfter.uniqueVertexCount;
+	}
+
+	if (before.triangleCount == 0)
+	{
+		return;
+	}
+
+	std::cout << "Model " << name << " : " << before.triangleCount << " triangles"
+		<< ", ACMR " << static_cast<float>(before.vertexTransforms) / before.triangleCount << " -> " << static_cast<float>(after.vertexTransforms) / after.triangleCount
+		<< ", ATVR " << static_cast<float>(before.vertexTransforms) / before.uniqueVertexCount << " -> " << static_cast<float>(after.vertexTransforms) / after.uniqueVertexCount
+		<< std::endl;
+}
+
+void Model::OptimizeVertexFetch()
+{
+	std::vector<Vertex> reordered;
+
+	for (auto& primitive : m_Primitives)
+	{
+		if (primitive.lods.empty() || primitive.vertexCount == 0)
+		{
+			continue;
+		}
+
+		// LOD0 references every vertex the coarser levels do, so its first use order covers them all
+		std::vector<uint32_t> remap = MeshOptimizer::OptimizeVertexFetch(&m_Indices[primitive.firstIndex], primitive.indexCount, primitive.vertexCount);
+
+		reordered.resize(primitive.vertexCount);
+		for (uint32_t v = 0; v < primitive.vertexCount; v++)
+		{
+			reordered[remap[v]] = m_Vertices[primitive.firstVertex + v];
+		}
+		std::copy(reordered.begin(), reordered.end(), m_Vertices.begin() + primitive.firstVertex);
+
+		for (auto& lod : primitive.lods)
+		{
+			for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; i++)
+			{
+				m_Indices[i] = remap[m_Indices[i]];
+			}
+		}
+	}
+}
+
+void Model::GenerateLods()
+{
+	// Each level aims for half the triangles of the previous one
+	const float lodReduction = 0.5f;
+	const float lodMaxError = 0.02f;
+	const uint32_t lodMinTriangles = 64;
+
+	for (auto& primitive : m_Primitives)
+	{
+		if (!primitive.lods.empty())
+		{
+			continue;
+		}
+
+		primitive.lods.push_back({ primitive.firstIndex, primitive.indexCount, 0.0f });
+
+		std::vector<uint32_t> source(m_Indices.begin() + primitive.firstIndex, m_Indices.begin() + primitive.firstIndex + primitive.indexCount);
+		for (uint32_t lod = 1; lod < MAX_LOD_COUNT; lod++)
+		{
+			uint32_t targetIndexCount = static_cast<uint32_t>(source.size() * lodReduction) / 3 * 3;
+			if (targetIndexCount < lodMinTriangles * 3)
+			{
+				break;
+			}
+
+			float error = 0.0f;
+			std::vector<uint32_t> simplified = MeshSimplifier::Simplify(
+				&m_Vertices[primitive.firstVertex].position,
+				sizeof(Vertex),
+				primitive.vertexCount,
+				source.data(),
+				static_cast<uint32_t>(source.size()),
+				targetIndexCount,
+				lodMaxError,
+				&error);
+
+			// Locked borders or the error limit stopped it, another level would barely differ
+			if (simplified.empty() || simplified.size() > source.size() * 9 / 10)
+			{
+				break;
+			}
+
+			// Collapses leave the triangle order scattered
+			MeshOptimizer::OptimizeVertexCache(simplified.data(), static_cast<uint32_t>(simplified.size()), primitive.vertexCount);
+
+			primitive.lods.push_back({ static_cast<uint32_t>(m_Indices.size()), static_cast<uint32_t>(simplified.size()), error });
+			m_Indices.insert(m_Indices.end(), simplified.begin(), simplified.end());
+
+			source = std::move(simplified);
 		}
 	}
 }
@@ -254,28 +397,16 @@ void Model::CreateVertexBuffers(const std::vector<Vertex>& vertices)
 {
 	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
 	assert(vertexCount >= 3 && "Vertex count must be at least 3");
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-	uint32_t vertexSize = sizeof(vertices[0]);
 
-	Buffer stagingBuffer
+	std::vector<glm::vec3> positions(vertexCount);
+	std::vector<PackedVertex> packedVertices(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++)
 	{
-		m_Device,
-		vertexSize,
-		vertexCount,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-	};
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void*)vertices.data());
-
-	m_VertexBuffer = std::make_unique<Buffer>(
-		m_Device,
-		vertexSize,
-		vertexCount,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		positions[i] = vertices[i].position;
+		packedVertices[i] = PackedVertex::Pack(vertices[i]);
+	}
 
-	m_Device.copyBuffer(stagingBuffer.getBuffer(), m_VertexBuffer->getBuffer(), bufferSize);
+	m_VertexHandle = m_GeometryArena->UploadVertices(positions.data(), packedVertices.data(), vertexCount);
 }
 
 void Model::CreateIndexBuffer(const std::vector<uint32_t>& indices)
@@ -286,50 +417,91 @@ void Model::CreateIndexBuffer(const std::vector<uint32_t>& indices)
 	{
 		return;
 	}
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-	uint32_t  indexSize = sizeof(indices[0]);
 
-	Buffer stagingBuffer
+	// Indices are relative to each primitive's first vertex, so 16 bits cover the model when every primitive is small enough.
+	// The index type is bound once per model, one large primitive keeps the whole model at 32 bits.
+	bool shortIndices = std::all_of(m_Primitives.begin(), m_Primitives.end(), [](const Primitive& primitive) { return primitive.vertexCount <= 65536; });
+
+	std::vector<uint16_t> indices16;
+	const void* indexData = indices.data();
+	m_IndexType = VK_INDEX_TYPE_UINT32;
+
+	if (shortIndices)
 	{
-		m_Device,
-		indexSize,
-		indexCount,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-	};
+		indices16.assign(indices.begin(), indices.end());
+		indexData = indices16.data();
+		m_IndexType = VK_INDEX_TYPE_UINT16;
+	}
+
+	m_IndexHandle = m_GeometryArena->UploadIndices(indexData, m_IndexType, indexCount);
+}
 
-	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void*)indices.data());
+// Unit vector -> [-1, 1]^2, matches DecodeOctahedral in the shaders
+static glm::vec2 EncodeOctahedral(glm::vec3 n)
+{
+	float length = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+	if (length <= 0.0f)
+	{
+		return glm::vec2(0.0f);
+	}
 
-	m_IndexBuffer = std::make_unique<Buffer>(
-		m_Device,
-		indexSize,
-		indexCount,
-		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	n /= length;
+	if (n.z < 0.0f)
+	{
+		glm::vec2 wrapped = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		n.x = wrapped.x;
+		n.y = wrapped.y;
+	}
+	return glm::vec2(n.x, n.y);
+}
 
-	m_Device.copyBuffer(stagingBuffer.getBuffer(), m_IndexBuffer->getBuffer(), bufferSize);
+Model::PackedVertex Model::PackedVertex::Pack(const Vertex& vertex)
+{
+	PackedVertex packed{};
+	packed.normal = glm::packSnorm2x16(EncodeOctahedral(vertex.normal));
+	packed.tangent = glm::packSnorm2x16(EncodeOctahedral(glm::vec3(vertex.tangent)));
+	packed.uv = glm::packHalf2x16(vertex.uv);
+	return packed;
 }
 
-std::vector<VkVertexInputBindingDescription> Model::Vertex::getBindingDescriptions()
+std::vector<VkVertexInputBindingDescription> Model::PackedVertex::getBindingDescriptions()
 {
-	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions(2);
 	bindingDescriptions[0].binding = 0;
-	bindingDescriptions[0].stride = sizeof(Vertex);
+	bindingDescriptions[0].stride = sizeof(glm::vec3);
 	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
+	bindingDescriptions[1].binding = 1;
+	bindingDescriptions[1].stride = sizeof(PackedVertex);
+	bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
 	return bindingDescriptions;
 }
 
-std::vector<VkVertexInputAttributeDescription> Model::Vertex::getAttributeDescriptions()
+std::vector<VkVertexInputAttributeDescription> Model::PackedVertex::getAttributeDescriptions()
 {
 	std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 
-	attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT , offsetof(Vertex, position) });
-	attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R32G32B32_SFLOAT , offsetof(Vertex, color) });
-	attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R32G32B32_SFLOAT , offsetof(Vertex, normal) });
-	attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R32G32B32A32_SFLOAT , offsetof(Vertex, tangent) });
-	attributeDescriptions.push_back({ 4, 0, VK_FORMAT_R32G32_SFLOAT , offsetof(Vertex, uv) });
+	attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT , 0 });
+	attributeDescriptions.push_back({ 1, 1, VK_FORMAT_R16G16_SNORM , offsetof(PackedVertex, normal) });
+	attributeDescriptions.push_back({ 2, 1, VK_FORMAT_R16G16_SNORM , offsetof(PackedVertex, tangent) });
+	attributeDescriptions.push_back({ 3, 1, VK_FORMAT_R16G16_SFLOAT , offsetof(PackedVertex, uv) });
 
 	return attributeDescriptions;
 }
+
+std::vector<VkVertexInputBindingDescription> Model::PackedVertex::getPositionBindingDescriptions()
+{
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions = getBindingDescriptions();
+	bindingDescriptions.resize(1);
+
+	return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> Model::PackedVertex::getPositionAttributeDescriptions()
+{
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions = getAttributeDescriptions();
+	attributeDescriptions.resize(1);
+
+	return attributeDescriptions;
+}
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "Graphics/Texture.h"
 #include "Graphics/Device.h"
 #include "Graphics/Descriptor.h"
+#include "Graphics/GeometryArena.h"
+#include "Graphics/MaterialLibrary.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -11,6 +13,13 @@
 #include <memory>
 #include <vector>
 #include <filesystem>
+#include <limits>
+
+namespace tinygltf
+{
+	struct Material;
+	class Model;
+}
 
 class Model
 {
@@ -29,7 +38,15 @@ public:
 		float metallicFactor = 1.0f;
 		float roughnessFactor = 1.0f;
 
-		VkDescriptorSet descriptorSet;
+		uint32_t materialIndex = 0;	// Into the MaterialLibrary storage buffer
+	};
+
+	// Index range of one level of detail inside the shared index buffer
+	struct Lod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error;	// Relative to the primitive bounds diagonal
 	};
 
 	struct Primitive
@@ -39,47 +56,84 @@ public:
 		uint32_t indexCount;
 		uint32_t vertexCount;
 		Material material;
+		std::vector<Lod> lods;	// lods[0] is the authored mesh
 	};
 
+	static constexpr uint32_t MAX_LOD_COUNT = 4;
+
+	// Full precision import format, kept on the CPU for simplification, optimization and occlusion culling
 	struct Vertex
 	{
 		glm::vec3 position {};
-		glm::vec3 color {};
 		glm::vec3 normal {};
 		glm::vec4 tangent {};
 		glm::vec2 uv {};
 
-		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
-
 		bool operator==(const Vertex& other) const
 		{
 			return
 				position == other.position &&
-				color == other.color &&
 				normal == other.normal &&
 				uv == other.uv;
 		}
 	};
 
-	Model(Device& device, const std::string& filePath, DescriptorSetLayout& materialSetLayout, DescriptorPool& descriptorPool);
+	// GPU format, split in two streams : binding 0 holds tightly packed float3 positions,
+	// binding 1 holds the rest (12 bytes) so depth and shadow passes only fetch positions
+	struct PackedVertex
+	{
+		uint32_t normal {};		// Octahedral encoded, 2 x snorm16
+		uint32_t tangent {};	// Octahedral encoded, 2 x snorm16, handedness is not stored
+		uint32_t uv {};			// 2 x half
+
+		static PackedVertex Pack(const Vertex& vertex);
+
+		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+
+		static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+		static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
+	};
+
+	// Geometry is uploaded into the shared arena, bind it once with GeometryArena::Bind before drawing.
+	// Materials are registered in materialLibrary, bind its descriptor set once per pass.
+	Model(Device& device, const std::string& filePath, MaterialLibrary& materialLibrary, std::shared_ptr<GeometryArena> geometryArena);
 	~Model();
 
-	void Bind(VkCommandBuffer commandBuffer);
-	void Draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, int setCount, bool renderMaterial);
+	// lod is clamped per primitive to the coarsest level it has
+	void Draw(VkCommandBuffer commandBuffer, uint32_t lod = 0);
+
+	// Object space bounds, used for CPU occlusion culling
+	const glm::vec3& GetBoundsMin() const { return m_BoundsMin; }
+	const glm::vec3& GetBoundsMax() const { return m_BoundsMax; }
+
+	const std::vector<Vertex>& GetVertices() const { return m_Vertices; }
+	const std::vector<uint32_t>& GetIndices() const { return m_Indices; }
+	const std::vector<Primitive>& GetPrimitives() const { return m_Primitives; }
 
 private:
+	// gltfMaterial is null for primitives without a material
+	Material CreateMaterial(MaterialLibrary& materialLibrary, const tinygltf::Material* gltfMaterial, const tinygltf::Model& gltfModel);
 	void CreateVertexBuffers(const std::vector<Vertex>& vertices);
 	void CreateIndexBuffer(const std::vector<uint32_t>& indices);
+	void OptimizeIndices(const std::string& name);
+	void GenerateLods();
+	void OptimizeVertexFetch();
 
 	Device& m_Device;
 
-	std::unique_ptr<Buffer> m_VertexBuffer;
-	std::unique_ptr<Buffer> m_IndexBuffer;
+	// Shared so the arena outlives every model still referenced by the ECS
+	std::shared_ptr<GeometryArena> m_GeometryArena;
+	GeometryArena::Handle m_VertexHandle = GeometryArena::INVALID_HANDLE;
+	GeometryArena::Handle m_IndexHandle = GeometryArena::INVALID_HANDLE;
 	bool m_HasIndexBuffer = false;
+	VkIndexType m_IndexType = VK_INDEX_TYPE_UINT32;
 
 	std::vector<Vertex> m_Vertices;
 	std::vector<uint32_t> m_Indices;
 	std::vector<Primitive> m_Primitives;
 	std::vector<std::shared_ptr<Texture>> m_Textures;
+
+	glm::vec3 m_BoundsMin{ std::numeric_limits<float>::max() };
+	glm::vec3 m_BoundsMax{ std::numeric_limits<float>::lowest() };
 };
\ No newline at end of file
@@ -30,6 +30,12 @@ void Window::CreateWindowSurface(VkInstance instance, VkSurfaceKHR* surface)
 	}
 }
 
+void Window::SetTitleOverlay(const std::string& text)
+{
+	std::string title = text.empty() ? m_WindowName : m_WindowName + " | " + text;
+	glfwSetWindowTitle(m_Window, title.c_str());
+}
+
 void Window::frameBufferResizeCallback(GLFWwindow* glfwWindow, int width, int height)
 {
 	auto window = reinterpret_cast<Window *>(glfwGetWindowUserPointer(glfwWindow));
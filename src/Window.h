@@ -2,6 +2,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <atomic>
 #include <string>
 
 class Window
@@ -21,14 +22,17 @@ public:
 	void ResetWindowResizedFlag() { m_FrameBufferResized = false; }
 
 	GLFWwindow* GetWindow() const { return m_Window; }
+	// Shown after the window name, empty restores the plain name. Main thread only
+	void SetTitleOverlay(const std::string& text);
 
 private:
 	static void frameBufferResizeCallback(GLFWwindow* glfwWindow, int width, int height);
 	GLFWwindow* m_Window;
 
-	int m_WindowWidth;
-	int m_WindowHeight;
-	bool m_FrameBufferResized = false;
+	// Written by the resize callback on the main thread, read by the render thread
+	std::atomic<int> m_WindowWidth;
+	std::atomic<int> m_WindowHeight;
+	std::atomic<bool> m_FrameBufferResized{ false };
 
 	std::string m_WindowName;
 };
@@ -3,13 +3,39 @@
 #include "Application.h"
 #include "Instrumentation.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <stdexcept>
+#include <cstring>
 
-int main()
+int main(int argc, char** argv)
 {
-    Application App;
+    // Same scene through either path, for benchmarking
+    RenderPath renderPath = RenderPath::FORWARD;
+    PresentSettings presentSettings{};
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--deferred") == 0)
+            renderPath = RenderPath::DEFERRED;
+        // Unlocked frame rate for benchmarking
+        else if (std::strcmp(argv[i], "--immediate") == 0)
+            presentSettings.presentMode = PresentMode::IMMEDIATE;
+        else if (std::strcmp(argv[i], "--mailbox") == 0)
+            presentSettings.presentMode = PresentMode::MAILBOX;
+        // Newest frame always presented, and the CPU never runs more than one frame ahead
+        else if (std::strcmp(argv[i], "--low-latency") == 0)
+        {
+            presentSettings.presentMode = PresentMode::MAILBOX;
+            presentSettings.framesInFlight = 1;
+        }
+        else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+            presentSettings.framesInFlight = std::clamp(std::atoi(argv[++i]), 1, SwapChain::MAX_FRAMES_IN_FLIGHT);
+        else if (std::strcmp(argv[i], "--fps-limit") == 0 && i + 1 < argc)
+            presentSettings.frameRateLimit = static_cast<float>(std::atof(argv[++i]));
+    }
+
+    Application App{ renderPath, presentSettings };
 
     try 
     {